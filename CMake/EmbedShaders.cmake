@@ -0,0 +1,30 @@
+function(embed_shaders)
+    if(ARGC LESS 4)
+        message(FATAL_ERROR
+                "Usage: embed_shaders <TARGET> <NAME_ROOT> <OUT_FILE> <spv1> [spv2 ...]\n"
+                "Only ${ARGC} argument(s) given."
+        )
+    endif()
+
+    list(GET ARGV 0 target_name)
+    list(GET ARGV 1 name_root)
+    list(GET ARGV 2 output_file)
+    list(SUBLIST ARGV 3 -1 spv_files)
+
+    # Lists can't be passed through -D unescaped, so the files are joined with '|'
+    string(REPLACE ";" "|" spv_files_arg "${spv_files}")
+
+    file(RELATIVE_PATH rel_output "${CMAKE_BINARY_DIR}" "${output_file}")
+
+    add_custom_command(
+            OUTPUT   "${output_file}"
+            COMMAND  ${CMAKE_COMMAND} "-DNAME_ROOT=${name_root}" "-DOUTPUT_FILE=${output_file}" "-DSPV_FILES=${spv_files_arg}"
+                     -P "${CMAKE_SOURCE_DIR}/CMake/GenerateShaderRegistry.cmake"
+            DEPENDS  ${spv_files} "${CMAKE_SOURCE_DIR}/CMake/GenerateShaderRegistry.cmake"
+            COMMENT  "Embed SPIR-V shaders -> ${rel_output}"
+            VERBATIM
+    )
+
+    target_sources(${target_name} PRIVATE "${output_file}")
+
+endfunction()
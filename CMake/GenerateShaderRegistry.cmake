@@ -0,0 +1,42 @@
+# Script mode: cmake -DNAME_ROOT=<dir> -DOUTPUT_FILE=<file> -DSPV_FILES=<a.spv|b.spv|...> -P GenerateShaderRegistry.cmake
+string(REPLACE "|" ";" spv_files "${SPV_FILES}")
+
+set(arrays "")
+set(entries "")
+
+foreach(spv_file IN LISTS spv_files)
+    file(RELATIVE_PATH shader_name "${NAME_ROOT}" "${spv_file}")
+    string(MAKE_C_IDENTIFIER "${shader_name}" symbol)
+
+    file(READ "${spv_file}" hex HEX)
+    string(LENGTH "${hex}" hex_length)
+    math(EXPR remainder "${hex_length} % 8")
+    if(hex_length EQUAL 0 OR NOT remainder EQUAL 0)
+        message(FATAL_ERROR "${spv_file} is not a valid SPIR-V binary")
+    endif()
+
+    # SPIR-V is a stream of little endian words
+    string(REGEX REPLACE "(..)(..)(..)(..)" "0x\\4\\3\\2\\1," words "${hex}")
+    string(REGEX REPLACE "(0x........,0x........,0x........,0x........,0x........,0x........,0x........,0x........,)" "\\1\n    " words "${words}")
+    string(REGEX REPLACE "\n    $" "" words "${words}")
+
+    string(APPEND arrays "alignas(16) static constexpr u32 ${symbol}[] = {\n    ${words}\n};\n\n")
+    string(APPEND entries "    { \"${shader_name}\", ${symbol}, sizeof(${symbol}) },\n")
+endforeach()
+
+set(content "// Generated by CMake/GenerateShaderRegistry.cmake, do not edit\n\n#include \"shader_registry.h\"\n\n")
+string(APPEND content "${arrays}")
+string(APPEND content "static constexpr EmbeddedShader embeddedShaders[] = {\n${entries}};\n\n")
+string(APPEND content "const EmbeddedShader* findEmbeddedShader(std::string_view name) {\n")
+string(APPEND content "    for (const EmbeddedShader& shader : embeddedShaders) {\n")
+string(APPEND content "        if (shader.name == name) {\n")
+string(APPEND content "            return &shader;\n")
+string(APPEND content "        }\n")
+string(APPEND content "    }\n")
+string(APPEND content "    return nullptr;\n")
+string(APPEND content "}\n")
+
+# Only touch the file when it changed to avoid needless recompiles
+file(WRITE "${OUTPUT_FILE}.tmp" "${content}")
+configure_file("${OUTPUT_FILE}.tmp" "${OUTPUT_FILE}" COPYONLY)
+file(REMOVE "${OUTPUT_FILE}.tmp")
@@ -0,0 +1,37 @@
+#include "bench.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <numeric>
+#include <vector>
+
+static const volatile void* volatile benchmarkSink = nullptr;
+
+void useBenchmarkValue(const volatile void* value) {
+    benchmarkSink = value;
+}
+
+BenchmarkResult runBenchmark(const std::string& name, u32 iterations, const std::function<void()>& function) {
+    function();
+
+    std::vector<double> times(std::max(iterations, 1u));
+    for (double& time : times) {
+        auto start = std::chrono::steady_clock::now();
+        function();
+        time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    BenchmarkResult result {};
+    result.name = name;
+    result.iterations = static_cast<u32>(times.size());
+    result.meanTime = std::accumulate(times.begin(), times.end(), 0.0) / times.size();
+    std::sort(times.begin(), times.end());
+    result.minTime = times.front();
+    result.medianTime = times[times.size() / 2];
+
+    printf("%-48s %8.3f ms median %8.3f ms min %8.3f ms mean (%u iterations)\n", result.name.c_str(), result.medianTime, result.minTime, result.meanTime, result.iterations);
+    fflush(stdout);
+
+    return result;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <functional>
+#include <string>
+
+#include "types.h"
+
+struct BenchmarkResult {
+    std::string name;
+    u32 iterations;
+    double minTime; // Milliseconds per iteration
+    double medianTime;
+    double meanTime;
+};
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+// Defined in bench.cpp, the compiler can't see what it does with the value
+void useBenchmarkValue(const volatile void* value);
+
+// Compiler barrier, the value counts as read and all memory as possibly changed. Keeps the work that produced an unused result
+template<class T>
+inline void doNotOptimize(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    useBenchmarkValue(&value);
+    _ReadWriteBarrier();
+#endif
+}
+
+// Runs one untimed warm up iteration, then times every iteration on its own and prints the result
+BenchmarkResult runBenchmark(const std::string& name, u32 iterations, const std::function<void()>& function);
+
+// Compares the scene benchmark results of the application against a baseline, returns 1 if any metric got worse by more than threshold percent
+int compareBenchmarkResults(const char* baselineFilename, const char* resultsFilename, double threshold);
+
+// Benchmark suites, see main.cpp
+void benchmarkScene();
+void benchmarkTransforms();
+void benchmarkDrawQueue();
+void benchmarkLoader();
+void benchmarkUtils();
+void benchmarkLogger();
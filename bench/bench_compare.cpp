@@ -0,0 +1,223 @@
+#include "bench.h"
+
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+// Just enough JSON for the scene benchmark results, no escapes beyond \" and \\ and no unicode
+struct JsonValue {
+    enum Type { NONE, NUMBER, STRING, BOOLEAN, ARRAY, OBJECT } type = NONE;
+    double number = 0.0;
+    bool boolean = false;
+    std::string string;
+    std::vector<JsonValue> elements;
+    std::vector<std::pair<std::string, JsonValue>> members;
+
+    const JsonValue* find(const std::string& key) const {
+        for (const auto& [name, value] : members) {
+            if (name == key) {
+                return &value;
+            }
+        }
+        return nullptr;
+    }
+};
+
+struct JsonParser {
+    const std::string& text;
+    size_t position = 0;
+
+    void skipWhitespace() {
+        while (position < text.size() && isspace(static_cast<unsigned char>(text[position]))) {
+            position++;
+        }
+    }
+
+    bool consume(char c) {
+        skipWhitespace();
+        if (position < text.size() && text[position] == c) {
+            position++;
+            return true;
+        }
+        return false;
+    }
+
+    bool parseString(std::string* result) {
+        if (!consume('"')) {
+            return false;
+        }
+        while (position < text.size() && text[position] != '"') {
+            if (text[position] == '\\' && position + 1 < text.size()) {
+                position++;
+            }
+            result->push_back(text[position++]);
+        }
+        return consume('"');
+    }
+
+    bool parseValue(JsonValue* value) {
+        skipWhitespace();
+        if (position >= text.size()) {
+            return false;
+        }
+
+        char c = text[position];
+        if (c == '{') {
+            value->type = JsonValue::OBJECT;
+            position++;
+            if (consume('}')) {
+                return true;
+            }
+            do {
+                std::pair<std::string, JsonValue> member;
+                if (!parseString(&member.first) || !consume(':') || !parseValue(&member.second)) {
+                    return false;
+                }
+                value->members.push_back(std::move(member));
+            } while (consume(','));
+            return consume('}');
+        }
+        if (c == '[') {
+            value->type = JsonValue::ARRAY;
+            position++;
+            if (consume(']')) {
+                return true;
+            }
+            do {
+                value->elements.emplace_back();
+                if (!parseValue(&value->elements.back())) {
+                    return false;
+                }
+            } while (consume(','));
+            return consume(']');
+        }
+        if (c == '"') {
+            value->type = JsonValue::STRING;
+            return parseString(&value->string);
+        }
+        if (text.compare(position, 4, "true") == 0 || text.compare(position, 5, "false") == 0) {
+            value->type = JsonValue::BOOLEAN;
+            value->boolean = text[position] == 't';
+            position += value->boolean ? 4 : 5;
+            return true;
+        }
+
+        size_t length = 0;
+        try {
+            value->number = std::stod(text.substr(position, 32), &length);
+        }
+        catch (const std::exception&) {
+            return false;
+        }
+        value->type = JsonValue::NUMBER;
+        position += length;
+        return true;
+    }
+};
+
+static bool loadJson(const char* filename, JsonValue* value) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        fprintf(stderr, "Failed to open %s\n", filename);
+        return false;
+    }
+
+    std::stringstream stream;
+    stream << file.rdbuf();
+    std::string text = stream.str();
+
+    JsonParser parser { text };
+    if (!parser.parseValue(value) || value->type != JsonValue::OBJECT) {
+        fprintf(stderr, "Failed to parse %s\n", filename);
+        return false;
+    }
+    return true;
+}
+
+static const JsonValue* findScene(const JsonValue& results, const std::string& name) {
+    const JsonValue* scenes = results.find("scenes");
+    if (!scenes) {
+        return nullptr;
+    }
+    for (const JsonValue& scene : scenes->elements) {
+        const JsonValue* sceneName = scene.find("name");
+        if (sceneName && sceneName->string == name) {
+            return &scene;
+        }
+    }
+    return nullptr;
+}
+
+static double getNumber(const JsonValue* object, const char* key) {
+    const JsonValue* value = object ? object->find(key) : nullptr;
+    return value ? value->number : 0.0;
+}
+
+int compareBenchmarkResults(const char* baselineFilename, const char* resultsFilename, double threshold) {
+    JsonValue baseline;
+    JsonValue results;
+    if (!loadJson(baselineFilename, &baseline) || !loadJson(resultsFilename, &results)) {
+        return 2;
+    }
+
+    const JsonValue* scenes = results.find("scenes");
+    if (!scenes) {
+        fprintf(stderr, "No scenes in %s\n", resultsFilename);
+        return 2;
+    }
+
+    const JsonValue* baselineDevice = baseline.find("device");
+    const JsonValue* resultsDevice = results.find("device");
+    if (baselineDevice && resultsDevice && baselineDevice->string != resultsDevice->string) {
+        printf("Warning: baseline is from %s, results are from %s\n", baselineDevice->string.c_str(), resultsDevice->string.c_str());
+    }
+
+    // Lower is better for all of them, timings are compared at the median and the tail
+    struct Metric {
+        const char* name;
+        const char* statistic;
+    };
+    const Metric metrics[] = {
+        { "cpuFrameTime", "p50" },
+        { "cpuFrameTime", "p95" },
+        { "cpuFrameTime", "p99" },
+        { "gpuFrameTime", "p50" },
+        { "gpuFrameTime", "p95" },
+        { "gpuFrameTime", "p99" },
+        { "drawCalls", "mean" },
+    };
+
+    u32 regressions = 0;
+    printf("%-28s %-18s %12s %12s %9s\n", "Scene", "Metric", "Baseline", "Results", "Change");
+
+    for (const JsonValue& scene : scenes->elements) {
+        const JsonValue* name = scene.find("name");
+        const JsonValue* baselineScene = name ? findScene(baseline, name->string) : nullptr;
+        if (!baselineScene) {
+            printf("%-28s not in the baseline\n", name ? name->string.c_str() : "?");
+            continue;
+        }
+
+        auto compare = [&](const std::string& metric, double before, double after) {
+            // Metrics that were zero in the baseline, e.g. without GPU timestamps, can't be compared
+            if (before <= 0.0) {
+                return;
+            }
+            double change = (after - before) / before * 100.0;
+            bool regression = change > threshold;
+            regressions += regression ? 1 : 0;
+            printf("%-28s %-18s %12.4f %12.4f %+8.1f%%%s\n", name->string.c_str(), metric.c_str(), before, after, change, regression ? "  REGRESSION" : "");
+        };
+
+        for (const Metric& metric : metrics) {
+            compare(std::string(metric.name) + "." + metric.statistic, getNumber(baselineScene->find(metric.name), metric.statistic),
+                    getNumber(scene.find(metric.name), metric.statistic));
+        }
+        compare("memoryMB", getNumber(baselineScene, "memoryMB"), getNumber(&scene, "memoryMB"));
+    }
+
+    printf("%u regressions over %.1f%%\n", regressions, threshold);
+    return regressions > 0 ? 1 : 0;
+}
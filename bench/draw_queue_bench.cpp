@@ -0,0 +1,37 @@
+#include "bench.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "draw_queue.h"
+
+void benchmarkDrawQueue() {
+    const u32 drawCount = 100000;
+
+    // 4 pipelines, 64 materials and 16 meshes at random depths, pushed in random order
+    std::mt19937 random(1);
+    DrawQueue source;
+    source.reserve(drawCount);
+    for (u32 i = 0; i < drawCount; ++i) {
+        float depth = std::uniform_real_distribution<float>(0.1f, 1000.0f)(random);
+        source.push(DrawQueue::makeKey(DRAW_PASS_OPAQUE, random() % 4, random() % 64, random() % 16, depth), i);
+    }
+
+    DrawQueue queue;
+    runBenchmark("Radix sort, 100k draws", 50, [&]() {
+        queue = source;
+        queue.sort();
+    });
+
+    std::vector<DrawPacket> packets;
+    runBenchmark("std::sort, 100k draws", 50, [&]() {
+        packets = source.getPackets();
+        std::sort(packets.begin(), packets.end(), [](const DrawPacket& a, const DrawPacket& b) { return a.key < b.key; });
+    });
+
+    DrawStateChanges unsorted = source.countStateChanges();
+    DrawStateChanges sorted = queue.countStateChanges();
+    printf("State changes: %u unsorted, %u sorted\n", unsorted.getTotal(), sorted.getTotal());
+}
@@ -0,0 +1,67 @@
+#include "bench.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#include <stb_image.h>
+
+#include "model_data.h"
+
+// Paths are relative to the build directory, the data directory is copied next to the executables
+static const char* modelFilename = "data/models/BoomBox.glb";
+static const char* imageFilename = "data/images/FireCube.png";
+
+void benchmarkLoader() {
+    // Separate position, normal and texture coordinate streams like in a glTF file, interleaved into the vertex layout of the renderer
+    const u32 vertexCount = 1000000;
+    std::vector<float> positions(vertexCount * 3, 1.0f);
+    std::vector<float> normals(vertexCount * 3, 0.5f);
+    std::vector<float> texcoords(vertexCount * 2, 0.25f);
+    std::vector<u8> vertexData(vertexCount * sizeof(float) * 8);
+
+    runBenchmark("fillBuffer interleave, 1M vertices", 20, [&]() {
+        fillBuffer(sizeof(float) * 3, positions.data(), sizeof(float) * 8, vertexData.data(), vertexCount, sizeof(float) * 3);
+        fillBuffer(sizeof(float) * 3, normals.data(), sizeof(float) * 8, vertexData.data() + sizeof(float) * 3, vertexCount, sizeof(float) * 3);
+        fillBuffer(sizeof(float) * 2, texcoords.data(), sizeof(float) * 8, vertexData.data() + sizeof(float) * 6, vertexCount, sizeof(float) * 2);
+        doNotOptimize(vertexData);
+    });
+
+    ModelData model {};
+    if (loadModelData(modelFilename, "data/models", cgltf_component_type_r_16u, &model)) {
+        // Everything createModel does before the upload, except decoding the texture
+        runBenchmark("glTF parse + interleave, BoomBox", 20, [&]() {
+            ModelData data {};
+            loadModelData(modelFilename, "data/models", cgltf_component_type_r_16u, &data);
+            doNotOptimize(data.vertexData);
+            freeModelData(&data);
+        });
+
+        runBenchmark("stbi decode, BoomBox albedo " + std::to_string(model.encodedTextureSize / 1024) + " KB", 10, [&]() {
+            decodeModelTexture(&model);
+            stbi_image_free(model.textureData);
+            model.textureData = nullptr;
+        });
+
+        freeModelData(&model);
+    }
+    else {
+        printf("Skipping the model benchmarks, %s not found\n", modelFilename);
+    }
+
+    std::ifstream imageFile(imageFilename, std::ios::binary);
+    if (imageFile.is_open()) {
+        std::vector<u8> encodedImage((std::istreambuf_iterator<char>(imageFile)), std::istreambuf_iterator<char>());
+
+        runBenchmark("stbi decode, FireCube.png", 20, [&]() {
+            int width, height, channels;
+            stbi_uc* pixels = stbi_load_from_memory(encodedImage.data(), static_cast<int>(encodedImage.size()), &width, &height, &channels, STBI_rgb_alpha);
+            doNotOptimize(pixels);
+            stbi_image_free(pixels);
+        });
+    }
+    else {
+        printf("Skipping the image benchmark, %s not found\n", imageFilename);
+    }
+}
@@ -0,0 +1,73 @@
+#include "bench.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "logger.h"
+
+static const char* logFilename = "VulkanLearningBench_logger.log";
+
+void benchmarkLogger() {
+    const u32 messageCount = 10000;
+    constexpr const char* file = trimSourcePath(__FILE__);
+
+    // Debug messages only go to the file, info and above would measure the console as well.
+    // Every iteration waits for the writer thread, so the times include the file writes
+    {
+        Logger logger(logFilename);
+        runBenchmark("Logger::log string, 10k messages", 10, [&]() {
+            for (u32 i = 0; i < messageCount; ++i) {
+                logger.log(LogLevel::Debug, file, __LINE__, "Allocated buffer " + std::to_string(i));
+            }
+            logger.flush();
+        });
+        runBenchmark("Logger::log format, 10k messages", 10, [&]() {
+            for (u32 i = 0; i < messageCount; ++i) {
+                logger.log(LogLevel::Debug, file, __LINE__, "Allocated buffer {}", i);
+            }
+            logger.flush();
+        });
+
+        logger.setLevel(LogLevel::Warning);
+        runBenchmark("Logger::isEnabled filtered, 10k messages", 10, [&]() {
+            for (u32 i = 0; i < messageCount; ++i) {
+                if (logger.isEnabled(LogLevel::Debug)) {
+                    logger.log(LogLevel::Debug, file, __LINE__, "Allocated buffer {}", i);
+                }
+            }
+        });
+    }
+
+    // Calls per second with every thread logging at once, contention on the ring is what this measures
+    // Powers of two, then every hardware thread, which often isn't a power of two itself
+    u32 maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+    std::vector<u32> threadCounts;
+    for (u32 threadCount = 1; threadCount < maxThreads; threadCount *= 2) {
+        threadCounts.push_back(threadCount);
+    }
+    threadCounts.push_back(maxThreads);
+
+    for (u32 threadCount : threadCounts) {
+        Logger logger(logFilename);
+        BenchmarkResult result = runBenchmark(std::to_string(threadCount) + " threads, 10k messages each", 5, [&]() {
+            std::vector<std::thread> threads;
+            for (u32 t = 0; t < threadCount; ++t) {
+                threads.emplace_back([&, t]() {
+                    for (u32 i = 0; i < messageCount; ++i) {
+                        logger.log(LogLevel::Debug, file, __LINE__, "Thread {} allocated buffer {}", t, i);
+                    }
+                });
+            }
+            for (std::thread& thread : threads) {
+                thread.join();
+            }
+            logger.flush();
+        });
+        printf("%-48s %8.2f M calls/s\n", "", threadCount * messageCount / (result.medianTime * 1000.0));
+    }
+
+    std::remove(logFilename);
+}
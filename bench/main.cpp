@@ -0,0 +1,46 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "bench.h"
+#include "logger.h"
+
+// The loader reports its errors through the global logger
+Logger globalLogger("VulkanLearningBench.log");
+
+struct BenchmarkSuite {
+    const char* name;
+    void (*run)();
+};
+
+static const BenchmarkSuite suites[] = {
+    { "scene", benchmarkScene },
+    { "transforms", benchmarkTransforms },
+    { "draw_queue", benchmarkDrawQueue },
+    { "loader", benchmarkLoader },
+    { "utils", benchmarkUtils },
+    { "logger", benchmarkLogger },
+};
+
+// Usage: VulkanLearningBench [suite...], runs every suite without arguments
+//        VulkanLearningBench --compare baseline.json results.json [threshold percent]
+int main(int argc, char** argv) {
+    if (argc >= 4 && strcmp(argv[1], "--compare") == 0) {
+        double threshold = argc >= 5 ? atof(argv[4]) : 10.0;
+        return compareBenchmarkResults(argv[2], argv[3], threshold);
+    }
+
+    for (const BenchmarkSuite& suite : suites) {
+        bool selected = argc < 2;
+        for (int i = 1; i < argc; ++i) {
+            selected |= strcmp(argv[i], suite.name) == 0;
+        }
+
+        if (selected) {
+            printf("== %s ==\n", suite.name);
+            suite.run();
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,56 @@
+#include "bench.h"
+
+#include <cstdio>
+
+#include <glm/gtc/quaternion.hpp>
+
+#include "job_system.h"
+#include "scene.h"
+
+// 1000 roots with 10 children each and 100 leaves per child, 1,011,000 nodes in three levels
+static void buildBenchmarkScene(Scene& scene) {
+    const u32 rootCount = 1000, childCount = 10, leafCount = 100;
+
+    scene.clear();
+    scene.reserve(rootCount * (1 + childCount * (1 + leafCount)));
+
+    for (u32 root = 0; root < rootCount; ++root) {
+        scene.addNode(Scene::NO_PARENT, glm::vec3(static_cast<float>(root % 32), 0.0f, static_cast<float>(root / 32)));
+    }
+    for (u32 root = 0; root < rootCount; ++root) {
+        for (u32 child = 0; child < childCount; ++child) {
+            scene.addNode(root, glm::vec3(0.0f, static_cast<float>(child), 0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(0.5f));
+        }
+    }
+    for (u32 child = 0; child < rootCount * childCount; ++child) {
+        for (u32 leaf = 0; leaf < leafCount; ++leaf) {
+            scene.addNode(rootCount + child, glm::vec3(static_cast<float>(leaf) * 0.1f, 0.0f, 0.0f));
+        }
+    }
+}
+
+// Animates the first movingRoots roots, the rest of the hierarchy follows through the dirty flags
+static void benchmarkSceneUpdate(Scene& scene, JobSystem* jobSystem, u32 movingRoots, const std::string& name) {
+    float angle = 0.0f;
+    runBenchmark(name, 50, [&]() {
+        angle += 0.01f;
+        glm::quat rotation = glm::angleAxis(angle, glm::vec3(0.0f, 1.0f, 0.0f));
+        for (u32 root = 0; root < movingRoots; ++root) {
+            scene.setRotation(root, rotation);
+        }
+        scene.updateTransforms(jobSystem);
+    });
+    printf("  %u of %u world matrices updated per frame\n", scene.getUpdatedNodeCount(), scene.getNodeCount());
+}
+
+void benchmarkScene() {
+    JobSystem jobSystem;
+    Scene scene;
+    buildBenchmarkScene(scene);
+    scene.updateTransforms(&jobSystem);
+
+    benchmarkSceneUpdate(scene, nullptr, 1000, "Scene update 1M nodes, 1 thread");
+    benchmarkSceneUpdate(scene, &jobSystem, 1000, "Scene update 1M nodes, " + std::to_string(jobSystem.getNumThreads()) + " threads");
+    benchmarkSceneUpdate(scene, &jobSystem, 100, "Scene update 1M nodes, 10% moving");
+    benchmarkSceneUpdate(scene, &jobSystem, 0, "Scene update 1M nodes, static");
+}
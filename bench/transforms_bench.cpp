@@ -0,0 +1,57 @@
+#include "bench.h"
+
+#include <numeric>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/matrix_inverse.hpp>
+
+#include "job_system.h"
+#include "transforms.h"
+
+void benchmarkTransforms() {
+    const u32 instanceCount = 100000;
+
+    std::vector<glm::mat4> modelMatrices(instanceCount);
+    for (u32 i = 0; i < instanceCount; ++i) {
+        glm::mat4 translation = glm::translate(glm::mat4(1.0f), glm::vec3(static_cast<float>(i % 32), static_cast<float>(i / 32), 5.0f));
+        modelMatrices[i] = glm::rotate(translation, static_cast<float>(i) * 0.01f, glm::vec3(0.0f, 1.0f, 0.0f));
+    }
+    std::vector<u32> modelIndices(instanceCount);
+    std::iota(modelIndices.begin(), modelIndices.end(), 0u);
+    std::vector<u32> modelMaterials(instanceCount, 0);
+    std::vector<ModelInstance> instances(instanceCount);
+
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 10.0f, -10.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 viewProjection = glm::perspective(glm::radians(90.0f), 16.0f / 9.0f, 0.01f, 1000.0f) * view;
+
+    // What the renderer did before, the normal matrix was left to the vertex shader
+    runBenchmark("glm MVP + model view, 100k instances", 20, [&]() {
+        for (u32 i = 0; i < instanceCount; ++i) {
+            instances[i].modelViewProjection = viewProjection * modelMatrices[i];
+            instances[i].modelView = view * modelMatrices[i];
+        }
+    });
+
+    runBenchmark("glm MVP + model view + normal, 100k instances", 20, [&]() {
+        for (u32 i = 0; i < instanceCount; ++i) {
+            instances[i].modelViewProjection = viewProjection * modelMatrices[i];
+            instances[i].modelView = view * modelMatrices[i];
+            glm::mat3 normalMatrix = glm::inverseTranspose(glm::mat3(instances[i].modelView));
+            for (int column = 0; column < 3; ++column) {
+                instances[i].normalMatrix[column] = glm::vec4(normalMatrix[column], 0.0f);
+            }
+        }
+    });
+
+    runBenchmark("Batched kernel, 100k instances, 1 thread", 20, [&]() {
+        computeModelInstances(viewProjection, view, modelMatrices.data(), modelMaterials.data(), modelIndices.data(), instanceCount, instances.data());
+    });
+
+    JobSystem jobSystem;
+    runBenchmark("Batched kernel, 100k instances, " + std::to_string(jobSystem.getNumThreads()) + " threads", 20, [&]() {
+        jobSystem.parallelFor(instanceCount, 4096, [&](u32 begin, u32 end) {
+            computeModelInstances(viewProjection, view, modelMatrices.data(), modelMaterials.data(), modelIndices.data() + begin, end - begin, instances.data() + begin);
+        });
+    });
+}
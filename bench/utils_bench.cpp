@@ -0,0 +1,50 @@
+#include "bench.h"
+
+#include <cmath>
+#include <string>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "utils.h"
+
+void benchmarkUtils() {
+    const u32 cameraCount = 100000;
+
+    // What updateApplication does for the camera every frame
+    runBenchmark("Camera direction + getProjectionInverseZ + lookAtLH, 100k", 20, [&]() {
+        glm::mat4 sum(0.0f);
+        glm::vec3 position(0.0f, 2.0f, -10.0f);
+        glm::vec3 up(0.0f, 1.0f, 0.0f);
+        for (u32 i = 0; i < cameraCount; ++i) {
+            float yaw = static_cast<float>(i) * 0.01f;
+            float pitch = std::sin(static_cast<float>(i) * 0.001f) * 80.0f;
+
+            glm::vec3 front;
+            front.x = cos(glm::radians(pitch)) * sin(glm::radians(yaw));
+            front.y = sin(glm::radians(pitch));
+            front.z = cos(glm::radians(pitch)) * cos(glm::radians(yaw));
+            glm::vec3 direction = glm::normalize(front);
+
+            glm::mat4 projection = utils::getProjectionInverseZ(glm::radians(45.0f), 1240.0f, 720.0f, 0.01f);
+            glm::mat4 view = glm::lookAtLH(position, position + direction, up);
+            sum += projection * view;
+        }
+        doNotOptimize(sum);
+    });
+
+    const u32 valueCount = 100000;
+
+    runBenchmark("utils::formatBytes, 100k values", 20, [&]() {
+        for (u32 i = 0; i < valueCount; ++i) {
+            std::string text = utils::formatBytes(static_cast<double>(i) * 123457.0);
+            doNotOptimize(text);
+        }
+    });
+
+    runBenchmark("utils::formatNumber, 100k values", 20, [&]() {
+        for (u32 i = 0; i < valueCount; ++i) {
+            std::string text = utils::formatNumber(static_cast<u64>(i) * 1234567ull);
+            doNotOptimize(text);
+        }
+    });
+}
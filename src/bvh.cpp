@@ -0,0 +1,241 @@
+#include "bvh.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <numeric>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <immintrin.h>
+#define BVH_SSE 1
+#endif
+
+#include <glm/common.hpp>
+
+Aabb transformAabb(const Aabb& bounds, const glm::mat4& transform) {
+    Aabb result { glm::vec3(transform[3]), glm::vec3(transform[3]) };
+
+    for (int column = 0; column < 3; ++column) {
+        glm::vec3 a = glm::vec3(transform[column]) * bounds.min[column];
+        glm::vec3 b = glm::vec3(transform[column]) * bounds.max[column];
+        result.min += glm::min(a, b);
+        result.max += glm::max(a, b);
+    }
+
+    return result;
+}
+
+void Bvh::build(const Aabb* objectBounds, u32 objectCount) {
+    nodes.clear();
+    objectSlots.assign(objectCount, {});
+    dirtyNodes.clear();
+    firstDirtyNode = UINT32_MAX;
+    lastDirtyNode = 0;
+
+    if (objectCount == 0) {
+        return;
+    }
+
+    std::vector<glm::vec3> centers(objectCount);
+    for (u32 i = 0; i < objectCount; ++i) {
+        centers[i] = (objectBounds[i].min + objectBounds[i].max) * 0.5f;
+    }
+
+    std::vector<u32> objectIndices(objectCount);
+    std::iota(objectIndices.begin(), objectIndices.end(), 0u);
+
+    buildNode(objectIndices.data(), objectCount, EMPTY_SLOT, 0, objectBounds, centers);
+
+    // Children are always created after their parent, a full refit computes every inner bound
+    dirtyNodes.assign(nodes.size(), 1);
+    firstDirtyNode = 0;
+    lastDirtyNode = static_cast<u32>(nodes.size()) - 1;
+    refit();
+}
+
+u32 Bvh::buildNode(u32* objectIndices, u32 count, u32 parent, u32 parentSlot, const Aabb* objectBounds, const std::vector<glm::vec3>& centers) {
+    u32 nodeIndex = static_cast<u32>(nodes.size());
+
+    Node node {};
+    std::fill(std::begin(node.children), std::end(node.children), EMPTY_SLOT);
+    node.parent = parent;
+    node.parentSlot = parentSlot;
+    nodes.push_back(node);
+
+    // Up to four objects go straight into the slots, larger ranges get two levels of median splits
+    u32 groupBegin[5] = { 0, 1, 2, 3, 4 };
+    u32 groupCount = std::min(count, 4u);
+    if (count > 4) {
+        auto medianSplit = [&](u32 begin, u32 end) {
+            glm::vec3 centerMin = centers[objectIndices[begin]];
+            glm::vec3 centerMax = centerMin;
+            for (u32 i = begin + 1; i < end; ++i) {
+                centerMin = glm::min(centerMin, centers[objectIndices[i]]);
+                centerMax = glm::max(centerMax, centers[objectIndices[i]]);
+            }
+
+            glm::vec3 extent = centerMax - centerMin;
+            int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+
+            u32 mid = (begin + end) / 2;
+            std::nth_element(objectIndices + begin, objectIndices + mid, objectIndices + end, [&](u32 a, u32 b) {
+                return centers[a][axis] < centers[b][axis];
+            });
+            return mid;
+        };
+
+        u32 half = medianSplit(0, count);
+        groupBegin[1] = medianSplit(0, half);
+        groupBegin[2] = half;
+        groupBegin[3] = medianSplit(half, count);
+        groupBegin[4] = count;
+    }
+    else {
+        groupBegin[groupCount] = count;
+    }
+
+    for (u32 slot = 0; slot < groupCount; ++slot) {
+        u32 groupSize = groupBegin[slot + 1] - groupBegin[slot];
+
+        if (groupSize == 1) {
+            u32 objectIndex = objectIndices[groupBegin[slot]];
+            nodes[nodeIndex].children[slot] = objectIndex | OBJECT_BIT;
+            setSlotBounds(nodes[nodeIndex], slot, objectBounds[objectIndex]);
+            objectSlots[objectIndex] = { nodeIndex, slot };
+        }
+        else {
+            // nodes may reallocate while building the child, so no reference is kept across the call
+            u32 child = buildNode(objectIndices + groupBegin[slot], groupSize, nodeIndex, slot, objectBounds, centers);
+            nodes[nodeIndex].children[slot] = child;
+        }
+    }
+
+    return nodeIndex;
+}
+
+void Bvh::setSlotBounds(Node& node, u32 slot, const Aabb& bounds) {
+    node.minX[slot] = bounds.min.x;
+    node.minY[slot] = bounds.min.y;
+    node.minZ[slot] = bounds.min.z;
+    node.maxX[slot] = bounds.max.x;
+    node.maxY[slot] = bounds.max.y;
+    node.maxZ[slot] = bounds.max.z;
+}
+
+void Bvh::updateObject(u32 objectIndex, const Aabb& bounds) {
+    ObjectSlot objectSlot = objectSlots[objectIndex];
+    setSlotBounds(nodes[objectSlot.node], objectSlot.slot, bounds);
+
+    dirtyNodes[objectSlot.node] = 1;
+    firstDirtyNode = std::min(firstDirtyNode, objectSlot.node);
+    lastDirtyNode = std::max(lastDirtyNode, objectSlot.node);
+}
+
+void Bvh::refit() {
+    if (firstDirtyNode == UINT32_MAX) {
+        return;
+    }
+
+    // Parents have lower indices than their children, walking backwards finishes every child before its parent
+    for (u32 nodeIndex = lastDirtyNode + 1; nodeIndex-- > firstDirtyNode;) {
+        if (!dirtyNodes[nodeIndex]) {
+            continue;
+        }
+        dirtyNodes[nodeIndex] = 0;
+
+        const Node& node = nodes[nodeIndex];
+        if (node.parent == EMPTY_SLOT) {
+            continue;
+        }
+
+        Aabb bounds { glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX) };
+        for (u32 slot = 0; slot < 4; ++slot) {
+            if (node.children[slot] == EMPTY_SLOT) {
+                continue;
+            }
+            bounds.min = glm::min(bounds.min, glm::vec3(node.minX[slot], node.minY[slot], node.minZ[slot]));
+            bounds.max = glm::max(bounds.max, glm::vec3(node.maxX[slot], node.maxY[slot], node.maxZ[slot]));
+        }
+
+        setSlotBounds(nodes[node.parent], node.parentSlot, bounds);
+        dirtyNodes[node.parent] = 1;
+        firstDirtyNode = std::min(firstDirtyNode, node.parent);
+    }
+
+    firstDirtyNode = UINT32_MAX;
+    lastDirtyNode = 0;
+}
+
+// Returns a bit per slot whose box is at least partially inside the frustum.
+// A box is outside as soon as its corner furthest along a plane normal is behind that plane
+u32 Bvh::testNode(const Node& node, const glm::vec4 frustumPlanes[6]) {
+#ifdef BVH_SSE
+    const __m128 minX = _mm_load_ps(node.minX);
+    const __m128 minY = _mm_load_ps(node.minY);
+    const __m128 minZ = _mm_load_ps(node.minZ);
+    const __m128 maxX = _mm_load_ps(node.maxX);
+    const __m128 maxY = _mm_load_ps(node.maxY);
+    const __m128 maxZ = _mm_load_ps(node.maxZ);
+
+    __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    for (int i = 0; i < 6; ++i) {
+        const glm::vec4& plane = frustumPlanes[i];
+
+        __m128 x = plane.x > 0.0f ? maxX : minX;
+        __m128 y = plane.y > 0.0f ? maxY : minY;
+        __m128 z = plane.z > 0.0f ? maxZ : minZ;
+
+        __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane.x)), _mm_mul_ps(y, _mm_set1_ps(plane.y))),
+                                     _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+        inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, _mm_setzero_ps()));
+    }
+
+    return static_cast<u32>(_mm_movemask_ps(inside));
+#else
+    u32 mask = 0;
+    for (u32 slot = 0; slot < 4; ++slot) {
+        bool inside = true;
+        for (int i = 0; i < 6 && inside; ++i) {
+            const glm::vec4& plane = frustumPlanes[i];
+            float x = plane.x > 0.0f ? node.maxX[slot] : node.minX[slot];
+            float y = plane.y > 0.0f ? node.maxY[slot] : node.minY[slot];
+            float z = plane.z > 0.0f ? node.maxZ[slot] : node.minZ[slot];
+            inside = x * plane.x + y * plane.y + z * plane.z + plane.w >= 0.0f;
+        }
+        mask |= inside ? (1u << slot) : 0u;
+    }
+    return mask;
+#endif
+}
+
+void Bvh::cull(const glm::vec4 frustumPlanes[6], std::vector<u32>& visibleObjects) const {
+    visibleObjects.clear();
+    if (nodes.empty()) {
+        return;
+    }
+
+    // Each level pushes at most three siblings, 64 entries cover far more objects than fit in memory
+    u32 stack[64];
+    u32 stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while (stackSize > 0) {
+        const Node& node = nodes[stack[--stackSize]];
+        u32 visibleSlots = testNode(node, frustumPlanes);
+
+        for (u32 slot = 0; slot < 4; ++slot) {
+            u32 child = node.children[slot];
+            if (!(visibleSlots & (1u << slot)) || child == EMPTY_SLOT) {
+                continue;
+            }
+
+            if (child & OBJECT_BIT) {
+                visibleObjects.push_back(child & ~OBJECT_BIT);
+            }
+            else {
+                assert(stackSize < 64);
+                stack[stackSize++] = child;
+            }
+        }
+    }
+}
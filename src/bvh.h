@@ -0,0 +1,66 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include "types.h"
+
+struct Aabb {
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+// Bounds of the transformed box, Arvo's method
+Aabb transformAabb(const Aabb& bounds, const glm::mat4& transform);
+
+// 4-wide bounding volume hierarchy. Every child slot holds either a node or a single object,
+// so culling always tests the four boxes of a node at once
+class Bvh {
+public:
+    void build(const Aabb* objectBounds, u32 objectCount);
+
+    // Moved objects only dirty their node, refit() then updates the bounds up to the root
+    void updateObject(u32 objectIndex, const Aabb& bounds);
+    void refit();
+
+    // Planes face inwards, see utils::getFrustumPlanes
+    void cull(const glm::vec4 frustumPlanes[6], std::vector<u32>& visibleObjects) const;
+
+    u32 getObjectCount() const { return static_cast<u32>(objectSlots.size()); }
+    u32 getNodeCount() const { return static_cast<u32>(nodes.size()); }
+
+private:
+    static constexpr u32 OBJECT_BIT = 0x80000000;
+    static constexpr u32 EMPTY_SLOT = 0xFFFFFFFF;
+
+    // Children bounds are stored as structure of arrays to load them straight into SIMD registers
+    struct alignas(16) Node {
+        float minX[4];
+        float minY[4];
+        float minZ[4];
+        float maxX[4];
+        float maxY[4];
+        float maxZ[4];
+        u32 children[4];
+        u32 parent;
+        u32 parentSlot;
+    };
+
+    struct ObjectSlot {
+        u32 node;
+        u32 slot;
+    };
+
+    u32 buildNode(u32* objectIndices, u32 count, u32 parent, u32 parentSlot, const Aabb* objectBounds, const std::vector<glm::vec3>& centers);
+    static void setSlotBounds(Node& node, u32 slot, const Aabb& bounds);
+    static u32 testNode(const Node& node, const glm::vec4 frustumPlanes[6]);
+
+    std::vector<Node> nodes;
+    std::vector<ObjectSlot> objectSlots;
+    std::vector<u8> dirtyNodes;
+    u32 firstDirtyNode = UINT32_MAX;
+    u32 lastDirtyNode = 0;
+};
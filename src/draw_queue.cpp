@@ -0,0 +1,98 @@
+#include "draw_queue.h"
+
+#include <cassert>
+#include <cstring>
+
+static constexpr u32 STATE_BITS = DrawQueue::PIPELINE_BITS + DrawQueue::MATERIAL_BITS + DrawQueue::MESH_BITS;
+static constexpr u32 PASS_SHIFT = STATE_BITS + DrawQueue::DEPTH_BITS;
+static_assert(PASS_SHIFT == 62, "The pass takes the top two bits");
+
+static constexpr u64 mask(u32 bits) {
+    return (1ull << bits) - 1;
+}
+
+// Positive floats compare like their bit patterns, the sign bit is always 0 so the top of the remaining bits is kept
+static u64 quantizeDepth(float viewDepth) {
+    if (!(viewDepth > 0.0f)) {
+        return 0;
+    }
+
+    u32 bits;
+    memcpy(&bits, &viewDepth, sizeof(bits));
+    return bits >> (31 - DrawQueue::DEPTH_BITS);
+}
+
+u64 DrawQueue::makeKey(DrawPass pass, u32 pipeline, u32 material, u32 mesh, float viewDepth) {
+    assert(pipeline <= mask(PIPELINE_BITS) && material <= mask(MATERIAL_BITS) && mesh <= mask(MESH_BITS));
+
+    u64 state = (static_cast<u64>(pipeline) << (MATERIAL_BITS + MESH_BITS)) | (static_cast<u64>(material) << MESH_BITS) | mesh;
+    u64 depth = quantizeDepth(viewDepth);
+
+    // Blending needs the far draws first, their order matters more than the state changes
+    if (pass == DRAW_PASS_TRANSPARENT) {
+        return (static_cast<u64>(pass) << PASS_SHIFT) | ((mask(DEPTH_BITS) - depth) << STATE_BITS) | state;
+    }
+    return (static_cast<u64>(pass) << PASS_SHIFT) | (state << DEPTH_BITS) | depth;
+}
+
+DrawState DrawQueue::getState(u64 key) {
+    u32 pass = static_cast<u32>(key >> PASS_SHIFT);
+    u64 state = pass == DRAW_PASS_TRANSPARENT ? key : key >> DEPTH_BITS;
+
+    DrawState drawState;
+    drawState.pass = pass;
+    drawState.pipeline = static_cast<u32>((state >> (MATERIAL_BITS + MESH_BITS)) & mask(PIPELINE_BITS));
+    drawState.material = static_cast<u32>((state >> MESH_BITS) & mask(MATERIAL_BITS));
+    drawState.mesh = static_cast<u32>(state & mask(MESH_BITS));
+    return drawState;
+}
+
+void DrawQueue::sort() {
+    u32 count = static_cast<u32>(packets.size());
+    if (count < 2) {
+        return;
+    }
+
+    // One read of the keys fills the histograms of all eight digits
+    u32 histograms[8][256] = {};
+    for (const DrawPacket& packet : packets) {
+        for (u32 digit = 0; digit < 8; ++digit) {
+            ++histograms[digit][(packet.key >> (digit * 8)) & 0xFF];
+        }
+    }
+
+    scratch.resize(count);
+    for (u32 digit = 0; digit < 8; ++digit) {
+        u32 shift = digit * 8;
+        u32* histogram = histograms[digit];
+        if (histogram[(packets[0].key >> shift) & 0xFF] == count) {
+            continue;
+        }
+
+        u32 offset = 0;
+        for (u32 bucket = 0; bucket < 256; ++bucket) {
+            u32 bucketCount = histogram[bucket];
+            histogram[bucket] = offset;
+            offset += bucketCount;
+        }
+
+        for (const DrawPacket& packet : packets) {
+            scratch[histogram[(packet.key >> shift) & 0xFF]++] = packet;
+        }
+        packets.swap(scratch);
+    }
+}
+
+// The first draw binds everything, so an empty queue has no changes and a single draw one of each
+DrawStateChanges DrawQueue::countStateChanges() const {
+    DrawStateChanges changes;
+    DrawState previous {};
+    for (u32 i = 0; i < packets.size(); ++i) {
+        DrawState state = getState(packets[i].key);
+        changes.pipelines += i == 0 || state.pipeline != previous.pipeline;
+        changes.materials += i == 0 || state.material != previous.material;
+        changes.meshes += i == 0 || state.mesh != previous.mesh;
+        previous = state;
+    }
+    return changes;
+}
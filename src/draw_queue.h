@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "types.h"
+
+enum DrawPass {
+    DRAW_PASS_OPAQUE,
+    DRAW_PASS_TRANSPARENT,
+};
+
+struct DrawPacket {
+    u64 key;
+    u32 payload;
+};
+
+struct DrawState {
+    u32 pass;
+    u32 pipeline;
+    u32 material;
+    u32 mesh;
+};
+
+// Number of times consecutive draws differ in each part of the state
+struct DrawStateChanges {
+    u32 pipelines = 0;
+    u32 materials = 0;
+    u32 meshes = 0;
+
+    u32 getTotal() const { return pipelines + materials + meshes; }
+};
+
+// Draws packed into 64 bit sort keys, sorting the keys groups draws by state. From the top, opaque keys hold
+// pass, pipeline, material, mesh and depth front to back, transparent keys hold pass, depth back to front, pipeline, material and mesh
+class DrawQueue {
+public:
+    static constexpr u32 PIPELINE_BITS = 10;
+    static constexpr u32 MATERIAL_BITS = 14;
+    static constexpr u32 MESH_BITS = 14;
+    static constexpr u32 DEPTH_BITS = 24;
+
+    // viewDepth is the distance along the view direction, the upper bits of the float are used as is
+    static u64 makeKey(DrawPass pass, u32 pipeline, u32 material, u32 mesh, float viewDepth);
+    static DrawState getState(u64 key);
+
+    void clear() { packets.clear(); }
+    void reserve(u32 count) { packets.reserve(count); }
+    void push(u64 key, u32 payload) { packets.push_back({ key, payload }); }
+
+    // LSD radix sort with 8 bit digits, digits that are the same for every key are skipped
+    void sort();
+
+    DrawStateChanges countStateChanges() const;
+
+    const std::vector<DrawPacket>& getPackets() const { return packets; }
+
+private:
+    std::vector<DrawPacket> packets;
+    std::vector<DrawPacket> scratch;
+};
@@ -0,0 +1,109 @@
+#include "job_system.h"
+
+#include <algorithm>
+#include <memory>
+
+#include "profiler.h"
+
+JobSystem::JobSystem(u32 numThreads) {
+    if (numThreads == 0) {
+        numThreads = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+    }
+
+    workers.reserve(numThreads);
+    for (u32 i = 0; i < numThreads; ++i) {
+        workers.emplace_back(&JobSystem::workerLoop, this);
+    }
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard lock(mutex);
+        stopping = true;
+    }
+    jobAvailable.notify_all();
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void JobSystem::submit(std::function<void()> job) {
+    {
+        std::lock_guard lock(mutex);
+        jobs.push(std::move(job));
+        pendingJobs++;
+    }
+    jobAvailable.notify_one();
+}
+
+void JobSystem::parallelFor(u32 count, u32 chunkSize, const std::function<void(u32 begin, u32 end)>& job) {
+    if (count == 0) {
+        return;
+    }
+
+    chunkSize = std::max(chunkSize, 1u);
+    const u32 numChunks = (count + chunkSize - 1) / chunkSize;
+    if (numChunks == 1 || workers.empty()) {
+        job(0, count);
+        return;
+    }
+
+    struct Batch {
+        std::atomic<u32> nextChunk { 0 };
+        std::atomic<u32> finishedChunks { 0 };
+    };
+    // Helpers that start after the last chunk was taken only touch the batch, so it has to outlive this call
+    auto batch = std::make_shared<Batch>();
+
+    auto runChunks = [batch, numChunks, chunkSize, count, &job]() {
+        for (u32 chunk = batch->nextChunk.fetch_add(1); chunk < numChunks; chunk = batch->nextChunk.fetch_add(1)) {
+            u32 begin = chunk * chunkSize;
+            job(begin, std::min(begin + chunkSize, count));
+            batch->finishedChunks.fetch_add(1, std::memory_order_release);
+        }
+    };
+
+    const u32 numHelpers = std::min(numChunks - 1, static_cast<u32>(workers.size()));
+    for (u32 i = 0; i < numHelpers; ++i) {
+        submit(runChunks);
+    }
+
+    runChunks();
+
+    while (batch->finishedChunks.load(std::memory_order_acquire) < numChunks) {
+        std::this_thread::yield();
+    }
+}
+
+void JobSystem::wait() {
+    std::unique_lock lock(mutex);
+    jobsFinished.wait(lock, [this] { return pendingJobs == 0; });
+}
+
+void JobSystem::workerLoop() {
+    PROFILE_THREAD("Job worker");
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock lock(mutex);
+            jobAvailable.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if (stopping && jobs.empty()) {
+                return;
+            }
+            job = std::move(jobs.front());
+            jobs.pop();
+        }
+
+        {
+            PROFILE_ZONE("Job");
+            job();
+        }
+
+        {
+            std::lock_guard lock(mutex);
+            pendingJobs--;
+        }
+        jobsFinished.notify_all();
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#include "types.h"
+
+class JobSystem {
+public:
+    // numThreads = 0 uses one worker per hardware thread, minus the calling thread
+    JobSystem(u32 numThreads = 0);
+    ~JobSystem();
+
+    void submit(std::function<void()> job);
+
+    // Splits [0, count) into chunks of chunkSize and runs them on the workers and the calling thread, returns when all chunks are done
+    void parallelFor(u32 count, u32 chunkSize, const std::function<void(u32 begin, u32 end)>& job);
+
+    // Blocks until every submitted job has finished
+    void wait();
+
+    u32 getNumThreads() const { return static_cast<u32>(workers.size()) + 1; }
+
+private:
+    void workerLoop();
+
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable jobAvailable;
+    std::condition_variable jobsFinished;
+    u32 pendingJobs = 0;
+    bool stopping = false;
+};
@@ -1,53 +1,192 @@
 #include "logger.h"
-#include <filesystem>
-#include <sstream>
-#include <iomanip>
 
-namespace fs = std::filesystem;
+#include <cstring>
+#include <iostream>
 
-static std::string shortenPath(const std::string& filePath) {
-    try {
-        fs::path p(filePath);
-        fs::path workDir = fs::current_path();
-        fs::path relPath = fs::relative(p, workDir);
-        return relPath.string();
-    }
-    catch (const fs::filesystem_error&) {
-        return filePath;
-    }
-}
+static const char* levelNames[] = { "[DEBUG] [", "[INFO] [", "[WARNING] [", "[ERROR] [" };
+static const char* levelColors[] = { "", "", "\033[33m", "\033[31m" };
+static const char* levelColorsEnd[] = { "", "", "\033[0m", "\033[0m" };
 
-Logger::Logger(const std::string& filename) : logfile(filename, std::ios::app) {
+Logger::Logger(const std::string& filename) : logfile(filename, std::ios::app), records(new LogRecord[LOG_RING_SIZE]) {
     if (!logfile) {
         std::cerr << "Error on opening logfile: " << filename << std::endl;
     }
+
+    // A slot is free for the caller that claims position i once its sequence is i, and ready for the writer at i + 1
+    for (u64 i = 0; i < LOG_RING_SIZE; ++i) {
+        records[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    writer = std::thread(&Logger::writerLoop, this);
 }
 
 Logger::~Logger() {
+    stopping.store(true, std::memory_order_seq_cst);
+    wakeSignal.fetch_add(1, std::memory_order_release);
+    wakeSignal.notify_one();
+    writer.join();
+
     if (logfile.is_open()) {
         logfile.close();
     }
 }
 
-void Logger::logDebug(const std::string& message, const std::string& file, int line) {
-    std::string formattedMessage = "[DEBUG] [" + shortenPath(file) + ":" + std::to_string(line) + "] " + message;
-    logfile << formattedMessage << std::endl;
+void Logger::setLevel(LogLevel level) {
+    minLevel.store(level, std::memory_order_relaxed);
+}
+
+void Logger::log(LogLevel level, const char* file, u32 line, std::string_view message) {
+    LogRecord* record = beginRecord(level, file, line);
+    try {
+        if (message.size() > LOG_MESSAGE_SIZE) {
+            record->overflow = new char[message.size()];
+            memcpy(record->overflow, message.data(), message.size());
+        }
+        else {
+            memcpy(record->message, message.data(), message.size());
+        }
+        record->length = static_cast<u32>(message.size());
+    }
+    catch (...) {
+        setFormatError(record);
+    }
+    commitRecord(record);
+}
+
+void Logger::flush() {
+    u64 target = writePosition.load(std::memory_order_acquire);
+    u64 written = writtenPosition.load(std::memory_order_acquire);
+    while (written < target) {
+        writtenPosition.wait(written, std::memory_order_acquire);
+        written = writtenPosition.load(std::memory_order_acquire);
+    }
 }
 
-void Logger::logInfo(const std::string& message, const std::string& file, int line) {
-    std::string formattedMessage = "[INFO] [" + shortenPath(file) + ":" + std::to_string(line) + "] " + message;
-    std::cout << formattedMessage << std::endl;
-    logfile << formattedMessage << std::endl;
+LogRecord* Logger::beginRecord(LogLevel level, const char* file, u32 line) {
+    u64 position = writePosition.load(std::memory_order_relaxed);
+    LogRecord* record;
+    while (true) {
+        record = &records[position & (LOG_RING_SIZE - 1)];
+        u64 sequence = record->sequence.load(std::memory_order_acquire);
+        if (sequence == position) {
+            if (writePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        }
+        else if (sequence < position) {
+            // The ring is full, wait for the writer instead of dropping the message
+            std::this_thread::yield();
+            position = writePosition.load(std::memory_order_relaxed);
+        }
+        else {
+            position = writePosition.load(std::memory_order_relaxed);
+        }
+    }
+
+    record->file = file;
+    record->overflow = nullptr;
+    record->line = line;
+    record->level = level;
+    return record;
 }
 
-void Logger::logWarning(const std::string& message, const std::string& file, int line) {
-    std::string formattedMessage = "[WARNING] [" + shortenPath(file) + ":" + std::to_string(line) + "] " + message;
-    std::cout << "\033[33m" << formattedMessage << "\033[0m" << std::endl;
-    logfile << formattedMessage << std::endl;
+void Logger::setFormatError(LogRecord* record) {
+    static const char formatError[] = "<format error>";
+    record->overflow = nullptr;
+    record->length = sizeof(formatError) - 1;
+    memcpy(record->message, formatError, sizeof(formatError) - 1);
 }
 
-void Logger::logError(const std::string& message, const std::string& file, int line) {
-    std::string formattedMessage = "[ERROR] [" + shortenPath(file) + ":" + std::to_string(line) + "] " + message;
-    std::cout << "\033[31m" << formattedMessage << "\033[0m" << std::endl;
-    logfile << formattedMessage << std::endl;
+void Logger::commitRecord(LogRecord* record) {
+    // The writer may reuse the record as soon as it is published
+    LogLevel level = record->level;
+    u64 position = record->sequence.load(std::memory_order_relaxed);
+    record->sequence.store(position + 1, std::memory_order_release);
+
+    // Pairs with the fence in writerLoop, either the writer sees the record or this sees the writer asleep
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (writerSleeping.load(std::memory_order_relaxed)) {
+        wakeSignal.fetch_add(1, std::memory_order_release);
+        wakeSignal.notify_one();
+    }
+
+    // Errors often come right before an assert or a crash, they have to be in the file by then
+    if (level == LogLevel::Error) {
+        flush();
+    }
+}
+
+void Logger::writerLoop() {
+    std::string fileBatch;
+    std::string consoleBatch;
+    u64 readPosition = 0;
+
+    while (true) {
+        bool stop = stopping.load(std::memory_order_acquire);
+
+        // Bounded so that callers waiting in flush see progress under a steady stream of messages
+        while (fileBatch.size() < (1 << 20)) {
+            LogRecord* record = &records[readPosition & (LOG_RING_SIZE - 1)];
+            if (record->sequence.load(std::memory_order_acquire) != readPosition + 1) {
+                break;
+            }
+
+            u32 level = static_cast<u32>(record->level);
+            std::string_view message(record->overflow ? record->overflow : record->message, record->length);
+            size_t begin = fileBatch.size();
+            std::format_to(std::back_inserter(fileBatch), "{}{}:{}] {}\n", levelNames[level], record->file, record->line, message);
+
+            // Debug messages only go to the file
+            if (record->level != LogLevel::Debug) {
+                std::string_view formatted = std::string_view(fileBatch).substr(begin, fileBatch.size() - begin - 1);
+                std::format_to(std::back_inserter(consoleBatch), "{}{}{}\n", levelColors[level], formatted, levelColorsEnd[level]);
+            }
+
+            delete[] record->overflow;
+            record->sequence.store(readPosition + LOG_RING_SIZE, std::memory_order_release);
+            readPosition++;
+        }
+
+        if (fileBatch.empty()) {
+            if (stop) {
+                break;
+            }
+
+            // Yields for a little while first, messages tend to come in bursts and a wake up per message would cost every caller a notify
+            LogRecord* next = &records[readPosition & (LOG_RING_SIZE - 1)];
+            bool ready = false;
+            for (u32 i = 0; i < 64 && !ready; ++i) {
+                std::this_thread::yield();
+                ready = next->sequence.load(std::memory_order_acquire) == readPosition + 1;
+            }
+            if (ready) {
+                continue;
+            }
+
+            // Sleeps until a caller commits a record or the logger is destroyed
+            u32 signal = wakeSignal.load(std::memory_order_acquire);
+            writerSleeping.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (next->sequence.load(std::memory_order_acquire) != readPosition + 1 && !stopping.load(std::memory_order_acquire)) {
+                wakeSignal.wait(signal, std::memory_order_acquire);
+            }
+            writerSleeping.store(false, std::memory_order_relaxed);
+            continue;
+        }
+
+        logfile.write(fileBatch.data(), fileBatch.size());
+        logfile.flush();
+        if (!consoleBatch.empty()) {
+            std::cout.write(consoleBatch.data(), consoleBatch.size());
+            std::cout.flush();
+        }
+        fileBatch.clear();
+        consoleBatch.clear();
+        writtenPosition.store(readPosition, std::memory_order_release);
+        writtenPosition.notify_all();
+    }
+
+    // Anything logged from here on is never written, flush must not wait for it
+    writtenPosition.store(UINT64_MAX, std::memory_order_release);
+    writtenPosition.notify_all();
 }
@@ -1,26 +1,133 @@
 #pragma once
 
+#include <atomic>
+#include <format>
 #include <fstream>
-#include <iostream>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <thread>
 
+#include "types.h"
+
+enum class LogLevel : u8 {
+    Debug,
+    Info,
+    Warning,
+    Error,
+};
+
+// Lowest level that is compiled in, calls below it and their arguments disappear. 0 debug, 1 info, 2 warning, 3 error
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL 0
+#endif
+
+constexpr bool isLogLevelCompiled(LogLevel level) {
+    return level >= static_cast<LogLevel>(LOG_COMPILE_LEVEL);
+}
+
+// Cuts LOG_SOURCE_ROOT, the project directory passed by CMake, off a __FILE__ path
+constexpr const char* trimSourcePath(const char* path) {
+#ifdef LOG_SOURCE_ROOT
+    const char* root = LOG_SOURCE_ROOT;
+    const char* p = path;
+    for (; *root; ++root, ++p) {
+        char a = *p == '\\' ? '/' : *p;
+        char b = *root == '\\' ? '/' : *root;
+        a = (a >= 'A' && a <= 'Z') ? a - 'A' + 'a' : a;
+        b = (b >= 'A' && b <= 'Z') ? b - 'A' + 'a' : b;
+        if (a != b) {
+            return path;
+        }
+    }
+    return p;
+#else
+    return path;
+#endif
+}
+
+#define LOG_MESSAGE_SIZE 472
+#define LOG_RING_SIZE 8192 // Records, has to be a power of two
+
+// One slot of the ring, messages that don't fit are moved to the heap
+struct alignas(64) LogRecord {
+    std::atomic<u64> sequence;
+    const char* file; // Has to outlive the record, __FILE__ does
+    char* overflow;
+    u32 line;
+    u32 length;
+    LogLevel level;
+    char message[LOG_MESSAGE_SIZE];
+};
+
+// Callers format into a fixed size record of a lock-free MPSC ring, a background thread writes the records in batches
 class Logger {
 public:
     Logger(const std::string& filename);
     ~Logger();
 
-	void logDebug(const std::string& message, const std::string& file, int line);
-    void logInfo(const std::string& message, const std::string& file, int line);
-    void logWarning(const std::string& message, const std::string& file, int line);
-    void logError(const std::string& message, const std::string& file, int line);
+    bool isEnabled(LogLevel level) const {
+        return level >= minLevel.load(std::memory_order_relaxed);
+    }
+    void setLevel(LogLevel level);
+
+    void log(LogLevel level, const char* file, u32 line, std::string_view message);
+
+    // Only formats once the level passed, with at least one argument so that plain strings with braces stay plain
+    template<class Arg, class... Args>
+    void log(LogLevel level, const char* file, u32 line, std::format_string<Arg&, Args&...> format, Arg&& arg, Args&&... args) {
+        // The slot is claimed, it has to be published even if a formatter or the allocation throws
+        LogRecord* record = beginRecord(level, file, line);
+        try {
+            auto result = std::format_to_n(record->message, LOG_MESSAGE_SIZE, format, arg, args...);
+            if (result.size > LOG_MESSAGE_SIZE) {
+                std::unique_ptr<char[]> overflow(new char[result.size]);
+                std::format_to(overflow.get(), format, arg, args...);
+                record->overflow = overflow.release();
+            }
+            record->length = static_cast<u32>(result.size);
+        }
+        catch (...) {
+            setFormatError(record);
+        }
+        commitRecord(record);
+    }
+
+    // Waits until the writer thread wrote everything logged before the call, returns right away once the writer stopped
+    void flush();
 
 private:
+    LogRecord* beginRecord(LogLevel level, const char* file, u32 line);
+    void setFormatError(LogRecord* record);
+    void commitRecord(LogRecord* record);
+    void writerLoop();
+
     std::ofstream logfile;
+    std::atomic<LogLevel> minLevel = LogLevel::Debug;
+
+    std::unique_ptr<LogRecord[]> records;
+    alignas(64) std::atomic<u64> writePosition = 0; // Next slot a caller claims
+    alignas(64) std::atomic<u64> writtenPosition = 0; // Everything before it is in the file, UINT64_MAX once the writer stopped
+    std::atomic<bool> writerSleeping = false; // Callers only wake the writer while it waits, so a busy writer costs them nothing
+    std::atomic<u32> wakeSignal = 0;
+    std::atomic<bool> stopping = false;
+    std::thread writer;
 };
 
 extern Logger globalLogger;
 
-#define LOG_DEBUG(message) (globalLogger.logDebug((message), __FILE__, __LINE__))
-#define LOG_INFO(message) (globalLogger.logInfo((message), __FILE__, __LINE__))
-#define LOG_WARNING(message) (globalLogger.logWarning((message), __FILE__, __LINE__))
-#define LOG_ERROR(message) (globalLogger.logError((message), __FILE__, __LINE__))
+#define LOG_AT(level, ...) \
+    do { \
+        if constexpr (isLogLevelCompiled(level)) { \
+            if (globalLogger.isEnabled(level)) { \
+                constexpr const char* logFile = trimSourcePath(__FILE__); \
+                globalLogger.log(level, logFile, __LINE__, __VA_ARGS__); \
+            } \
+        } \
+    } while (0)
+
+// Either a single string or a std::format string with its arguments
+#define LOG_DEBUG(...) LOG_AT(LogLevel::Debug, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT(LogLevel::Info, __VA_ARGS__)
+#define LOG_WARNING(...) LOG_AT(LogLevel::Warning, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT(LogLevel::Error, __VA_ARGS__)
@@ -1,12 +1,19 @@
 #define SDL_MAIN_HANDLED
-#define STB_IMAGE_IMPLEMENTATION
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #define VULKAN_HPP_DISPATCH_LOADER_DYNAMIC 1
 
+#include <algorithm>
+#include <atomic>
+#include <bit>
 #include <chrono>
+#include <deque>
+#include <fstream>
+#include <numeric>
 #include <thread>
 
+#ifdef _WIN32
 #include <windows.h>
+#endif
 
 #include <SDL3/SDL.h>
 #include <SDL3/SDL_vulkan.h>
@@ -24,52 +31,188 @@
 #include "logger.h"
 #include "utils.h"
 #include "model.h"
+#include "job_system.h"
+#include "bvh.h"
+#include "scene.h"
+#include "transforms.h"
+#include "draw_queue.h"
 
 #include "vulkan_base/vulkan_base.h"
 
 Logger globalLogger("VulkanLearning.log");
+JobSystem jobSystem;
+// Optimized pipeline links can take long, they get their own worker so they never hold up the per-frame jobs
+JobSystem pipelineLinkJobs(1);
 
-#define FRAMES_IN_FLIGHT 2
+// Per frame resources exist for the maximum, only the first framesInFlight of them are cycled through
+#define MAX_FRAMES_IN_FLIGHT 3
+u32 framesInFlight = 2;
+u32 requestedFramesInFlight = 2;
 
 auto msaaSamples = vk::SampleCountFlagBits::e8;
 
 VulkanContext* context = nullptr;
 VkSurfaceKHR surface;
 VulkanSwapchain swapchain;
+// Replaced swapchains wait for the next frame submit, its timeline value decides when they can go
+std::vector<VulkanSwapchain> retiredSwapchains;
+
+// Headless frames render into offscreen images without a window, surface or presentation, e.g. on lavapipe
+bool headless = false;
+u32 headlessWidth = 1240;
+u32 headlessHeight = 720;
+std::vector<vk::PresentModeKHR> supportedPresentModes;
+vk::PresentModeKHR presentMode = vk::PresentModeKHR::eFifo;
+
+// Frame pacing, the limiter and the latency wait both run before input is read so they don't add to the latency
+u32 frameRateLimit = 0;
+u32 maxQueuedFrames = 0;
+u64 frameInputTime = 0;
+
+// Every present gets an increasing id, the pending ones are checked for being on screen at the start of each frame
+u64 presentId = 0;
+u64 firstSwapchainPresentId = 1;
+std::deque<std::pair<u64, u64>> pendingPresents;
+double presentLatency = 0.0;
+// Render pass of the scene pass on the render pass path, owned by the frame graph
 vk::RenderPass renderPass;
-std::vector<VulkanImage> depthBuffers;
-std::vector<VulkanImage> colorBuffers;
-std::vector<vk::Framebuffer> framebuffers;
-vk::CommandPool commandPools[FRAMES_IN_FLIGHT];
-vk::CommandBuffer commandBuffers[FRAMES_IN_FLIGHT];
-vk::Fence fences[FRAMES_IN_FLIGHT];
-vk::Semaphore acquireSemaphores[FRAMES_IN_FLIGHT];
-vk::Semaphore releaseSemaphores[FRAMES_IN_FLIGHT];
+VulkanRenderGraph frameGraph;
+u32 scenePass = 0;
+u32 postprocessPass = 0;
+u32 sceneResolveImage = 0;
+u32 swapchainGraphImage = 0;
+vk::CommandPool commandPools[MAX_FRAMES_IN_FLIGHT];
+vk::CommandBuffer commandBuffers[MAX_FRAMES_IN_FLIGHT];
+// Timeline value signaled by the last submission of each frame slot, the slot is free again once it completed
+u64 frameTimelineValues[MAX_FRAMES_IN_FLIGHT];
+vk::Semaphore acquireSemaphores[MAX_FRAMES_IN_FLIGHT];
+vk::Semaphore releaseSemaphores[MAX_FRAMES_IN_FLIGHT];
+
+// Scene draws are split into chunks recorded in parallel into secondary command buffers, each chunk has its own pool per frame
+std::vector<vk::CommandPool> recordingCommandPools[MAX_FRAMES_IN_FLIGHT];
+std::vector<vk::CommandBuffer> recordingCommandBuffers[MAX_FRAMES_IN_FLIGHT];
+vk::CommandBuffer imguiCommandBuffers[MAX_FRAMES_IN_FLIGHT];
+u32 recordingThreadCount = 1;
+double modelRecordingTime = 0.0;
 
 vk::Sampler sampler;
 VulkanImage image;
 
-vk::DescriptorPool spriteDescriptorPool;
-vk::DescriptorSet spriteDescriptorSet;
-vk::DescriptorSetLayout spriteDescriptorSetLayout;
+// Every texture is registered once in the global bindless set, materials and draws refer to it by slot
+VulkanBindlessTable bindlessTable;
+u32 samplerSlot = 0;
+u32 imageSlot = 0;
+
+// Matches the material struct in model.frag
+struct Material {
+	u32 albedoTexture;
+	u32 sampler;
+};
+
+std::vector<Material> materials;
+VulkanBuffer materialBuffer;
+
 VulkanPipeline spritePipeline;
 VulkanBuffer spriteVertexBuffer;
 VulkanBuffer spriteIndexBuffer;
 
+// Where draws without instancing get their transforms and material from, each path has its own pipelines
+enum DrawDataPath {
+	DRAW_DATA_INSTANCE_BUFFER,
+	DRAW_DATA_PUSH_CONSTANTS,
+	DRAW_DATA_PUSH_DESCRIPTORS,
+	DRAW_DATA_PATH_COUNT
+};
+
+const char* drawDataPathNames[] = { "Instance buffer", "Push constants", "Push descriptors" };
+int drawDataPath = DRAW_DATA_INSTANCE_BUFFER;
+
 Model model;
-VulkanPipeline modelPipeline;
+VulkanPipelineVariants modelPipelines[DRAW_DATA_PATH_COUNT];
+VulkanPipelineState modelPipelineState;
+VulkanPipelineLibraryCache pipelineLibraryCache;
+bool usePipelineLibraries = false;
 vk::DescriptorSetLayout modelDescriptorSetLayout;
-vk::DescriptorPool modelDescriptorPool;
-vk::DescriptorSet modelDescriptorSets[FRAMES_IN_FLIGHT];
-VulkanBuffer modelUniformBuffers[FRAMES_IN_FLIGHT];
+vk::DescriptorSet modelDescriptorSets[MAX_FRAMES_IN_FLIGHT];
+vk::DescriptorSetLayout modelPushDescriptorSetLayout;
+// Instances between two buffer offsets that satisfy minStorageBufferOffsetAlignment
+u32 pushDescriptorInstanceStep = 1;
+VulkanBuffer modelInstanceBuffers[MAX_FRAMES_IN_FLIGHT];
+std::vector<ModelDrawConstants> modelDrawConstants;
+u32 modelInstanceCapacity = 0;
+u32 modelCount = 2;
+bool useInstancing = true;
+
+// Material of every copy, with mixed materials the copies alternate but still go out in the same instanced draw
+std::vector<u32> modelMaterials;
+bool useMixedMaterials = false;
+
+// Every copy is a static node at its grid position with a spinning child that holds the model
+Scene scene;
+u32 sceneModelCount = 0;
+double transformUpdateTime = 0.0;
+
+// GPU-driven path, a compute pass culls the objects and writes the draws consumed by drawIndexedIndirectCount
+struct ModelObject {
+	glm::mat4 transform;
+	glm::vec4 boundingSphere;
+	u32 materialIndex;
+	u32 padding[3];
+};
+
+struct CullParameters {
+	glm::mat4 viewProjection;
+	glm::mat4 view;
+	glm::mat4 modelTransform;
+	glm::vec4 frustumPlanes[6];
+	u32 objectCount;
+	u32 indexCount;
+};
+
+bool useGpuCulling = false;
+VulkanPipeline cullPipeline;
+vk::DescriptorSetLayout cullDescriptorSetLayout;
+vk::DescriptorSet cullDescriptorSets[MAX_FRAMES_IN_FLIGHT];
+VulkanBuffer cullParameterBuffers[MAX_FRAMES_IN_FLIGHT];
+VulkanBuffer drawCommandBuffers[MAX_FRAMES_IN_FLIGHT];
+VulkanBuffer drawCountBuffers[MAX_FRAMES_IN_FLIGHT];
+VulkanBuffer modelObjectBuffer;
+u32 modelObjectCount = 0;
+u32 visibleModelCount = 0;
+// Draw calls recorded for the models this frame, the chunks are recorded in parallel
+std::atomic<u32> modelDrawCalls = 0;
+
+// CPU path, the copies are culled against a BVH and only the visible ones get an instance
+bool useCpuCulling = true;
+Bvh modelBvh;
+std::vector<u32> visibleModels;
+double cullingTime = 0.0;
+double refitTime = 0.0;
+
+// The visible copies are written and drawn in the order of their sort keys
+DrawQueue drawQueue;
+bool useDrawSorting = true;
+DrawStateChanges unsortedStateChanges;
+DrawStateChanges sortedStateChanges;
+double drawSortTime = 0.0;
 
 VulkanPipeline postprocessPipeline;
 vk::DescriptorSetLayout postprocessDescriptorSetLayout;
-vk::DescriptorSet postprocessDescriptorSets[FRAMES_IN_FLIGHT];
+vk::DescriptorSetLayout postprocessSampledDescriptorSetLayout;
 
-vk::DescriptorPool imguiDescriptorPool;
+// Long lived sets come from the allocator, sets that depend on the frame graph images are cached by their contents
+VulkanDescriptorAllocator descriptorAllocator;
+VulkanDescriptorCache descriptorCache;
+u32 descriptorWritesPerFrame = 0;
+VulkanGpuProfiler gpuProfiler;
 
-u64 singleElementSize = 0;
+// Dynamic rendering replaces the render pass and framebuffers, switchable at runtime
+bool useDynamicRendering = false;
+bool requestedDynamicRendering = false;
+vk::PipelineRenderingCreateInfo sceneRenderingInfo;
+vk::PipelineRenderingCreateInfo postprocessRenderingInfo;
+
+vk::DescriptorPool imguiDescriptorPool;
 
 struct Camera {
 	glm::vec3 position;
@@ -82,8 +225,16 @@ struct Camera {
 	glm::mat4 projection;
 } camera;
 
+// Advances by a fixed step every frame, the scene benchmark resets it so every run animates the same
+float animationTime = 0.0f;
+
 bool windowResized = false;
 bool windowMinimized = false;
+// Set when the swapchain reported it no longer matches the surface, it is rebuilt even if the extent looks unchanged
+bool swapchainOutOfDate = false;
+u32 swapchainResizes = 0;
+u32 attachmentAllocations = 0;
+double resizeFrameTime = 0.0;
 
 float vertexData[] = {
 	0.5f, -0.5f,       // Position
@@ -108,67 +259,468 @@ u32 indexData[] = {
 	3, 0, 2
 };
 
-void recreateRenderPass() {
-	if (renderPass) {
-		for (auto& framebuffer : framebuffers) {
-			context->device.destroyFramebuffer(framebuffer);
+bool usesLocalRead() {
+	return useDynamicRendering && context->features.dynamicRenderingLocalRead;
+}
+
+// Only declares the passes and what they access, the graph derives the render pass or barriers, store ops and transient images
+void recreateFrameGraph() {
+	// The cached sets point at the graph's image views, both are only released once the frames in flight are done
+	resetDescriptorCache(context, &descriptorCache);
+	destroyRenderGraph(context, &frameGraph);
+
+	frameGraph.width = swapchain.width;
+	frameGraph.height = swapchain.height;
+	frameGraph.useRenderPass = !useDynamicRendering;
+
+	vk::ImageLayout swapchainLayout = headless ? vk::ImageLayout::eTransferSrcOptimal : vk::ImageLayout::ePresentSrcKHR;
+	u32 swapchainImage = importRenderGraphImage(&frameGraph, "Swapchain", swapchain.format, swapchain.images, swapchain.imageViews, swapchainLayout);
+	swapchainGraphImage = swapchainImage;
+	u32 sceneColor = addRenderGraphImage(&frameGraph, "Scene color", swapchain.format, msaaSamples);
+	u32 sceneDepth = addRenderGraphImage(&frameGraph, "Scene depth", vk::Format::eD32Sfloat, msaaSamples);
+
+	// Without local read the post processing samples an intermediate resolve target instead of reading the swapchain image in place
+	bool readInPlace = !useDynamicRendering || usesLocalRead();
+	sceneResolveImage = readInPlace ? swapchainImage : addRenderGraphImage(&frameGraph, "Scene resolve", swapchain.format);
+
+	VulkanRenderGraphPass scene {};
+	scene.name = "Scene";
+	scene.colorAttachments.push_back({ sceneColor, sceneResolveImage, vk::AttachmentLoadOp::eClear, vk::ClearColorValue{0.5f, 0.0f, 0.5f, 1.0f} });
+	scene.depthAttachment = { sceneDepth, RENDER_GRAPH_NONE, vk::AttachmentLoadOp::eClear, vk::ClearDepthStencilValue{0.0f, 0} };
+	scene.secondaryCommandBuffers = true;
+	scenePass = addRenderGraphPass(&frameGraph, scene);
+
+	VulkanRenderGraphPass postprocess {};
+	postprocess.name = "Post Processing";
+	if (readInPlace) {
+		postprocess.colorAttachments.push_back({ swapchainImage, RENDER_GRAPH_NONE, vk::AttachmentLoadOp::eLoad });
+		postprocess.inputAttachments.push_back(swapchainImage);
+	}
+	else {
+		postprocess.colorAttachments.push_back({ swapchainImage, RENDER_GRAPH_NONE, vk::AttachmentLoadOp::eDontCare });
+		postprocess.sampledImages.push_back(sceneResolveImage);
+	}
+	postprocessPass = addRenderGraphPass(&frameGraph, postprocess);
+
+	compileRenderGraph(context, &frameGraph);
+	renderPass = getRenderGraphRenderPass(&frameGraph, scenePass);
+	attachmentAllocations += static_cast<u32>(frameGraph.memoryBlocks.size());
+}
+
+// The attachments are only allocated again when the window outgrows them, otherwise the framebuffers and render area change
+void resizeFrameGraph() {
+	resetDescriptorCache(context, &descriptorCache);
+	setRenderGraphImportedImages(&frameGraph, swapchainGraphImage, swapchain.images, swapchain.imageViews);
+	if (!resizeRenderGraph(context, &frameGraph, swapchain.width, swapchain.height)) {
+		recreateFrameGraph();
+	}
+}
+
+// Resize events often repeat the current size or arrive before the surface changed
+bool swapchainExtentChanged() {
+	vk::SurfaceCapabilitiesKHR surfaceCapabilities = VKA(context->physicalDevice.getSurfaceCapabilitiesKHR(surface));
+	if (surfaceCapabilities.currentExtent.width == 0xFFFFFFFF) {
+		return true;
+	}
+	return surfaceCapabilities.currentExtent.width != swapchain.width || surfaceCapabilities.currentExtent.height != swapchain.height;
+}
+
+void recreateSwapchain() {
+	VulkanSwapchain oldSwapchain = swapchain;
+
+	// Frames in flight keep rendering into the old swapchain, nothing waits for the device
+	swapchain = createSwapchain(context, surface, vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eInputAttachment, &oldSwapchain, presentMode);
+
+	// Present ids belong to a swapchain, the new one never completes the pending ones
+	pendingPresents.clear();
+	firstSwapchainPresentId = presentId + 1;
+	swapchainOutOfDate = false;
+
+	// Its last presents are queued ahead of the first frame on the new swapchain, once that frame finished it can go
+	retiredSwapchains.push_back(oldSwapchain);
+	resizeFrameGraph();
+	swapchainResizes++;
+}
+
+VulkanPipeline createModelPipeline(const VulkanPipelineState* state, bool dynamicState, VulkanPipelineLibraryCache* libraryCache, DrawDataPath path) {
+	vk::VertexInputAttributeDescription modelAttributeDescriptions[3];
+	modelAttributeDescriptions[0].binding = 0;
+	modelAttributeDescriptions[0].location = 0;
+	modelAttributeDescriptions[0].format = vk::Format::eR32G32B32Sfloat;
+	modelAttributeDescriptions[0].offset = 0;
+
+	modelAttributeDescriptions[1].binding = 0;
+	modelAttributeDescriptions[1].location = 1;
+	modelAttributeDescriptions[1].format = vk::Format::eR32G32B32Sfloat;
+	modelAttributeDescriptions[1].offset = sizeof(float) * 3;
+
+	modelAttributeDescriptions[2].binding = 0;
+	modelAttributeDescriptions[2].location = 2;
+	modelAttributeDescriptions[2].format = vk::Format::eR32G32Sfloat;
+	modelAttributeDescriptions[2].offset = sizeof(float) * 6;
+
+	vk::VertexInputBindingDescription modelInputBindingDescription {};
+	modelInputBindingDescription.binding = 0;
+	modelInputBindingDescription.inputRate = vk::VertexInputRate::eVertex;
+	modelInputBindingDescription.stride = sizeof(float) * 8;
+
+	const vk::PipelineRenderingCreateInfo* sceneRendering = useDynamicRendering ? &sceneRenderingInfo : nullptr;
+
+	// Instances and materials in set 0, the textures come from the bindless set
+	vk::DescriptorSetLayout setLayouts[] = { path == DRAW_DATA_PUSH_DESCRIPTORS ? modelPushDescriptorSetLayout : modelDescriptorSetLayout, bindlessTable.descriptorSetLayout };
+
+	// The push constant path doesn't read the instances, only the materials
+	bool usePushConstants = path == DRAW_DATA_PUSH_CONSTANTS;
+	vk::PushConstantRange pushConstant { vk::ShaderStageFlagBits::eVertex, 0, sizeof(ModelDrawConstants) };
+
+	return createPipeline(context, usePushConstants ? "shaders/model_push.vert.spv" : "shaders/model.vert.spv", "shaders/model.frag.spv", renderPass, swapchain.width, swapchain.height,
+							modelAttributeDescriptions, ARRAY_COUNT(modelAttributeDescriptions), &modelInputBindingDescription, ARRAY_COUNT(setLayouts), setLayouts,
+							usePushConstants ? &pushConstant : nullptr, 0, msaaSamples, sceneRendering, state, dynamicState, libraryCache);
+}
+
+void createPipelines() {
+	vk::VertexInputAttributeDescription vertexAttributeDescriptions[3];
+	vertexAttributeDescriptions[0].binding = 0;
+	vertexAttributeDescriptions[0].location = 0;
+	vertexAttributeDescriptions[0].format = vk::Format::eR32G32Sfloat;
+	vertexAttributeDescriptions[0].offset = 0;
+
+	vertexAttributeDescriptions[1].binding = 0;
+	vertexAttributeDescriptions[1].location = 1;
+	vertexAttributeDescriptions[1].format = vk::Format::eR32G32B32Sfloat;
+	vertexAttributeDescriptions[1].offset = sizeof(float) * 2;
+
+	vertexAttributeDescriptions[2].binding = 0;
+	vertexAttributeDescriptions[2].location = 2;
+	vertexAttributeDescriptions[2].format = vk::Format::eR32G32Sfloat;
+	vertexAttributeDescriptions[2].offset = sizeof(float) * 5;
+
+	vk::VertexInputBindingDescription vertexInputBindingDescription {};
+	vertexInputBindingDescription.binding = 0;
+	vertexInputBindingDescription.inputRate = vk::VertexInputRate::eVertex;
+	vertexInputBindingDescription.stride = sizeof(float) * 7;
+
+	// Texture and sampler slot in the bindless set
+	vk::PushConstantRange pushConstant {};
+	pushConstant.offset = 0;
+	pushConstant.size = sizeof(u32) * 2;
+	pushConstant.stageFlags = vk::ShaderStageFlagBits::eFragment;
+
+	// Only the attachment formats are needed for dynamic rendering
+	sceneRenderingInfo = vk::PipelineRenderingCreateInfo {};
+	sceneRenderingInfo.colorAttachmentCount = 1;
+	sceneRenderingInfo.pColorAttachmentFormats = &swapchain.format;
+	sceneRenderingInfo.depthAttachmentFormat = vk::Format::eD32Sfloat;
+
+	postprocessRenderingInfo = vk::PipelineRenderingCreateInfo {};
+	postprocessRenderingInfo.colorAttachmentCount = 1;
+	postprocessRenderingInfo.pColorAttachmentFormats = &swapchain.format;
+
+	const vk::PipelineRenderingCreateInfo* sceneRendering = useDynamicRendering ? &sceneRenderingInfo : nullptr;
+	const vk::PipelineRenderingCreateInfo* postprocessRendering = useDynamicRendering ? &postprocessRenderingInfo : nullptr;
+
+	spritePipeline = createPipeline(context, "shaders/texture.vert.spv", "shaders/texture.frag.spv", renderPass, swapchain.width, swapchain.height,
+									vertexAttributeDescriptions, ARRAY_COUNT(vertexAttributeDescriptions), &vertexInputBindingDescription, 1, &bindlessTable.descriptorSetLayout, &pushConstant, 0, msaaSamples, sceneRendering);
+	// Model pipelines are created on first use for each state that can't be set dynamically
+	modelPipelineState.sampleCount = msaaSamples;
+	for (u32 path = 0; path < DRAW_DATA_PATH_COUNT; ++path) {
+		modelPipelines[path].backgroundJobs = &pipelineLinkJobs;
+		modelPipelines[path].create = [path](const VulkanPipelineState* state, bool dynamicState) {
+			return createModelPipeline(state, dynamicState, usePipelineLibraries ? &pipelineLibraryCache : nullptr, static_cast<DrawDataPath>(path));
+		};
+	}
+	getPipelineVariant(context, &modelPipelines[DRAW_DATA_INSTANCE_BUFFER], modelPipelineState);
+
+	if (useDynamicRendering && !usesLocalRead()) {
+		postprocessPipeline = createPipeline(context, "shaders/postprocess.vert.spv", "shaders/postprocess_sampled.frag.spv", renderPass, swapchain.width, swapchain.height,
+										nullptr, 0, nullptr, 1, &postprocessSampledDescriptorSetLayout, nullptr, 1, vk::SampleCountFlagBits::e1, postprocessRendering);
+	}
+	else {
+		postprocessPipeline = createPipeline(context, "shaders/postprocess.vert.spv", "shaders/postprocess.frag.spv", renderPass, swapchain.width, swapchain.height,
+										nullptr, 0, nullptr, 1, &postprocessDescriptorSetLayout, nullptr, 1, vk::SampleCountFlagBits::e1, postprocessRendering);
+	}
+}
+
+void destroyPipelines() {
+	destroyPipeline(context, &spritePipeline);
+	for (auto& pipelines : modelPipelines) {
+		destroyPipelineVariants(context, &pipelines);
+	}
+	destroyPipelineLibraryCache(context, &pipelineLibraryCache);
+	destroyPipeline(context, &postprocessPipeline);
+}
+
+// Creates the model pipeline for a fixed set of state permutations, monolithic and through fast-linked pipeline libraries
+void benchmarkPipelineCreation() {
+	std::vector<VulkanPipelineState> permutations;
+	for (vk::CullModeFlags cullMode : { vk::CullModeFlags(vk::CullModeFlagBits::eNone), vk::CullModeFlags(vk::CullModeFlagBits::eBack) }) {
+		for (bool depthWrite : { true, false }) {
+			for (vk::CompareOp compareOp : { vk::CompareOp::eGreaterOrEqual, vk::CompareOp::eGreater }) {
+				for (bool blend : { true, false }) {
+					VulkanPipelineState state {};
+					state.cullMode = cullMode;
+					state.depthWriteEnable = depthWrite;
+					state.depthCompareOp = compareOp;
+					state.blendEnable = blend;
+					state.sampleCount = msaaSamples;
+					permutations.push_back(state);
+				}
+			}
 		}
-		framebuffers.clear();
-		for (auto& depthbuffer : depthBuffers) {
-			destroyImage(context, &depthbuffer);
+	}
+
+	std::vector<VulkanPipeline> pipelines;
+	auto createAll = [&](VulkanPipelineLibraryCache* libraryCache) {
+		auto start = std::chrono::steady_clock::now();
+		for (auto& state : permutations) {
+			pipelines.push_back(createModelPipeline(&state, false, libraryCache, DRAW_DATA_INSTANCE_BUFFER));
 		}
-		destroyRenderPass(context, renderPass);
-		for (auto& colorbuffer : colorBuffers) {
-			destroyImage(context, &colorbuffer);
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	};
+	auto destroyAll = [&]() {
+		for (auto& pipeline : pipelines) {
+			destroyPipeline(context, &pipeline);
 		}
+		pipelines.clear();
+	};
+
+	LOG_INFO("Pipeline creation benchmark: " + std::to_string(permutations.size()) + " permutations");
+
+	double monolithicTime = createAll(nullptr);
+	destroyAll();
+	LOG_INFO("Monolithic: " + std::to_string(monolithicTime) + " ms");
+
+	if (!context->features.graphicsPipelineLibrary) {
+		LOG_INFO("Graphics pipeline libraries not supported");
+		return;
 	}
-	framebuffers.clear();
-	depthBuffers.clear();
-	colorBuffers.clear();
 
-	renderPass = createRenderPass(context, swapchain.format, msaaSamples);
+	VulkanPipelineLibraryCache libraryCache;
+	double coldTime = createAll(&libraryCache);
+	destroyAll();
+	double warmTime = createAll(&libraryCache);
+
+	auto start = std::chrono::steady_clock::now();
+	for (auto& pipeline : pipelines) {
+		VK(context->device.destroyPipeline(linkPipelineLibraries(context, &pipeline, true)));
+	}
+	double optimizedTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
 
-	framebuffers.resize(swapchain.images.size());
-	depthBuffers.resize(swapchain.images.size());
-	colorBuffers.resize(swapchain.images.size());
+	destroyAll();
+	size_t libraryCount = libraryCache.libraries.size();
+	destroyPipelineLibraryCache(context, &libraryCache);
 
-	for (u32 i = 0; i < swapchain.images.size(); i++) {
-		createImage(context, &depthBuffers.data()[i], swapchain.width, swapchain.height, vk::Format::eD32Sfloat, vk::ImageUsageFlagBits::eDepthStencilAttachment, msaaSamples);
-		createImage(context, &colorBuffers.data()[i], swapchain.width, swapchain.height, swapchain.format, vk::ImageUsageFlagBits::eColorAttachment, msaaSamples);
+	LOG_INFO("Fast-link (cold library cache): " + std::to_string(coldTime) + " ms, " + std::to_string(libraryCount) + " libraries");
+	LOG_INFO("Fast-link (warm library cache): " + std::to_string(warmTime) + " ms");
+	LOG_INFO("Optimized link: " + std::to_string(optimizedTime) + " ms");
+}
 
-		vk::ImageView attachments[3] = {
-			colorBuffers[i].imageView,
-			depthBuffers[i].imageView,
-			swapchain.imageViews[i]
-		};
-		vk::FramebufferCreateInfo framebufferCreateInfo {};
-		framebufferCreateInfo.renderPass = renderPass;
-		framebufferCreateInfo.attachmentCount = ARRAY_COUNT(attachments);
-		framebufferCreateInfo.pAttachments = attachments;
-		framebufferCreateInfo.width = swapchain.width;
-		framebufferCreateInfo.height = swapchain.height;
-		framebufferCreateInfo.layers = 1;
+// The first two models keep their original place, the rest fill a grid next to them
+glm::vec3 getModelPosition(u32 index) {
+	return glm::vec3(static_cast<float>((index / 2) % 32) * 3.0f, static_cast<float>((index / 2) / 32) * 3.0f, 5.0f + 5.0f * static_cast<float>(index % 2));
+}
+
+u32 getModelNode(u32 index) {
+	return sceneModelCount + index;
+}
 
-		framebuffers[i] = VKA(context->device.createFramebuffer(framebufferCreateInfo));
+void buildScene() {
+	scene.clear();
+	scene.reserve(modelCount * 2);
+	for (u32 i = 0; i < modelCount; ++i) {
+		scene.addNode(Scene::NO_PARENT, getModelPosition(i));
+	}
+	for (u32 i = 0; i < modelCount; ++i) {
+		scene.addNode(i, glm::vec3(0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(100.0f));
 	}
+	sceneModelCount = modelCount;
 }
 
-void recreateSwapchain() {
-	VulkanSwapchain oldSwapchain = swapchain;
+// Only the spinning nodes change, the grid nodes above them are skipped by the update
+void updateScene(float time) {
+	if (sceneModelCount != modelCount) {
+		buildScene();
+	}
 
-	VKA(context->device.waitIdle());
+	auto start = std::chrono::steady_clock::now();
+
+	glm::quat rotation = glm::angleAxis(-time, glm::vec3(0.0f, 1.0f, 0.0f));
+	for (u32 i = 0; i < modelCount; ++i) {
+		scene.setRotation(getModelNode(i), rotation);
+	}
+	scene.updateTransforms(&jobSystem);
+
+	transformUpdateTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void updateCullDescriptorSet(u32 frameIndex) {
+	vk::DescriptorBufferInfo bufferInfos[] = {
+		{ cullParameterBuffers[frameIndex].buffer, 0, VK_WHOLE_SIZE },
+		{ modelObjectBuffer.buffer, 0, VK_WHOLE_SIZE },
+		{ modelInstanceBuffers[frameIndex].buffer, 0, VK_WHOLE_SIZE },
+		{ drawCommandBuffers[frameIndex].buffer, 0, VK_WHOLE_SIZE },
+		{ drawCountBuffers[frameIndex].buffer, 0, VK_WHOLE_SIZE },
+	};
+
+	vk::WriteDescriptorSet descriptorWrites[ARRAY_COUNT(bufferInfos)];
+	for (u32 binding = 0; binding < ARRAY_COUNT(bufferInfos); ++binding) {
+		descriptorWrites[binding].dstSet = cullDescriptorSets[frameIndex];
+		descriptorWrites[binding].dstBinding = binding;
+		descriptorWrites[binding].descriptorCount = 1;
+		descriptorWrites[binding].descriptorType = binding == 0 ? vk::DescriptorType::eUniformBuffer : vk::DescriptorType::eStorageBuffer;
+		descriptorWrites[binding].pBufferInfo = &bufferInfos[binding];
+	}
+
+	VK(context->device.updateDescriptorSets(ARRAY_COUNT(descriptorWrites), descriptorWrites, 0, nullptr));
+}
+
+// Holds the transforms of every model copy, both the per-draw and the instanced path read them by instance index
+void resizeModelInstanceBuffers(u32 capacity) {
+	if (modelObjectBuffer.buffer) {
+		destroyBuffer(context, &modelObjectBuffer);
+	}
+	createBuffer(context, &modelObjectBuffer, sizeof(ModelObject) * capacity, vk::BufferUsageFlagBits::eStorageBuffer, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+	modelObjectCount = 0;
+
+	for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+		if (modelInstanceBuffers[i].buffer) {
+			destroyBuffer(context, &modelInstanceBuffers[i]);
+		}
+		createBuffer(context, &modelInstanceBuffers[i], sizeof(ModelInstance) * capacity, vk::BufferUsageFlagBits::eStorageBuffer, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+
+		if (modelDescriptorSets[i]) {
+			vk::DescriptorBufferInfo descriptorBufferInfo = { modelInstanceBuffers[i].buffer, 0, VK_WHOLE_SIZE };
+
+			vk::WriteDescriptorSet descriptorWrite;
+			descriptorWrite.dstSet = modelDescriptorSets[i];
+			descriptorWrite.dstBinding = 0;
+			descriptorWrite.descriptorCount = 1;
+			descriptorWrite.descriptorType = vk::DescriptorType::eStorageBuffer;
+			descriptorWrite.pBufferInfo = &descriptorBufferInfo;
+
+			VK(context->device.updateDescriptorSets(1, &descriptorWrite, 0, nullptr));
+		}
+
+		if (drawCommandBuffers[i].buffer) {
+			destroyBuffer(context, &drawCommandBuffers[i]);
+		}
+		createBuffer(context, &drawCommandBuffers[i], sizeof(vk::DrawIndexedIndirectCommand) * capacity, vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+		if (cullDescriptorSets[i]) {
+			updateCullDescriptorSet(i);
+		}
+	}
+	modelInstanceCapacity = capacity;
+}
+
+void updateModelMaterials() {
+	modelMaterials.resize(modelCount);
+	for (u32 i = 0; i < modelCount; ++i) {
+		modelMaterials[i] = useMixedMaterials ? i % static_cast<u32>(materials.size()) : 0;
+	}
+}
+
+// Objects only change with the model count or materials, the animation is applied by the cull shader
+void writeModelObjects() {
+	if (modelMaterials.size() != modelCount) {
+		updateModelMaterials();
+	}
+
+	void* mapped;
+	VK(context->device.mapMemory(modelObjectBuffer.memory, 0, sizeof(ModelObject) * modelCount, {}, &mapped));
+
+	ModelObject* objects = static_cast<ModelObject*>(mapped);
+	for (u32 i = 0; i < modelCount; ++i) {
+		objects[i].transform = glm::translate(glm::mat4(1.0f), getModelPosition(i));
+		objects[i].boundingSphere = model.boundingSphere;
+		objects[i].materialIndex = modelMaterials[i];
+	}
+
+	VK(context->device.unmapMemory(modelObjectBuffer.memory));
+	modelObjectCount = modelCount;
+}
+
+void initImGuiVulkan() {
+	ImGui_ImplVulkan_InitInfo imguiInitInfo {};
+	imguiInitInfo.Instance = context->instance;
+	imguiInitInfo.PhysicalDevice = context->physicalDevice;
+	imguiInitInfo.Device = context->device;
+	imguiInitInfo.QueueFamily = context->graphicsQueue.familyIndex;
+	imguiInitInfo.Queue = context->graphicsQueue.queue;
+	imguiInitInfo.DescriptorPool = nullptr;
+	imguiInitInfo.DescriptorPoolSize = 1000;
+	imguiInitInfo.MinImageCount = 2;
+	imguiInitInfo.ImageCount = swapchain.images.size();
+	imguiInitInfo.MSAASamples = static_cast<VkSampleCountFlagBits>(msaaSamples);
 
-	swapchain = createSwapchain(context, surface, vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eInputAttachment, &oldSwapchain);
+	if (useDynamicRendering) {
+		imguiInitInfo.UseDynamicRendering = true;
+		imguiInitInfo.PipelineRenderingCreateInfo = sceneRenderingInfo;
+	}
+	else {
+		imguiInitInfo.RenderPass = renderPass;
+	}
 
-	destroySwapchain(context, &oldSwapchain);
-	recreateRenderPass();
+	ImGui_ImplVulkan_Init(&imguiInitInfo);
 }
 
-void initApplication(SDL_Window* window) {
-	SDL_SetWindowPosition(window, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED);
+void switchRenderingPath(bool dynamicRendering) {
+	// The ImGui backend destroys its objects right away
+	waitTimeline(context, context->timeline.submittedValue);
+
+	ImGui_ImplVulkan_Shutdown();
+	destroyPipelines();
+
+	useDynamicRendering = dynamicRendering;
+	recreateFrameGraph();
+
+	createPipelines();
+	initImGuiVulkan();
+
+	LOG_INFO("Rendering path: " + std::string{ useDynamicRendering ? (usesLocalRead() ? "dynamic rendering (local read)" : "dynamic rendering") : "render pass" });
+}
+
+// Highest count up to the requested one, software rasterizers like lavapipe don't have 8x MSAA
+vk::SampleCountFlagBits getSupportedSampleCount(vk::SampleCountFlagBits samples) {
+	vk::SampleCountFlags supportedSampleCounts = context->physicalDeviceProperties.limits.framebufferColorSampleCounts
+												& context->physicalDeviceProperties.limits.framebufferDepthSampleCounts;
+	while (samples != vk::SampleCountFlagBits::e1 && !(supportedSampleCounts & samples)) {
+		samples = static_cast<vk::SampleCountFlagBits>(static_cast<u32>(samples) >> 1);
+	}
+	return samples;
+}
+
+// The scene pipelines, the frame graph and the ImGui backend all depend on the sample count
+void switchMsaaSamples(vk::SampleCountFlagBits samples) {
+	samples = getSupportedSampleCount(samples);
+	if (samples == msaaSamples) {
+		return;
+	}
+
+	waitTimeline(context, context->timeline.submittedValue);
+
+	ImGui_ImplVulkan_Shutdown();
+	destroyPipelines();
+
+	msaaSamples = samples;
+	recreateFrameGraph();
+
+	createPipelines();
+	initImGuiVulkan();
+
+	LOG_INFO("MSAA samples: " + vk::to_string(msaaSamples));
+}
+
+// Without a window the application runs headless
+bool initApplication(SDL_Window* window) {
+	PROFILE_FUNCTION();
 
 	u32 sdlExtensionCount = 0;
-	const char *const *sdlExtensions = SDL_Vulkan_GetInstanceExtensions(&sdlExtensionCount);
+	const char *const *sdlExtensions = nullptr;
+	if (window) {
+		SDL_SetWindowPosition(window, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED);
+		sdlExtensions = SDL_Vulkan_GetInstanceExtensions(&sdlExtensionCount);
+	}
 
 	std::vector<const char*> enabledInstanceExtensions;
 	enabledInstanceExtensions.reserve(sdlExtensionCount + 2);
@@ -190,13 +742,26 @@ void initApplication(SDL_Window* window) {
 
 	const char* enableDeviceExtensions[] { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
 
-	initVulkan(context, instanceExtensionsCount, enabledInstanceExtensions.data(), ARRAY_COUNT(enableDeviceExtensions), enableDeviceExtensions);
+	if (!initVulkan(context, instanceExtensionsCount, enabledInstanceExtensions.data(), headless ? 0 : ARRAY_COUNT(enableDeviceExtensions), enableDeviceExtensions)) {
+		return false;
+	}
+
+	msaaSamples = getSupportedSampleCount(msaaSamples);
+	LOG_INFO("MSAA samples: " + vk::to_string(msaaSamples));
 
-	SDL_Vulkan_CreateSurface(window, context->instance, nullptr, &surface);
-	swapchain = createSwapchain(context, surface, vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eInputAttachment);
-	renderPass = createRenderPass(context, swapchain.format, msaaSamples);
+	if (headless) {
+		// One image per frame slot, a frame renders into the image of its slot. Transfer source to read the result back
+		swapchain = createOffscreenSwapchain(context, headlessWidth, headlessHeight, vk::Format::eR8G8B8A8Unorm,
+											 vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eInputAttachment | vk::ImageUsageFlagBits::eTransferSrc,
+											 MAX_FRAMES_IN_FLIGHT);
+	}
+	else {
+		SDL_Vulkan_CreateSurface(window, context->instance, nullptr, &surface);
+		supportedPresentModes = VKA(context->physicalDevice.getSurfacePresentModesKHR(surface));
+		swapchain = createSwapchain(context, surface, vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eInputAttachment, nullptr, presentMode);
+	}
 
-	recreateRenderPass();
+	recreateFrameGraph();
 
 	model = createModel(context, "data/models/BoomBox.glb", "data/models", cgltf_component_type_r_16u);
 
@@ -225,71 +790,38 @@ void initApplication(SDL_Window* window) {
 	uploadDataToImage(context, &image, data, static_cast<u32>(width * height * STBI_rgb_alpha), static_cast<u32>(width), static_cast<u32>(height), vk::ImageLayout::eShaderReadOnlyOptimal, vk::AccessFlagBits::eNone);
 	stbi_image_free(data);
 
-	u64 minUniformAlignment = context->physicalDeviceProperties.limits.minUniformBufferOffsetAlignment;
-	singleElementSize = ALIGN_UP_POW2(sizeof(glm::mat4) * 2, minUniformAlignment);
-
-	{
-		vk::DescriptorPoolSize poolSizes[] = {
-			{vk::DescriptorType::eCombinedImageSampler, 1}
-		};
-
-		vk::DescriptorPoolCreateInfo descriptorPoolCreateInfo {};
-		descriptorPoolCreateInfo.maxSets = 1;
-		descriptorPoolCreateInfo.poolSizeCount = ARRAY_COUNT(poolSizes);
-		descriptorPoolCreateInfo.pPoolSizes = poolSizes;
+	createBindlessTable(context, &bindlessTable, 4096, 16);
+	samplerSlot = registerBindlessSampler(context, &bindlessTable, sampler);
+	imageSlot = registerBindlessTexture(context, &bindlessTable, image.imageView);
 
-		spriteDescriptorPool = VKA(context->device.createDescriptorPool(descriptorPoolCreateInfo));
-
-		vk::DescriptorSetLayoutBinding bindings[] = {
-			{0, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eFragment, nullptr},
-		};
-
-		vk::DescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo {};
-		descriptorSetLayoutCreateInfo.bindingCount = ARRAY_COUNT(bindings);
-		descriptorSetLayoutCreateInfo.pBindings = bindings;
-
-		spriteDescriptorSetLayout = VKA(context->device.createDescriptorSetLayout(descriptorSetLayoutCreateInfo));
-
-		vk::DescriptorSetAllocateInfo descriptorSetAllocateInfo {};
-		descriptorSetAllocateInfo.descriptorPool = spriteDescriptorPool;
-		descriptorSetAllocateInfo.descriptorSetCount = 1;
-		descriptorSetAllocateInfo.pSetLayouts = &spriteDescriptorSetLayout;
-
-		spriteDescriptorSet = VKA(context->device.allocateDescriptorSets(descriptorSetAllocateInfo)).front();
-
-		vk::DescriptorImageInfo descriptorImageInfo = { sampler, image.imageView, vk::ImageLayout::eShaderReadOnlyOptimal};
-
-		vk::WriteDescriptorSet descriptorWrites [1];
-		descriptorWrites[0].dstSet = spriteDescriptorSet;
-		descriptorWrites[0].dstBinding = 0;
-		descriptorWrites[0].descriptorCount = 1;
-		descriptorWrites[0].descriptorType = vk::DescriptorType::eCombinedImageSampler;
-		descriptorWrites[0].pImageInfo = &descriptorImageInfo;
-
-		VK(context->device.updateDescriptorSets(ARRAY_COUNT(descriptorWrites), descriptorWrites, 0, nullptr));
-	}
+	// Material 0 is the model's own, the others only show up with mixed materials
+	materials = {
+		{ registerBindlessTexture(context, &bindlessTable, model.albedoTexture.imageView), samplerSlot },
+		{ imageSlot, samplerSlot },
+	};
+	createBuffer(context, &materialBuffer, sizeof(Material) * materials.size(), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst, vk::MemoryPropertyFlagBits::eDeviceLocal);
+	uploadDataToBuffer(context, &materialBuffer, materials.data(), sizeof(Material) * materials.size());
 
 	// Model
 	{
-		for (u32 i = 0; i < FRAMES_IN_FLIGHT; ++i) {
-			createBuffer(context, &modelUniformBuffers[i], singleElementSize * 2, vk::BufferUsageFlagBits::eUniformBuffer, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
-		}
+		resizeModelInstanceBuffers(modelCount);
+
+		// Sized for the largest set, the culling one, a full pool just chains the next one
 		vk::DescriptorPoolSize poolSizes[] = {
-			{ vk::DescriptorType::eUniformBufferDynamic, FRAMES_IN_FLIGHT },
-			{ vk::DescriptorType::eCombinedImageSampler, FRAMES_IN_FLIGHT },
-				{ vk::DescriptorType::eInputAttachment, FRAMES_IN_FLIGHT }
+			{ vk::DescriptorType::eStorageBuffer, 4 },
+			{ vk::DescriptorType::eUniformBuffer, 1 },
 		};
+		initDescriptorAllocator(&descriptorAllocator, 16, poolSizes, ARRAY_COUNT(poolSizes));
 
-		vk::DescriptorPoolCreateInfo descriptorPoolCreateInfo {};
-		descriptorPoolCreateInfo.maxSets = FRAMES_IN_FLIGHT * 2;
-		descriptorPoolCreateInfo.poolSizeCount = ARRAY_COUNT(poolSizes);
-		descriptorPoolCreateInfo.pPoolSizes = poolSizes;
-
-		modelDescriptorPool = VKA(context->device.createDescriptorPool(descriptorPoolCreateInfo));
+		vk::DescriptorPoolSize cachePoolSizes[] = {
+			{ vk::DescriptorType::eCombinedImageSampler, 1 },
+			{ vk::DescriptorType::eInputAttachment, 1 },
+		};
+		initDescriptorAllocator(&descriptorCache.allocator, 16, cachePoolSizes, ARRAY_COUNT(cachePoolSizes));
 
 		vk::DescriptorSetLayoutBinding bindings[] = {
-			{ 0, vk::DescriptorType::eUniformBufferDynamic, 1, vk::ShaderStageFlagBits::eVertex, nullptr },
-			{ 1, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eFragment, &sampler }
+			{ 0, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eVertex, nullptr },
+			{ 1, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eFragment, nullptr }
 		};
 
 		vk::DescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo {};
@@ -298,29 +830,33 @@ void initApplication(SDL_Window* window) {
 
 		modelDescriptorSetLayout = VKA(context->device.createDescriptorSetLayout(descriptorSetLayoutCreateInfo));
 
-		for (u32 i = 0; i < FRAMES_IN_FLIGHT; ++i) {
-			vk::DescriptorSetAllocateInfo descriptorSetAllocateInfo {};
-			descriptorSetAllocateInfo.descriptorPool = modelDescriptorPool;
-			descriptorSetAllocateInfo.descriptorSetCount = 1;
-			descriptorSetAllocateInfo.pSetLayouts = &modelDescriptorSetLayout;
+		// Same bindings, written into the command buffer with every draw instead of allocated
+		if (context->features.pushDescriptor) {
+			descriptorSetLayoutCreateInfo.flags = vk::DescriptorSetLayoutCreateFlagBits::ePushDescriptorKHR;
+			modelPushDescriptorSetLayout = VKA(context->device.createDescriptorSetLayout(descriptorSetLayoutCreateInfo));
+
+			u32 alignment = static_cast<u32>(context->physicalDeviceProperties.limits.minStorageBufferOffsetAlignment);
+			pushDescriptorInstanceStep = alignment / std::gcd(static_cast<u32>(sizeof(ModelInstance)), alignment);
+		}
 
-			modelDescriptorSets[i] = VKA(context->device.allocateDescriptorSets(descriptorSetAllocateInfo)).front();
+		for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+			modelDescriptorSets[i] = allocateDescriptorSet(context, &descriptorAllocator, modelDescriptorSetLayout);
 
-			vk::DescriptorBufferInfo descriptorBufferInfo = { modelUniformBuffers[i].buffer, 0, sizeof(glm::mat4) * 2 };
-			vk::DescriptorImageInfo descriptorImageInfo = { sampler, model.albedoTexture.imageView, vk::ImageLayout::eShaderReadOnlyOptimal };
+			vk::DescriptorBufferInfo descriptorBufferInfo = { modelInstanceBuffers[i].buffer, 0, VK_WHOLE_SIZE };
+			vk::DescriptorBufferInfo materialBufferInfo = { materialBuffer.buffer, 0, VK_WHOLE_SIZE };
 
 			vk::WriteDescriptorSet descriptorWrites [2];
 			descriptorWrites[0].dstSet = modelDescriptorSets[i];
 			descriptorWrites[0].dstBinding = 0;
 			descriptorWrites[0].descriptorCount = 1;
-			descriptorWrites[0].descriptorType = vk::DescriptorType::eUniformBufferDynamic;
+			descriptorWrites[0].descriptorType = vk::DescriptorType::eStorageBuffer;
 			descriptorWrites[0].pBufferInfo = &descriptorBufferInfo;
 
 			descriptorWrites[1].dstSet = modelDescriptorSets[i];
 			descriptorWrites[1].dstBinding = 1;
 			descriptorWrites[1].descriptorCount = 1;
-			descriptorWrites[1].descriptorType = vk::DescriptorType::eCombinedImageSampler;
-			descriptorWrites[1].pImageInfo = &descriptorImageInfo;
+			descriptorWrites[1].descriptorType = vk::DescriptorType::eStorageBuffer;
+			descriptorWrites[1].pBufferInfo = &materialBufferInfo;
 
 			VK(context->device.updateDescriptorSets(ARRAY_COUNT(descriptorWrites), descriptorWrites, 0, nullptr));
 		}
@@ -336,164 +872,648 @@ void initApplication(SDL_Window* window) {
 		descriptorSetLayoutCreateInfo.pBindings = bindings;
 
 		postprocessDescriptorSetLayout = VKA(context->device.createDescriptorSetLayout(descriptorSetLayoutCreateInfo));
+	}
+
+	// Post processing without input attachments, used by dynamic rendering without local read
+	{
+		vk::DescriptorSetLayoutBinding bindings[] = {
+			{ 0, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eFragment, &sampler },
+		};
+
+		vk::DescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo {};
+		descriptorSetLayoutCreateInfo.bindingCount = ARRAY_COUNT(bindings);
+		descriptorSetLayoutCreateInfo.pBindings = bindings;
+
+		postprocessSampledDescriptorSetLayout = VKA(context->device.createDescriptorSetLayout(descriptorSetLayoutCreateInfo));
+	}
+
+	// GPU culling
+	{
+		vk::DescriptorSetLayoutBinding bindings[] = {
+			{ 0, vk::DescriptorType::eUniformBuffer, 1, vk::ShaderStageFlagBits::eCompute, nullptr },
+			{ 1, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute, nullptr },
+			{ 2, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute, nullptr },
+			{ 3, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute, nullptr },
+			{ 4, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute, nullptr },
+		};
+
+		vk::DescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo {};
+		descriptorSetLayoutCreateInfo.bindingCount = ARRAY_COUNT(bindings);
+		descriptorSetLayoutCreateInfo.pBindings = bindings;
 
-		for (u32 i = 0; i < FRAMES_IN_FLIGHT; ++i) {
-			vk::DescriptorSetAllocateInfo descriptorSetAllocateInfo {};
-			descriptorSetAllocateInfo.descriptorPool = modelDescriptorPool;
-			descriptorSetAllocateInfo.descriptorSetCount = 1;
-			descriptorSetAllocateInfo.pSetLayouts = &postprocessDescriptorSetLayout;
+		cullDescriptorSetLayout = VKA(context->device.createDescriptorSetLayout(descriptorSetLayoutCreateInfo));
 
-			postprocessDescriptorSets[i] = VKA(context->device.allocateDescriptorSets(descriptorSetAllocateInfo)).front();
+		for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+			createBuffer(context, &cullParameterBuffers[i], sizeof(CullParameters), vk::BufferUsageFlagBits::eUniformBuffer, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+			// Host visible so the visible count can be shown after the frame's fence
+			createBuffer(context, &drawCountBuffers[i], sizeof(u32), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eTransferDst, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+
+			void* mapped;
+			VK(context->device.mapMemory(drawCountBuffers[i].memory, 0, sizeof(u32), {}, &mapped));
+			*static_cast<u32*>(mapped) = 0;
+			VK(context->device.unmapMemory(drawCountBuffers[i].memory));
+
+			cullDescriptorSets[i] = allocateDescriptorSet(context, &descriptorAllocator, cullDescriptorSetLayout);
+			updateCullDescriptorSet(i);
 		}
+
+		cullPipeline = createComputePipeline(context, "shaders/model_cull.comp.spv", 1, &cullDescriptorSetLayout);
 	}
-	vk::VertexInputAttributeDescription vertexAttributeDescriptions[3];
-	vertexAttributeDescriptions[0].binding = 0;
-	vertexAttributeDescriptions[0].location = 0;
-	vertexAttributeDescriptions[0].format = vk::Format::eR32G32Sfloat;
-	vertexAttributeDescriptions[0].offset = 0;
 
-	vertexAttributeDescriptions[1].binding = 0;
-	vertexAttributeDescriptions[1].location = 1;
-	vertexAttributeDescriptions[1].format = vk::Format::eR32G32B32Sfloat;
-	vertexAttributeDescriptions[1].offset = sizeof(float) * 2;
+	createGpuProfiler(context, &gpuProfiler, MAX_FRAMES_IN_FLIGHT);
 
-	vertexAttributeDescriptions[2].binding = 0;
-	vertexAttributeDescriptions[2].location = 2;
-	vertexAttributeDescriptions[2].format = vk::Format::eR32G32Sfloat;
-	vertexAttributeDescriptions[2].offset = sizeof(float) * 5;
+	usePipelineLibraries = context->features.graphicsPipelineLibrary;
+	createPipelines();
 
-	vk::VertexInputBindingDescription vertexInputBindingDescription {};
-	vertexInputBindingDescription.binding = 0;
-	vertexInputBindingDescription.inputRate = vk::VertexInputRate::eVertex;
-	vertexInputBindingDescription.stride = sizeof(float) * 7;
+	for (auto &acquireSemaphore : acquireSemaphores) {
+		vk::SemaphoreCreateInfo semaphoreCreateInfo {};
+		acquireSemaphore = VKA(context->device.createSemaphore(semaphoreCreateInfo));
+	}
 
-	vk::VertexInputAttributeDescription modelAttributeDescriptions[3];
-	modelAttributeDescriptions[0].binding = 0;
-	modelAttributeDescriptions[0].location = 0;
-	modelAttributeDescriptions[0].format = vk::Format::eR32G32B32Sfloat;
-	modelAttributeDescriptions[0].offset = 0;
+	for (auto &releaseSemaphore : releaseSemaphores) {
+		vk::SemaphoreCreateInfo semaphoreCreateInfo {};
+		releaseSemaphore = VKA(context->device.createSemaphore(semaphoreCreateInfo));
+	}
 
-	modelAttributeDescriptions[1].binding = 0;
-	modelAttributeDescriptions[1].location = 1;
-	modelAttributeDescriptions[1].format = vk::Format::eR32G32B32Sfloat;
-	modelAttributeDescriptions[1].offset = sizeof(float) * 3;
+	for (auto &commandPool : commandPools) {
+		vk::CommandPoolCreateInfo commandPoolCreateInfo {};
+		commandPoolCreateInfo.flags = vk::CommandPoolCreateFlagBits::eTransient;
+		commandPoolCreateInfo.queueFamilyIndex = context->graphicsQueue.familyIndex;
 
-	modelAttributeDescriptions[2].binding = 0;
-	modelAttributeDescriptions[2].location = 2;
-	modelAttributeDescriptions[2].format = vk::Format::eR32G32Sfloat;
-	modelAttributeDescriptions[2].offset = sizeof(float) * 6;
+		commandPool = VKA(context->device.createCommandPool(commandPoolCreateInfo));
+	}
 
-	vk::VertexInputBindingDescription modelInputBindingDescription {};
-	modelInputBindingDescription.binding = 0;
-	modelInputBindingDescription.inputRate = vk::VertexInputRate::eVertex;
-	modelInputBindingDescription.stride = sizeof(float) * 8;
+	for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+		vk::CommandBufferAllocateInfo commandBufferAllocateInfo {};
+		commandBufferAllocateInfo.commandPool = commandPools[i];
+		commandBufferAllocateInfo.level = vk::CommandBufferLevel::ePrimary;
+		commandBufferAllocateInfo.commandBufferCount = 1;
+
+		auto commandBuffersCreated = VKA(context->device.allocateCommandBuffers(commandBufferAllocateInfo));
+		commandBuffers[i] = commandBuffersCreated.front();
+
+		commandBufferAllocateInfo.level = vk::CommandBufferLevel::eSecondary;
+		imguiCommandBuffers[i] = VKA(context->device.allocateCommandBuffers(commandBufferAllocateInfo)).front();
+	}
+
+	recordingThreadCount = jobSystem.getNumThreads();
+	for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+		for (u32 thread = 0; thread < recordingThreadCount; ++thread) {
+			vk::CommandPoolCreateInfo commandPoolCreateInfo {};
+			commandPoolCreateInfo.flags = vk::CommandPoolCreateFlagBits::eTransient;
+			commandPoolCreateInfo.queueFamilyIndex = context->graphicsQueue.familyIndex;
+
+			vk::CommandPool commandPool = VKA(context->device.createCommandPool(commandPoolCreateInfo));
+
+			vk::CommandBufferAllocateInfo commandBufferAllocateInfo {};
+			commandBufferAllocateInfo.commandPool = commandPool;
+			commandBufferAllocateInfo.level = vk::CommandBufferLevel::eSecondary;
+			commandBufferAllocateInfo.commandBufferCount = 1;
+
+			recordingCommandPools[i].push_back(commandPool);
+			recordingCommandBuffers[i].push_back(VKA(context->device.allocateCommandBuffers(commandBufferAllocateInfo)).front());
+		}
+	}
+
+	// vertex buffer
+	createBuffer(context, &spriteVertexBuffer, sizeof(vertexData), vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst, vk::MemoryPropertyFlagBits::eDeviceLocal);
+	uploadDataToBuffer(context, &spriteVertexBuffer, vertexData, sizeof(vertexData));
+
+	// index buffer
+	createBuffer(context, &spriteIndexBuffer, sizeof(indexData), vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eTransferDst, vk::MemoryPropertyFlagBits::eDeviceLocal);
+	uploadDataToBuffer(context, &spriteIndexBuffer, indexData, sizeof(indexData));
+
+	// Init camera
+
+	camera.position = glm::vec3(0.0f);
+	camera.direction = glm::vec3(0.0f, 0.0f, 1.0f);
+	camera.up = glm::vec3(0.0f, 1.0f, 0.0f);
+	camera.yaw = 0.0f;
+	camera.pitch = 0.0f;
+
+	ImGui::CreateContext();
+	ImGui::StyleColorsDark();
+
+	// Headless frames set the display size themselves
+	if (window) {
+		ImGui_ImplSDL3_InitForVulkan(window);
+	}
+
+	initImGuiVulkan();
+	return true;
+}
+
+// Secondary command buffers that continue the scene pass of either rendering path
+void beginSecondaryCommandBuffer(vk::CommandBuffer commandBuffer, u32 imageIndex) {
+	vk::CommandBufferInheritanceRenderingInfo inheritanceRenderingInfo {};
+	inheritanceRenderingInfo.colorAttachmentCount = 1;
+	inheritanceRenderingInfo.pColorAttachmentFormats = &swapchain.format;
+	inheritanceRenderingInfo.depthAttachmentFormat = vk::Format::eD32Sfloat;
+	inheritanceRenderingInfo.rasterizationSamples = msaaSamples;
+
+	vk::CommandBufferInheritanceInfo inheritanceInfo {};
+	if (useDynamicRendering) {
+		inheritanceInfo.pNext = &inheritanceRenderingInfo;
+	}
+	else {
+		inheritanceInfo.renderPass = renderPass;
+		inheritanceInfo.subpass = frameGraph.passes[scenePass].subpass;
+		inheritanceInfo.framebuffer = getRenderGraphFramebuffer(&frameGraph, scenePass, imageIndex);
+	}
+
+	vk::CommandBufferBeginInfo commandBufferBeginInfo {};
+	commandBufferBeginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit | vk::CommandBufferUsageFlagBits::eRenderPassContinue;
+	commandBufferBeginInfo.pInheritanceInfo = &inheritanceInfo;
+
+	VKA(commandBuffer.begin(commandBufferBeginInfo));
+
+	// Dynamic state is not inherited from the primary command buffer
+	vk::Viewport viewport { 0.0f, 0.0f, static_cast<float>(swapchain.width), static_cast<float>(swapchain.height), 0.0f, 1.0f};
+	vk::Rect2D scissor { {0, 0}, {swapchain.width, swapchain.height} } ;
+
+	commandBuffer.setViewport(0, 1, &viewport);
+	commandBuffer.setScissor(0, 1, &scissor);
+}
+
+// Instance i belongs to the i-th visible model, the world matrices come straight from the scene
+void writeModelInstances(ModelInstance* instances, u32 begin, u32 end) {
+	const glm::mat4* modelMatrices = scene.getWorldMatrices() + getModelNode(0);
+	computeModelInstances(camera.viewProjection, camera.view, modelMatrices, modelMaterials.data(), visibleModels.data() + begin, end - begin, instances + begin);
+}
+
+// Push constant draws keep their data on the CPU until they are recorded
+void writeModelDrawConstants(u32 begin, u32 end) {
+	const glm::mat4* modelMatrices = scene.getWorldMatrices() + getModelNode(0);
+	computeModelDrawConstants(camera.viewProjection, camera.view, modelMatrices, modelMaterials.data(), visibleModels.data() + begin, end - begin, modelDrawConstants.data() + begin);
+}
+
+// Instanced and GPU culled draws always read the instance buffer
+DrawDataPath getModelDrawDataPath() {
+	return useInstancing || useGpuCulling ? DRAW_DATA_INSTANCE_BUFFER : static_cast<DrawDataPath>(drawDataPath);
+}
+
+void bindModelPipeline(vk::CommandBuffer commandBuffer, u32 frameIndex, const VulkanPipeline* modelPipeline, DrawDataPath path) {
+	vk::DeviceSize offset = 0;
+	commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, modelPipeline->pipeline);
+	setPipelineState(commandBuffer, modelPipeline, modelPipelineState);
+	commandBuffer.bindVertexBuffers(0, 1, &model.vertexBuffer.buffer, &offset);
+	commandBuffer.bindIndexBuffer(model.indexBuffer.buffer, 0, vk::IndexType::eUint16);
+	if (path == DRAW_DATA_PUSH_DESCRIPTORS) {
+		// Set 0 comes with every draw
+		commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, modelPipeline->pipelineLayout, 1, 1, &bindlessTable.descriptorSet, 0, nullptr);
+		return;
+	}
+
+	// Materials are selected per instance, this is the only descriptor bind of the pass
+	vk::DescriptorSet descriptorSets[] = { modelDescriptorSets[frameIndex], bindlessTable.descriptorSet };
+	commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, modelPipeline->pipelineLayout, 0, ARRAY_COUNT(descriptorSets), descriptorSets, 0, nullptr);
+}
+
+// Without instancing every copy is its own draw, firstInstance selects its transform unless the draw brings its own data
+void recordModelDraws(vk::CommandBuffer commandBuffer, u32 imageIndex, u32 frameIndex, const VulkanPipeline* modelPipeline, u32 begin, u32 end, u32 instanceCount, DrawDataPath path) {
+	beginSecondaryCommandBuffer(commandBuffer, imageIndex);
+
+	{
+		SCOPE_LABEL("Models");
+
+		bindModelPipeline(commandBuffer, frameIndex, modelPipeline, path);
+		if (path == DRAW_DATA_PUSH_CONSTANTS) {
+			for (u32 i = begin; i < end; ++i) {
+				commandBuffer.pushConstants(modelPipeline->pipelineLayout, vk::ShaderStageFlagBits::eVertex, 0, sizeof(ModelDrawConstants), &modelDrawConstants[i]);
+				commandBuffer.drawIndexed(model.numIndices, 1, 0, 0, 0);
+			}
+		}
+		else if (path == DRAW_DATA_PUSH_DESCRIPTORS) {
+			vk::DescriptorBufferInfo bufferInfos[] = {
+				{ modelInstanceBuffers[frameIndex].buffer, 0, VK_WHOLE_SIZE },
+				{ materialBuffer.buffer, 0, VK_WHOLE_SIZE },
+			};
+
+			vk::WriteDescriptorSet descriptorWrites[2];
+			for (u32 binding = 0; binding < ARRAY_COUNT(descriptorWrites); ++binding) {
+				descriptorWrites[binding].dstBinding = binding;
+				descriptorWrites[binding].descriptorCount = 1;
+				descriptorWrites[binding].descriptorType = vk::DescriptorType::eStorageBuffer;
+				descriptorWrites[binding].pBufferInfo = &bufferInfos[binding];
+			}
+
+			// The buffer offset has to stay aligned, firstInstance makes up for the rest
+			for (u32 i = begin; i < end; ++i) {
+				u32 firstInstance = i % pushDescriptorInstanceStep;
+				bufferInfos[0].offset = static_cast<vk::DeviceSize>(i - firstInstance) * sizeof(ModelInstance);
+				commandBuffer.pushDescriptorSetKHR(vk::PipelineBindPoint::eGraphics, modelPipeline->pipelineLayout, 0, ARRAY_COUNT(descriptorWrites), descriptorWrites);
+				commandBuffer.drawIndexed(model.numIndices, 1, 0, 0, firstInstance);
+			}
+		}
+		else {
+			for (u32 i = begin; i < end; ++i) {
+				commandBuffer.drawIndexed(model.numIndices, instanceCount, 0, 0, i);
+			}
+		}
+	}
+
+	modelDrawCalls.fetch_add(end - begin, std::memory_order_relaxed);
+	VKA(commandBuffer.end());
+}
+
+void recordModelIndirectDraws(vk::CommandBuffer commandBuffer, u32 imageIndex, u32 frameIndex, const VulkanPipeline* modelPipeline) {
+	beginSecondaryCommandBuffer(commandBuffer, imageIndex);
+
+	{
+		SCOPE_LABEL("Models (GPU culled)");
+
+		bindModelPipeline(commandBuffer, frameIndex, modelPipeline, DRAW_DATA_INSTANCE_BUFFER);
+		commandBuffer.drawIndexedIndirectCount(drawCommandBuffers[frameIndex].buffer, 0, drawCountBuffers[frameIndex].buffer, 0, modelCount, sizeof(vk::DrawIndexedIndirectCommand));
+	}
+
+	modelDrawCalls.fetch_add(1, std::memory_order_relaxed);
+	VKA(commandBuffer.end());
+}
+
+// Runs outside of the scene pass, the indirect draws are recorded into a secondary command buffer afterwards
+void cullModels(vk::CommandBuffer commandBuffer, u32 frameIndex, const glm::mat4& modelTransform) {
+	SCOPE_LABEL("Model culling");
+
+	CullParameters parameters {};
+	parameters.viewProjection = camera.viewProjection;
+	parameters.view = camera.view;
+	parameters.modelTransform = modelTransform;
+	utils::getFrustumPlanes(camera.viewProjection, parameters.frustumPlanes);
+	parameters.objectCount = modelCount;
+	parameters.indexCount = static_cast<u32>(model.numIndices);
+
+	void* mapped;
+	VK(context->device.mapMemory(cullParameterBuffers[frameIndex].memory, 0, sizeof(CullParameters), {}, &mapped));
+	memcpy(mapped, &parameters, sizeof(parameters));
+	VK(context->device.unmapMemory(cullParameterBuffers[frameIndex].memory));
+
+	commandBuffer.fillBuffer(drawCountBuffers[frameIndex].buffer, 0, sizeof(u32), 0);
+
+	vk::MemoryBarrier2 clearBarrier {};
+	clearBarrier.srcStageMask = vk::PipelineStageFlagBits2::eTransfer;
+	clearBarrier.srcAccessMask = vk::AccessFlagBits2::eTransferWrite;
+	clearBarrier.dstStageMask = vk::PipelineStageFlagBits2::eComputeShader;
+	clearBarrier.dstAccessMask = vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite;
+
+	vk::DependencyInfo dependencyInfo {};
+	dependencyInfo.memoryBarrierCount = 1;
+	dependencyInfo.pMemoryBarriers = &clearBarrier;
+	commandBuffer.pipelineBarrier2(dependencyInfo);
+
+	commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, cullPipeline.pipeline);
+	commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, cullPipeline.pipelineLayout, 0, 1, &cullDescriptorSets[frameIndex], 0, nullptr);
+	commandBuffer.dispatch((modelCount + 63) / 64, 1, 1);
+
+	// The host reads the culled draw count once the frame's timeline value is reached, the fence wait alone doesn't make the write visible
+	vk::MemoryBarrier2 drawBarrier {};
+	drawBarrier.srcStageMask = vk::PipelineStageFlagBits2::eComputeShader;
+	drawBarrier.srcAccessMask = vk::AccessFlagBits2::eShaderStorageWrite;
+	drawBarrier.dstStageMask = vk::PipelineStageFlagBits2::eDrawIndirect | vk::PipelineStageFlagBits2::eVertexShader | vk::PipelineStageFlagBits2::eHost;
+	drawBarrier.dstAccessMask = vk::AccessFlagBits2::eIndirectCommandRead | vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eHostRead;
+
+	dependencyInfo.pMemoryBarriers = &drawBarrier;
+	commandBuffer.pipelineBarrier2(dependencyInfo);
+}
+
+// Groups the copies by state, opaque ones front to back for early depth rejection and blended ones back to front
+void sortVisibleModels() {
+	auto start = std::chrono::steady_clock::now();
+
+	DrawPass pass = modelPipelineState.blendEnable ? DRAW_PASS_TRANSPARENT : DRAW_PASS_OPAQUE;
+	u32 pipeline = getModelDrawDataPath();
+	const glm::mat4* worldMatrices = scene.getWorldMatrices();
+
+	drawQueue.clear();
+	drawQueue.reserve(static_cast<u32>(visibleModels.size()));
+	for (u32 modelIndex : visibleModels) {
+		glm::vec3 position = worldMatrices[getModelNode(modelIndex)][3];
+		float depth = glm::dot(position - camera.position, camera.direction);
+		drawQueue.push(DrawQueue::makeKey(pass, pipeline, modelMaterials[modelIndex], 0, depth), modelIndex);
+	}
+
+	unsortedStateChanges = drawQueue.countStateChanges();
+	if (useDrawSorting) {
+		drawQueue.sort();
+
+		const std::vector<DrawPacket>& packets = drawQueue.getPackets();
+		for (u32 i = 0; i < packets.size(); ++i) {
+			visibleModels[i] = packets[i].payload;
+		}
+	}
+	sortedStateChanges = drawQueue.countStateChanges();
+
+	drawSortTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void updateVisibleModels() {
+	if (modelMaterials.size() != modelCount) {
+		updateModelMaterials();
+	}
+
+	if (!useCpuCulling) {
+		visibleModels.resize(modelCount);
+		std::iota(visibleModels.begin(), visibleModels.end(), 0u);
+		cullingTime = 0.0;
+		refitTime = 0.0;
+		sortVisibleModels();
+		return;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	const glm::mat4* worldMatrices = scene.getWorldMatrices();
+	if (modelBvh.getObjectCount() != modelCount) {
+		std::vector<Aabb> bounds(modelCount);
+		for (u32 i = 0; i < modelCount; ++i) {
+			bounds[i] = transformAabb(model.bounds, worldMatrices[getModelNode(i)]);
+		}
+		modelBvh.build(bounds.data(), modelCount);
+	}
+	else {
+		for (u32 i = 0; i < modelCount; ++i) {
+			modelBvh.updateObject(i, transformAabb(model.bounds, worldMatrices[getModelNode(i)]));
+		}
+		modelBvh.refit();
+	}
+
+	auto refitEnd = std::chrono::steady_clock::now();
+
+	glm::vec4 frustumPlanes[6];
+	utils::getFrustumPlanes(camera.viewProjection, frustumPlanes);
+	modelBvh.cull(frustumPlanes, visibleModels);
+
+	refitTime = std::chrono::duration<double, std::milli>(refitEnd - start).count();
+	cullingTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	sortVisibleModels();
+}
+
+// Records the models on up to threadCount threads and returns the number of secondary command buffers used
+u32 recordModelChunks(u32 frameIndex, u32 imageIndex, u32 threadCount) {
+	DrawDataPath path = getModelDrawDataPath();
+	VulkanPipeline* modelPipeline = getPipelineVariant(context, &modelPipelines[path], modelPipelineState);
+	modelDrawCalls.store(0, std::memory_order_relaxed);
+
+	if (useGpuCulling) {
+		// Nothing here depends on the model count
+		VKA(context->device.resetCommandPool(recordingCommandPools[frameIndex][0]));
+		recordModelIndirectDraws(recordingCommandBuffers[frameIndex][0], imageIndex, frameIndex, modelPipeline);
+		return 1;
+	}
+
+	u32 drawCount = static_cast<u32>(visibleModels.size());
+	if (drawCount == 0) {
+		return 0;
+	}
+
+	// Push constant draws bring their own data, only the other paths fill the instance buffer
+	ModelInstance* instances = nullptr;
+	if (path != DRAW_DATA_PUSH_CONSTANTS) {
+		void* mapped;
+		VK(context->device.mapMemory(modelInstanceBuffers[frameIndex].memory, 0, sizeof(ModelInstance) * drawCount, {}, &mapped));
+		instances = static_cast<ModelInstance*>(mapped);
+	}
+
+	threadCount = std::clamp(threadCount, 1u, static_cast<u32>(recordingCommandPools[frameIndex].size()));
+	u32 chunkSize = (drawCount + threadCount - 1) / threadCount;
+
+	if (useInstancing) {
+		// Only the transforms are written in parallel, all copies go out in a single draw
+		jobSystem.parallelFor(drawCount, chunkSize, [&](u32 begin, u32 end) {
+			writeModelInstances(instances, begin, end);
+		});
+
+		VK(context->device.unmapMemory(modelInstanceBuffers[frameIndex].memory));
+
+		VKA(context->device.resetCommandPool(recordingCommandPools[frameIndex][0]));
+		recordModelDraws(recordingCommandBuffers[frameIndex][0], imageIndex, frameIndex, modelPipeline, 0, 1, drawCount, path);
+		return 1;
+	}
 
-	vk::PushConstantRange pushConstant {};
-	pushConstant.offset = 0;
-	pushConstant.size = sizeof(glm::mat4);
-	pushConstant.stageFlags = vk::ShaderStageFlagBits::eVertex;
+	if (path == DRAW_DATA_PUSH_CONSTANTS) {
+		modelDrawConstants.resize(drawCount);
+	}
 
-	spritePipeline = createPipeline(context, "shaders/texture.vert.spv", "shaders/texture.frag.spv", renderPass, swapchain.width, swapchain.height,
-									vertexAttributeDescriptions, ARRAY_COUNT(vertexAttributeDescriptions), &vertexInputBindingDescription, 1, &spriteDescriptorSetLayout, nullptr, 0, msaaSamples);
-	modelPipeline = createPipeline(context, "shaders/model.vert.spv", "shaders/model.frag.spv", renderPass, swapchain.width, swapchain.height,
-									modelAttributeDescriptions, ARRAY_COUNT(modelAttributeDescriptions), &modelInputBindingDescription, 1, &modelDescriptorSetLayout, nullptr, 0, msaaSamples);
+	jobSystem.parallelFor(drawCount, chunkSize, [&](u32 begin, u32 end) {
+		u32 chunk = begin / chunkSize;
+		if (path == DRAW_DATA_PUSH_CONSTANTS) {
+			writeModelDrawConstants(begin, end);
+		}
+		else {
+			writeModelInstances(instances, begin, end);
+		}
 
-	postprocessPipeline = createPipeline(context, "shaders/postprocess.vert.spv", "shaders/postprocess.frag.spv", renderPass, swapchain.width, swapchain.height,
-									nullptr, 0, nullptr, 1, &postprocessDescriptorSetLayout, nullptr, 1);
-	for (auto &fence : fences) {
-		vk::FenceCreateInfo fenceCreateInfo {};
-		fenceCreateInfo.flags = vk::FenceCreateFlagBits::eSignaled;
+		VKA(context->device.resetCommandPool(recordingCommandPools[frameIndex][chunk]));
+		recordModelDraws(recordingCommandBuffers[frameIndex][chunk], imageIndex, frameIndex, modelPipeline, begin, end, 1, path);
+	});
 
-		fence = VKA(context->device.createFence(fenceCreateInfo));
+	if (instances) {
+		VK(context->device.unmapMemory(modelInstanceBuffers[frameIndex].memory));
 	}
 
-	for (auto &acquireSemaphore : acquireSemaphores) {
-		vk::SemaphoreCreateInfo semaphoreCreateInfo {};
-		acquireSemaphore = VKA(context->device.createSemaphore(semaphoreCreateInfo));
+	return (drawCount + chunkSize - 1) / chunkSize;
+}
+
+// Records the same draw list with 1 to N threads, only CPU recording time is measured
+void benchmarkCommandRecording(u32 drawCount, u32 iterations) {
+	waitTimeline(context, context->timeline.submittedValue);
+
+	u32 previousModelCount = modelCount;
+	bool previousInstancing = useInstancing;
+	bool previousCpuCulling = useCpuCulling;
+	modelCount = drawCount;
+	useInstancing = false;
+	useCpuCulling = false;
+	if (modelCount > modelInstanceCapacity) {
+		resizeModelInstanceBuffers(std::bit_ceil(modelCount));
 	}
+	updateScene(0.0f);
+	updateVisibleModels();
 
-	for (auto &releaseSemaphore : releaseSemaphores) {
-		vk::SemaphoreCreateInfo semaphoreCreateInfo {};
-		releaseSemaphore = VKA(context->device.createSemaphore(semaphoreCreateInfo));
+	LOG_INFO("Command recording benchmark: " + std::to_string(drawCount) + " draws, " + std::to_string(iterations) + " iterations");
+
+	double singleThreadTime = 0.0;
+	for (u32 threadCount = 1; threadCount <= jobSystem.getNumThreads(); ++threadCount) {
+		auto start = std::chrono::steady_clock::now();
+		for (u32 i = 0; i < iterations; ++i) {
+			recordModelChunks(0, 0, threadCount);
+		}
+		double time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+		if (threadCount == 1) {
+			singleThreadTime = time;
+		}
+
+		LOG_INFO(std::to_string(threadCount) + " threads: " + std::to_string(time) + " ms, speedup " + std::to_string(singleThreadTime / time));
 	}
 
-	for (auto &commandPool : commandPools) {
-		vk::CommandPoolCreateInfo commandPoolCreateInfo {};
-		commandPoolCreateInfo.flags = vk::CommandPoolCreateFlagBits::eTransient;
-		commandPoolCreateInfo.queueFamilyIndex = context->graphicsQueue.familyIndex;
+	modelCount = previousModelCount;
+	useInstancing = previousInstancing;
+	useCpuCulling = previousCpuCulling;
+}
 
-		commandPool = VKA(context->device.createCommandPool(commandPoolCreateInfo));
+// Records the same draws on one thread for every per-draw data path, writing the data is part of the measured time
+void benchmarkDrawData(u32 drawCount, u32 iterations) {
+	waitTimeline(context, context->timeline.submittedValue);
+
+	u32 previousModelCount = modelCount;
+	bool previousInstancing = useInstancing;
+	bool previousCpuCulling = useCpuCulling;
+	int previousDrawDataPath = drawDataPath;
+	modelCount = drawCount;
+	useInstancing = false;
+	useCpuCulling = false;
+	if (modelCount > modelInstanceCapacity) {
+		resizeModelInstanceBuffers(std::bit_ceil(modelCount));
 	}
+	updateScene(0.0f);
+	updateVisibleModels();
 
-	for (u32 i = 0; i < FRAMES_IN_FLIGHT; ++i) {
-		vk::CommandBufferAllocateInfo commandBufferAllocateInfo {};
-		commandBufferAllocateInfo.commandPool = commandPools[i];
-		commandBufferAllocateInfo.level = vk::CommandBufferLevel::ePrimary;
-		commandBufferAllocateInfo.commandBufferCount = 1;
+	LOG_INFO("Per-draw data benchmark: " + std::to_string(drawCount) + " draws, " + std::to_string(iterations) + " iterations");
 
-		auto commandBuffersCreated = VKA(context->device.allocateCommandBuffers(commandBufferAllocateInfo));
-		commandBuffers[i] = commandBuffersCreated.front();
+	u32 pathCount = context->features.pushDescriptor ? DRAW_DATA_PATH_COUNT : DRAW_DATA_PUSH_DESCRIPTORS;
+	for (u32 path = 0; path < pathCount; ++path) {
+		drawDataPath = path;
+
+		// Creates the pipeline of the path outside of the measurement
+		recordModelChunks(0, 0, 1);
+
+		auto start = std::chrono::steady_clock::now();
+		for (u32 i = 0; i < iterations; ++i) {
+			recordModelChunks(0, 0, 1);
+		}
+		double time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+
+		LOG_INFO(std::string(drawDataPathNames[path]) + ": " + std::to_string(time) + " ms, " + std::to_string(drawCount / time) + " draws/ms");
 	}
 
-	// vertex buffer
-	createBuffer(context, &spriteVertexBuffer, sizeof(vertexData), vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst, vk::MemoryPropertyFlagBits::eDeviceLocal);
-	uploadDataToBuffer(context, &spriteVertexBuffer, vertexData, sizeof(vertexData));
+	modelCount = previousModelCount;
+	useInstancing = previousInstancing;
+	useCpuCulling = previousCpuCulling;
+	drawDataPath = previousDrawDataPath;
+}
 
-	// index buffer
-	createBuffer(context, &spriteIndexBuffer, sizeof(indexData), vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eTransferDst, vk::MemoryPropertyFlagBits::eDeviceLocal);
-	uploadDataToBuffer(context, &spriteIndexBuffer, indexData, sizeof(indexData));
+// Sleeps until the next frame is due, a schedule that fell behind restarts instead of catching up with a burst of frames
+void limitFrameRate() {
+	static u64 nextFrameTime = 0;
+	u64 now = SDL_GetTicksNS();
+	if (frameRateLimit == 0) {
+		nextFrameTime = now;
+		return;
+	}
 
-	// Init camera
+	if (nextFrameTime > now) {
+		SDL_DelayPrecise(nextFrameTime - now);
+	}
+	nextFrameTime = std::max(nextFrameTime, now) + SDL_NS_PER_SECOND / frameRateLimit;
+}
 
-	camera.position = glm::vec3(0.0f);
-	camera.direction = glm::vec3(0.0f, 0.0f, 1.0f);
-	camera.up = glm::vec3(0.0f, 1.0f, 0.0f);
-	camera.yaw = 0.0f;
-	camera.pitch = 0.0f;
+// Out of date and suboptimal come up while resizing, the swapchain is rebuilt on the next frame instead of failing
+vk::Result waitForPresent(u64 id, u64 timeout) {
+	vk::Result result;
+	try {
+		result = context->device.waitForPresentKHR(swapchain.swapchain, id, timeout);
+	}
+	catch (const vk::OutOfDateKHRError&) {
+		result = vk::Result::eErrorOutOfDateKHR;
+	}
 
-	ImGui::CreateContext();
-	ImGui::StyleColorsDark();
+	if (result == vk::Result::eErrorOutOfDateKHR || result == vk::Result::eSuboptimalKHR) {
+		swapchainOutOfDate = true;
+		windowResized = true;
+	}
+	return result;
+}
 
-	ImGui_ImplSDL3_InitForVulkan(window);
+// Input to on screen time of every frame that completed since the last call. Without the latency wait a present is
+// only noticed here, so the result can be up to a frame too high
+void updatePresentLatency() {
+	while (!pendingPresents.empty()) {
+		auto [id, inputTime] = pendingPresents.front();
+		vk::Result result = waitForPresent(id, 0);
+		if (result == vk::Result::eTimeout || result == vk::Result::eErrorOutOfDateKHR) {
+			break;
+		}
+		pendingPresents.pop_front();
 
-	ImGui_ImplVulkan_InitInfo imguiInitInfo {};
-	imguiInitInfo.Instance = context->instance;
-	imguiInitInfo.PhysicalDevice = context->physicalDevice;
-	imguiInitInfo.Device = context->device;
-	imguiInitInfo.QueueFamily = context->graphicsQueue.familyIndex;
-	imguiInitInfo.Queue = context->graphicsQueue.queue;
-	imguiInitInfo.DescriptorPool = nullptr;
-	imguiInitInfo.DescriptorPoolSize = 1000;
-	imguiInitInfo.RenderPass = renderPass;
-	imguiInitInfo.MinImageCount = 2;
-	imguiInitInfo.ImageCount = swapchain.images.size();
-	imguiInitInfo.MSAASamples = static_cast<VkSampleCountFlagBits>(msaaSamples);
+		double latency = static_cast<double>(SDL_GetTicksNS() - inputTime) / 1e6;
+		presentLatency = presentLatency == 0.0 ? latency : presentLatency * 0.95 + latency * 0.05;
+	}
+}
 
-	ImGui_ImplVulkan_Init(&imguiInitInfo);
+// Runs before the frame reads its input
+void paceFrame() {
+	limitFrameRate();
+
+	if (context->features.presentWait && !windowMinimized) {
+		// Only maxQueuedFrames presents may still be waiting for the screen, the timeout guards against a present that never shows
+		if (maxQueuedFrames > 0 && presentId >= firstSwapchainPresentId + maxQueuedFrames) {
+			waitForPresent(presentId - maxQueuedFrames, 100'000'000);
+		}
+		updatePresentLatency();
+	}
 
+	frameInputTime = SDL_GetTicksNS();
 }
 
 void renderApplication() {
+	PROFILE_FUNCTION();
 	static u32 frameIndex = 0;
-	static float time = 0.0f;
-	time += 0.005f;
+	animationTime += 0.005f;
+	float time = animationTime;
 
-	vk::SurfaceCapabilitiesKHR surfaceCapabilities = VKA(context->physicalDevice.getSurfaceCapabilitiesKHR(surface));
-	if (windowMinimized || (surfaceCapabilities.currentExtent.width == 0 || surfaceCapabilities.currentExtent.height == 0)) {
+	// Set from the window events, the surface is not queried every frame
+	if (windowMinimized) {
 		std::this_thread::sleep_for(std::chrono::milliseconds(10));
 		return;
 	}
 
+	if (requestedFramesInFlight != framesInFlight) {
+		waitTimeline(context, context->timeline.submittedValue);
+		framesInFlight = requestedFramesInFlight;
+		frameIndex = 0;
+	}
+
+	// Every resize event since the last frame ends up here once, the swapchain is only rebuilt if something changed
+	auto frameStart = std::chrono::steady_clock::now();
+	bool resized = false;
 	if (windowResized) {
-		ImGui::Render();
-		recreateSwapchain();
 		windowResized = false;
+		if (swapchainOutOfDate || swapchain.presentMode != presentMode || swapchainExtentChanged()) {
+			ImGui::Render();
+			recreateSwapchain();
+			resized = true;
+		}
+	}
+
+	// The buffers are shared by all frames, only the frames already submitted have to finish
+	if (modelCount > modelInstanceCapacity) {
+		waitTimeline(context, context->timeline.submittedValue);
+		resizeModelInstanceBuffers(std::bit_ceil(modelCount));
+	}
+	if (useGpuCulling && modelObjectCount != modelCount) {
+		waitTimeline(context, context->timeline.submittedValue);
+		writeModelObjects();
+	}
+
+	{
+		PROFILE_ZONE("Wait for frame slot");
+		updateTimeline(context);
+		waitTimeline(context, frameTimelineValues[frameIndex]);
 	}
 
-	VKA(context->device.waitForFences(fences[frameIndex], true, UINT64_MAX));
-	VKA(context->device.resetFences(fences[frameIndex]));
+	if (useGpuCulling) {
+		void* mapped;
+		VK(context->device.mapMemory(drawCountBuffers[frameIndex].memory, 0, sizeof(u32), {}, &mapped));
+		visibleModelCount = *static_cast<u32*>(mapped);
+		VK(context->device.unmapMemory(drawCountBuffers[frameIndex].memory));
+	}
 
-	u32 imageIndex = VK(context->device.acquireNextImageKHR(swapchain.swapchain, UINT64_MAX, acquireSemaphores[frameIndex], nullptr).value);
+	u32 imageIndex;
+	{
+		PROFILE_ZONE("Acquire image");
+		// The offscreen image of the slot is free once the slot's previous frame completed
+		imageIndex = headless ? frameIndex : VK(context->device.acquireNextImageKHR(swapchain.swapchain, UINT64_MAX, acquireSemaphores[frameIndex], nullptr).value);
+	}
 
 	VKA(context->device.resetCommandPool(commandPools[frameIndex]));
 
@@ -505,129 +1525,119 @@ void renderApplication() {
 
 		VKA(commandBuffer.begin(commandBufferBeginInfo));
 
-		vk::ClearValue clearValues[2] = {
-			vk::ClearColorValue{0.5f, 0.0f, 0.5f, 1.0f},
-			vk::ClearDepthStencilValue{0.0f, 0}
-		};
-
-		vk::RenderPassBeginInfo renderPassBeginInfo {};
-		renderPassBeginInfo.renderPass = renderPass;
-		renderPassBeginInfo.framebuffer = framebuffers[imageIndex];
-		renderPassBeginInfo.renderArea = vk::Rect2D( {0, 0}, {swapchain.width, swapchain.height} );
-		renderPassBeginInfo.clearValueCount = ARRAY_COUNT(clearValues);
-		renderPassBeginInfo.pClearValues = clearValues;
+		// Reads back the timestamps this frame slot wrote last time, every scope below is nested in the frame
+		beginGpuProfilerFrame(context, &gpuProfiler, commandBuffer, frameIndex);
+		u32 frameScope = beginTimestampScope(commandBuffer, "Frame");
 
 		vk::Viewport viewport { 0.0f, 0.0f, static_cast<float>(swapchain.width), static_cast<float>(swapchain.height), 0.0f, 1.0f};
 		vk::Rect2D scissor { {0, 0}, {swapchain.width, swapchain.height} } ;
 
-		vk::DeviceSize offset = 0;
-
-		glm::mat4 tranlationMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, 5.0f));
 		glm::mat4 scalingMatrix = glm::scale(glm::mat4(1.0f), glm::vec3(100.0f));
 		glm::mat4 rotationMatrix = glm::rotate(glm::mat4(1.0f), -time, glm::vec3(0.0f, 1.0f, 0.0f));
-		glm::mat4 modelMatrix = tranlationMatrix * scalingMatrix * rotationMatrix;
 
 		// glm::mat4 projectionMatrix = glm::ortho(0.0f, static_cast<float>(swapchain.width), 0.0f, static_cast<float>(swapchain.height), 0.0f, 1.0f);
 		// glm::mat4 projectionMatrix = utils::getProjectionInverseZ(glm::radians(90.0f), swapchain.width, swapchain.height, 0.01f);
-		glm::mat4 modelViewProjection = camera.viewProjection * modelMatrix;
-		glm::mat4 modelView = camera.view * modelMatrix;
-
-		commandBuffer.beginRenderPass(&renderPassBeginInfo, vk::SubpassContents::eInline);
-
-		commandBuffer.setViewport(0, 1, &viewport);
-		commandBuffer.setScissor(0, 1, &scissor);
-
-		// commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, spritePipeline.pipeline);
-		// commandBuffer.bindVertexBuffers(0, 1, &vertexBuffer.buffer, &offset);
-		// commandBuffer.bindIndexBuffer(indexBuffer.buffer, 0, vk::IndexType::eUint32);
-		// commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, spritePipeline.pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
-		// commandBuffer.drawIndexed(ARRAY_COUNT(indexData), 1, 0, 0, 0);
-
-		void* mapped;
-		u32 dynamicOffset = 0;
-
-		{
-			SCOPE_LABEL("Model1");
-
-			VK(context->device.mapMemory(modelUniformBuffers[frameIndex].memory, 0, singleElementSize * 2, {}, &mapped));
-			memcpy(mapped, &modelViewProjection, sizeof(modelViewProjection));
-			memcpy(static_cast<u8*>(mapped) + sizeof(glm::mat4), &modelView, sizeof(modelView));
-
-			commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, modelPipeline.pipeline);
-			commandBuffer.bindVertexBuffers(0, 1, &model.vertexBuffer.buffer, &offset);
-			commandBuffer.bindIndexBuffer(model.indexBuffer.buffer, 0, vk::IndexType::eUint16);
-
-			commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, modelPipeline.pipelineLayout, 0, 1, &modelDescriptorSets[frameIndex], 1, &dynamicOffset);
-			commandBuffer.drawIndexed(model.numIndices, 1, 0, 0, 0);
+		glm::mat4 modelTransform = scalingMatrix * rotationMatrix;
+		if (useGpuCulling) {
+			cullModels(commandBuffer, frameIndex, modelTransform);
+		}
+		else {
+			PROFILE_ZONE("Update scene");
+			updateScene(time);
+			updateVisibleModels();
 		}
 
-		// Second instance
+		auto recordingStart = std::chrono::steady_clock::now();
+		u32 chunkCount;
 		{
-			SCOPE_LABEL("Model2");
-
-			modelMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, 10.0f)) * scalingMatrix * rotationMatrix;
-			modelViewProjection = camera.viewProjection * modelMatrix;
-			modelView = camera.view * modelMatrix;
-
-			mapped = static_cast<u8*>(mapped) + singleElementSize;
-			memcpy(mapped, &modelViewProjection, sizeof(modelViewProjection));
-			memcpy(static_cast<u8*>(mapped) + sizeof(glm::mat4), &modelView, sizeof(modelView));
-
-			dynamicOffset = singleElementSize;
-			commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, modelPipeline.pipelineLayout, 0, 1, &modelDescriptorSets[frameIndex], 1, &dynamicOffset);
-			commandBuffer.drawIndexed(model.numIndices, 1, 0, 0, 0);
-
-			VK(context->device.unmapMemory((modelUniformBuffers[frameIndex].memory)));
+			PROFILE_ZONE("Record models");
+			chunkCount = recordModelChunks(frameIndex, imageIndex, recordingThreadCount);
 		}
+		modelRecordingTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - recordingStart).count();
 
 		// ImGui
 		{
-			SCOPE_LABEL("ImGui");
-
-			ImGui::Render();
-			ImDrawData* drawData = ImGui::GetDrawData();
-			ImGui_ImplVulkan_RenderDrawData(drawData, commandBuffers[frameIndex]);
+			auto commandBuffer = imguiCommandBuffers[frameIndex];
+			beginSecondaryCommandBuffer(commandBuffer, imageIndex);
+			{
+				SCOPE_LABEL("ImGui");
+
+				ImGui::Render();
+				ImDrawData* drawData = ImGui::GetDrawData();
+				ImGui_ImplVulkan_RenderDrawData(drawData, commandBuffer);
+			}
+			VKA(commandBuffer.end());
 		}
 
-		// Postprocessing
-		{
-			SCOPE_LABEL("Post Processing");
+		// commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, spritePipeline.pipeline);
+		// commandBuffer.bindVertexBuffers(0, 1, &vertexBuffer.buffer, &offset);
+		// commandBuffer.bindIndexBuffer(indexBuffer.buffer, 0, vk::IndexType::eUint32);
+		// commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, spritePipeline.pipelineLayout, 0, 1, &bindlessTable.descriptorSet, 0, nullptr);
+		// u32 textureSlots[] = { imageSlot, samplerSlot };
+		// commandBuffer.pushConstants(spritePipeline.pipelineLayout, vk::ShaderStageFlagBits::eFragment, 0, sizeof(textureSlots), textureSlots);
+		// commandBuffer.drawIndexed(ARRAY_COUNT(indexData), 1, 0, 0, 0);
 
-			commandBuffer.nextSubpass(vk::SubpassContents::eInline);
+		// The scene pass only executes the secondary command buffers, in draw order
+		frameGraph.passes[scenePass].record = [&](vk::CommandBuffer commandBuffer) {
+			if (chunkCount > 0) {
+				commandBuffer.executeCommands(chunkCount, recordingCommandBuffers[frameIndex].data());
+			}
+			commandBuffer.executeCommands(1, &imguiCommandBuffers[frameIndex]);
+		};
 
-			vk::DescriptorImageInfo descriptorImageInfo = { nullptr, swapchain.imageViews[imageIndex], vk::ImageLayout::eGeneral };
+		frameGraph.passes[postprocessPass].record = [&](vk::CommandBuffer commandBuffer) {
+			// Reads the resolved scene in place through an input attachment, or samples the separate resolve target
+			bool sampled = useDynamicRendering && !usesLocalRead();
+			vk::ImageLayout inputLayout = useDynamicRendering ? vk::ImageLayout::eRenderingLocalReadKHR : vk::ImageLayout::eGeneral;
+			vk::ImageView sceneView = getRenderGraphImageView(&frameGraph, sceneResolveImage, imageIndex);
 
-			vk::WriteDescriptorSet descriptorWrite;
-			descriptorWrite.dstSet = postprocessDescriptorSets[frameIndex];
-			descriptorWrite.dstBinding = 0;
-			descriptorWrite.descriptorCount = 1;
-			descriptorWrite.descriptorType = vk::DescriptorType::eInputAttachment;
-			descriptorWrite.pImageInfo = &descriptorImageInfo;
+			// Only written the first time a view shows up, afterwards the same set is found again every frame
+			VulkanDescriptorWrite descriptorWrite {};
+			descriptorWrite.binding = 0;
+			descriptorWrite.type = sampled ? vk::DescriptorType::eCombinedImageSampler : vk::DescriptorType::eInputAttachment;
+			descriptorWrite.image = { nullptr, sceneView, sampled ? vk::ImageLayout::eShaderReadOnlyOptimal : inputLayout };
+			vk::DescriptorSetLayout layout = sampled ? postprocessSampledDescriptorSetLayout : postprocessDescriptorSetLayout;
+			vk::DescriptorSet postprocessDescriptorSet = getCachedDescriptorSet(context, &descriptorCache, layout, &descriptorWrite, 1);
 
-			VK(context->device.updateDescriptorSets(1, &descriptorWrite, 0, nullptr));
+			// Executing secondary command buffers leaves the dynamic state undefined
+			commandBuffer.setViewport(0, 1, &viewport);
+			commandBuffer.setScissor(0, 1, &scissor);
 
 			commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, postprocessPipeline.pipeline);
-			commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, postprocessPipeline.pipelineLayout, 0, 1, &postprocessDescriptorSets[frameIndex], 0, nullptr);
+			commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, postprocessPipeline.pipelineLayout, 0, 1, &postprocessDescriptorSet, 0, nullptr);
 			commandBuffer.draw(3, 1, 0, 0);
-		}
+		};
+
+		PROFILE_ZONE("Record render graph");
+		u32 descriptorWrites = descriptorCache.writeCount;
+		executeRenderGraph(&frameGraph, commandBuffer, imageIndex);
+		descriptorWritesPerFrame = descriptorCache.writeCount - descriptorWrites;
 
-		commandBuffer.endRenderPass();
+		endTimestampScope(commandBuffer, frameScope);
+		endGpuProfilerFrame(&gpuProfiler);
 
 		VKA(commandBuffer.end());
 	}
 
+	PROFILE_ZONE("Submit and present");
+
+	// Nothing is acquired or presented, the timeline alone orders the headless frames
+	if (headless) {
+		frameTimelineValues[frameIndex] = submitTimeline(context, &context->graphicsQueue, 1, &commandBuffers[frameIndex]);
+		frameIndex = (frameIndex + 1) % framesInFlight;
+		return;
+	}
+
 	vk::PipelineStageFlags stageFlags {vk::PipelineStageFlagBits::eColorAttachmentOutput};
 
-	vk::SubmitInfo submitInfo {};
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &commandBuffers[frameIndex];
-	submitInfo.waitSemaphoreCount = 1;
-	submitInfo.pWaitSemaphores = &acquireSemaphores[frameIndex];
-	submitInfo.pWaitDstStageMask = &stageFlags;
-	submitInfo.signalSemaphoreCount = 1;
-	submitInfo.pSignalSemaphores = &releaseSemaphores[frameIndex];
+	// The swapchain still needs binary semaphores, the frame slot is tracked on the timeline
+	frameTimelineValues[frameIndex] = submitTimeline(context, &context->graphicsQueue, 1, &commandBuffers[frameIndex], 1, &acquireSemaphores[frameIndex], &stageFlags,
+													1, &releaseSemaphores[frameIndex]);
 
-	VKA(context->graphicsQueue.queue.submit(submitInfo, fences[frameIndex]));
+	for (VulkanSwapchain& retiredSwapchain : retiredSwapchains) {
+		destroySwapchain(context, &retiredSwapchain, frameTimelineValues[frameIndex]);
+	}
+	retiredSwapchains.clear();
 
 	vk::PresentInfoKHR presentInfo {};
 	presentInfo.swapchainCount = 1;
@@ -636,24 +1646,95 @@ void renderApplication() {
 	presentInfo.waitSemaphoreCount = 1;
 	presentInfo.pWaitSemaphores = &releaseSemaphores[frameIndex];
 
+	u64 framePresentId = presentId + 1;
+	vk::PresentIdKHR presentIdInfo {};
+	presentIdInfo.swapchainCount = 1;
+	presentIdInfo.pPresentIds = &framePresentId;
+	if (context->features.presentWait) {
+		presentInfo.pNext = &presentIdInfo;
+	}
+
 	VKA(context->graphicsQueue.queue.presentKHR(presentInfo));
 
-	frameIndex = (frameIndex + 1) % FRAMES_IN_FLIGHT;
+	if (context->features.presentWait) {
+		presentId = framePresentId;
+		pendingPresents.push_back({ presentId, frameInputTime });
+		// Nothing polls while a benchmark renders frames back to back
+		if (pendingPresents.size() > 16) {
+			pendingPresents.pop_front();
+		}
+	}
+
+	frameIndex = (frameIndex + 1) % framesInFlight;
+
+	// Smoothed, resizing continuously renders many of these frames in a row
+	if (resized) {
+		double frameTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+		resizeFrameTime += (frameTime - resizeFrameTime) * 0.2;
+	}
+
+}
+
+// Scopes in the order of the last frame that was read back, indented by nesting. Statistics cover the last GPU_PROFILER_HISTORY frames
+void drawGpuTimings() {
+	if (!gpuProfiler.supported) {
+		ImGui::Text("GPU timestamps not supported");
+		return;
+	}
 
+	if (ImGui::BeginTable("GPU timings", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_SizingFixedFit)) {
+		ImGui::TableSetupColumn("GPU scope");
+		ImGui::TableSetupColumn("Last ms");
+		ImGui::TableSetupColumn("Avg ms");
+		ImGui::TableSetupColumn("P50 ms");
+		ImGui::TableSetupColumn("P95 ms");
+		ImGui::TableHeadersRow();
+
+		for (u32 timingIndex : gpuProfiler.frameTimings) {
+			const VulkanGpuTiming& timing = gpuProfiler.timings[timingIndex];
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			ImGui::Text("%*s%s", static_cast<int>(timing.depth * 2), "", timing.name.c_str());
+			ImGui::TableNextColumn();
+			ImGui::Text("%.3f", timing.last);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.3f", timing.average);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.3f", timing.median);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.3f", timing.percentile95);
+		}
+		ImGui::EndTable();
+	}
 }
 
 void updateApplication(SDL_Window* window, float delta) {
+	// Switch before the ImGui frame starts, the backend gets recreated for the new path
+	if (requestedDynamicRendering != useDynamicRendering) {
+		switchRenderingPath(requestedDynamicRendering);
+	}
+
 	ImGui_ImplVulkan_NewFrame();
-	ImGui_ImplSDL3_NewFrame();
+	if (window) {
+		ImGui_ImplSDL3_NewFrame();
+	}
+	else {
+		ImGuiIO& io = ImGui::GetIO();
+		io.DisplaySize = ImVec2(static_cast<float>(swapchain.width), static_cast<float>(swapchain.height));
+		io.DeltaTime = delta > 0.0f ? delta : 1.0f / 60.0f;
+	}
 	ImGui::NewFrame();
 
-	SDL_PumpEvents();
-
-	const bool* keys = SDL_GetKeyboardState(nullptr);
-	float mouseX, mouseY;
-	SDL_GetRelativeMouseState(&mouseX, &mouseY);
+	// Headless runs have no input, the camera stays where it is
+	const bool* keys = nullptr;
+	float mouseX = 0.0f, mouseY = 0.0f;
+	if (window) {
+		SDL_PumpEvents();
+		keys = SDL_GetKeyboardState(nullptr);
+		SDL_GetRelativeMouseState(&mouseX, &mouseY);
+	}
 
-	if (SDL_GetWindowRelativeMouseMode(window)) {
+	if (window && SDL_GetWindowRelativeMouseMode(window)) {
 		float cameraSpeed = 5.0f;
 		float mouseSensitivity = 0.27f;
 
@@ -711,18 +1792,107 @@ void updateApplication(SDL_Window* window, float delta) {
 		static float fps_smooth = fps_now;
 		fps_smooth += (fps_now - fps_smooth) * 0.1f;
 		ImGui::Text("FPS: %.1f (%.2f ms)", fps_smooth, fps_smooth > 0.f ? 1000.f / fps_smooth : 0.f);
+
+		// The swapchain is recreated with the new mode on the next frame
+		if (ImGui::BeginCombo("Present mode", vk::to_string(presentMode).c_str())) {
+			for (vk::PresentModeKHR mode : supportedPresentModes) {
+				if (ImGui::Selectable(vk::to_string(mode).c_str(), mode == presentMode) && mode != presentMode) {
+					presentMode = mode;
+					windowResized = true;
+				}
+			}
+			ImGui::EndCombo();
+		}
+		u32 minZero = 0, minFrames = 1, maxFrames = MAX_FRAMES_IN_FLIGHT, maxFrameRate = 240, maxQueued = 3;
+		ImGui::SliderScalar("Frames in flight", ImGuiDataType_U32, &requestedFramesInFlight, &minFrames, &maxFrames);
+		ImGui::SliderScalar("Frame limit (0 = off)", ImGuiDataType_U32, &frameRateLimit, &minZero, &maxFrameRate);
+		if (context->features.presentWait) {
+			ImGui::SliderScalar("Max queued frames (0 = off)", ImGuiDataType_U32, &maxQueuedFrames, &minZero, &maxQueued);
+			ImGui::Text("Input to present latency: %.2f ms", presentLatency);
+		}
+
+		ImGui::BeginDisabled(!context->features.dynamicRendering);
+		ImGui::Checkbox("Dynamic rendering", &requestedDynamicRendering);
+		ImGui::EndDisabled();
+		ImGui::Text("Transient memory: %.1f MB (%.1f MB saved by aliasing)", frameGraph.allocatedMemorySize / (1024.0 * 1024.0),
+					(frameGraph.transientMemorySize - frameGraph.allocatedMemorySize) / (1024.0 * 1024.0));
+		ImGui::Text("Attachments: %ux%u for %ux%u, %u allocations in %u resizes", frameGraph.allocatedWidth, frameGraph.allocatedHeight, frameGraph.width, frameGraph.height,
+					attachmentAllocations, swapchainResizes);
+		ImGui::Text("Resize frame time: %.2f ms", resizeFrameTime);
+
+		drawGpuTimings();
+#ifdef PROFILER_ENABLED
+		if (ImGui::Button("Capture CPU trace")) {
+			u32 zoneCount = profiler::writeFrameTrace("cpu_trace.json", 120);
+			LOG_INFO("Wrote " + std::to_string(zoneCount) + " CPU zones of the last 120 frames to cpu_trace.json");
+		}
+		ImGui::SameLine();
+		if (ImGui::Button("Capture startup trace")) {
+			u32 zoneCount = profiler::writeStartupTrace("cpu_startup_trace.json");
+			LOG_INFO("Wrote " + std::to_string(zoneCount) + " CPU startup zones to cpu_startup_trace.json");
+		}
+#endif
+		ImGui::Text("Descriptor sets: %u cached, %u writes this frame", static_cast<u32>(descriptorCache.sets.size()), descriptorWritesPerFrame);
+		ImGui::Text("Timeline: %llu submitted, %llu completed, %u deferred destructions", static_cast<unsigned long long>(context->timeline.submittedValue),
+					static_cast<unsigned long long>(context->timeline.completedValue), static_cast<u32>(context->timeline.deferredDestructions.size()));
+
+		bool cullBackFaces = modelPipelineState.cullMode == vk::CullModeFlagBits::eBack;
+		if (ImGui::Checkbox("Cull back faces", &cullBackFaces)) {
+			modelPipelineState.cullMode = cullBackFaces ? vk::CullModeFlagBits::eBack : vk::CullModeFlagBits::eNone;
+		}
+		ImGui::Checkbox("Depth write", &modelPipelineState.depthWriteEnable);
+		ImGui::Checkbox("Blending", &modelPipelineState.blendEnable);
+
+		ImGui::BeginDisabled(!context->features.graphicsPipelineLibrary);
+		ImGui::Checkbox("Pipeline libraries", &usePipelineLibraries);
+		ImGui::EndDisabled();
+		const VulkanPipelineVariants& activeModelPipelines = modelPipelines[getModelDrawDataPath()];
+		ImGui::Text("Model pipelines: %u (%u permutations avoided)", static_cast<u32>(activeModelPipelines.pipelines.size()), activeModelPipelines.permutationsAvoided);
+
+		u32 minCount = 1, maxModels = 100000, maxThreads = jobSystem.getNumThreads();
+		ImGui::SliderScalar("Models", ImGuiDataType_U32, &modelCount, &minCount, &maxModels);
+		ImGui::SliderScalar("Recording threads", ImGuiDataType_U32, &recordingThreadCount, &minCount, &maxThreads);
+		ImGui::Checkbox("Instancing", &useInstancing);
+		ImGui::BeginDisabled(useInstancing || useGpuCulling);
+		ImGui::Combo("Per-draw data", &drawDataPath, drawDataPathNames, context->features.pushDescriptor ? DRAW_DATA_PATH_COUNT : DRAW_DATA_PUSH_DESCRIPTORS);
+		ImGui::EndDisabled();
+		if (ImGui::Checkbox("Mixed materials", &useMixedMaterials)) {
+			updateModelMaterials();
+			// The GPU path picks the materials up with the objects
+			modelObjectCount = 0;
+		}
+		ImGui::BeginDisabled(!context->features.drawIndirectCount);
+		ImGui::Checkbox("GPU culling", &useGpuCulling);
+		ImGui::EndDisabled();
+		if (useGpuCulling) {
+			ImGui::Text("Visible models: %u / %u", visibleModelCount, modelCount);
+		}
+		else {
+			ImGui::Text("Transform update: %.3f ms (%u of %u nodes)", transformUpdateTime, scene.getUpdatedNodeCount(), scene.getNodeCount());
+			ImGui::Checkbox("CPU culling", &useCpuCulling);
+			ImGui::Text("Culling: %.3f ms (refit %.3f ms), visible %u / %u", cullingTime, refitTime, static_cast<u32>(visibleModels.size()), modelCount);
+			ImGui::Checkbox("Sort draws", &useDrawSorting);
+			ImGui::Text("Draw sort: %.3f ms, binds %u unsorted / %u sorted", drawSortTime, unsortedStateChanges.getTotal(), sortedStateChanges.getTotal());
+			ImGui::Text("Pipelines %u / %u, materials %u / %u, meshes %u / %u", unsortedStateChanges.pipelines, sortedStateChanges.pipelines,
+						unsortedStateChanges.materials, sortedStateChanges.materials, unsortedStateChanges.meshes, sortedStateChanges.meshes);
+		}
+		ImGui::Text("Model recording: %.2f ms", modelRecordingTime);
 	}
 
 	ImGui::End();
 }
 
 void cleanupApplication() {
+	// Shutting down is the one place that idles the whole device, everything destroyed from here on goes away immediately
 	VKA(context->device.waitIdle());
+	flushDeferredDestructions(context);
 
 	// Imgui
 	ImGui_ImplVulkan_Shutdown();
 	context->device.destroyDescriptorPool(imguiDescriptorPool);
-	ImGui_ImplSDL3_Shutdown();
+	if (!headless) {
+		ImGui_ImplSDL3_Shutdown();
+	}
 	ImGui::DestroyContext();
 
 	destroyBuffer(context, &spriteVertexBuffer);
@@ -733,20 +1903,32 @@ void cleanupApplication() {
 
 	context->device.destroySampler(sampler);
 
-	context->device.destroyDescriptorPool(spriteDescriptorPool);
-	context->device.destroyDescriptorSetLayout(spriteDescriptorSetLayout);
+	destroyBindlessTable(context, &bindlessTable);
+	destroyBuffer(context, &materialBuffer);
 
-	context->device.destroyDescriptorPool(modelDescriptorPool);
+	destroyDescriptorAllocator(context, &descriptorAllocator);
+	destroyDescriptorAllocator(context, &descriptorCache.allocator);
+	destroyGpuProfiler(context, &gpuProfiler);
 	context->device.destroyDescriptorSetLayout(modelDescriptorSetLayout);
+	context->device.destroyDescriptorSetLayout(modelPushDescriptorSetLayout);
 
 	context->device.destroyDescriptorSetLayout(postprocessDescriptorSetLayout);
+	context->device.destroyDescriptorSetLayout(postprocessSampledDescriptorSetLayout);
+
+	for (auto & modelInstanceBuffer : modelInstanceBuffers) {
+		destroyBuffer(context, &modelInstanceBuffer);
+	}
 
-	for (auto & modelUniformBuffer : modelUniformBuffers) {
-		destroyBuffer(context, &modelUniformBuffer);
+	for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+		destroyBuffer(context, &cullParameterBuffers[i]);
+		destroyBuffer(context, &drawCommandBuffers[i]);
+		destroyBuffer(context, &drawCountBuffers[i]);
 	}
+	destroyBuffer(context, &modelObjectBuffer);
+	destroyPipeline(context, &cullPipeline);
+	context->device.destroyDescriptorSetLayout(cullDescriptorSetLayout);
 
-	for (u32 i = 0; i < FRAMES_IN_FLIGHT; ++i) {
-		VK(context->device.destroyFence(fences[i]));
+	for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
 		VK(context->device.destroySemaphore(acquireSemaphores[i]));
 		VK(context->device.destroySemaphore(releaseSemaphores[i]));
 	}
@@ -755,29 +1937,23 @@ void cleanupApplication() {
 		VK(context->device.destroyCommandPool(commandPool));
 	}
 
-	destroyPipeline(context, &spritePipeline);
-	destroyPipeline(context, &modelPipeline);
-	destroyPipeline(context, &postprocessPipeline);
-
-	for (auto& framebuffer : framebuffers) {
-		context->device.destroyFramebuffer(framebuffer);
+	for (auto &framePools : recordingCommandPools) {
+		for (auto &commandPool : framePools) {
+			VK(context->device.destroyCommandPool(commandPool));
+		}
 	}
-	framebuffers.clear();
 
-	for (auto& depthbuffer : depthBuffers) {
-		destroyImage(context, &depthbuffer);
+	destroyPipelines();
+	destroyRenderGraph(context, &frameGraph);
+	for (VulkanSwapchain& retiredSwapchain : retiredSwapchains) {
+		destroySwapchain(context, &retiredSwapchain, context->timeline.submittedValue);
 	}
-	depthBuffers.clear();
+	retiredSwapchains.clear();
+	destroySwapchain(context, &swapchain, context->timeline.submittedValue);
 
-	for (auto& colorbuffer : colorBuffers) {
-		destroyImage(context, &colorbuffer);
+	if (!headless) {
+		context->instance.destroySurfaceKHR(surface);
 	}
-	colorBuffers.clear();
-
-	destroyRenderPass(context, renderPass);
-	destroySwapchain(context, &swapchain);
-
-	context->instance.destroySurfaceKHR(surface);
 	exitVulkan(context);
 }
 
@@ -796,6 +1972,12 @@ bool handleMessage(SDL_Window* window) {
 				windowResized = true;
 				break;
 
+			// A window can end up with no area without being minimized, there is nothing to render into then
+			case SDL_EVENT_WINDOW_PIXEL_SIZE_CHANGED:
+				windowMinimized = event.window.data1 == 0 || event.window.data2 == 0;
+				windowResized = true;
+				break;
+
 			case SDL_EVENT_WINDOW_MINIMIZED:
 				windowMinimized = true;
 				break;
@@ -823,6 +2005,7 @@ bool handleMessage(SDL_Window* window) {
 	return true;
 }
 
+#ifdef _WIN32
 bool SDLCALL winMessageHook(void *userdata, MSG *msg) {
 	if (msg->message == WM_SIZING) {
 		windowResized = true;
@@ -830,34 +2013,358 @@ bool SDLCALL winMessageHook(void *userdata, MSG *msg) {
 	}
 	return true;
 }
+#endif
+
+// Renders each instance count with and without instancing, the frame time is bound by vsync so the recording time is logged as well
+void benchmarkInstancing(SDL_Window* window) {
+	const u32 frames = 100;
+	u32 previousModelCount = modelCount;
+	bool previousInstancing = useInstancing;
+	bool previousCpuCulling = useCpuCulling;
+	useCpuCulling = false;
+
+	LOG_INFO("Instancing benchmark: " + std::to_string(frames) + " frames per run");
+
+	for (u32 count : { 1u, 10u, 100u, 1000u, 10000u, 100000u }) {
+		for (bool instancing : { false, true }) {
+			modelCount = count;
+			useInstancing = instancing;
+
+			// The first frame grows the instance buffers, it isn't measured
+			updateApplication(window, 0.0f);
+			renderApplication();
+
+			double recordingTime = 0.0;
+			auto start = std::chrono::steady_clock::now();
+			for (u32 i = 0; i < frames; ++i) {
+				if (window) {
+					handleMessage(window);
+				}
+				updateApplication(window, 0.0f);
+				renderApplication();
+				recordingTime += modelRecordingTime;
+			}
+			waitTimeline(context, context->timeline.submittedValue);
+			double frameTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / frames;
+
+			LOG_INFO(std::to_string(count) + (instancing ? " instanced" : " per-draw") + ": frame " + std::to_string(frameTime) + " ms, recording " + std::to_string(recordingTime / frames) + " ms");
+		}
+	}
+
+	modelCount = previousModelCount;
+	useInstancing = previousInstancing;
+	useCpuCulling = previousCpuCulling;
+}
+
+// Scripted scenes for the scene benchmark, the model has a single mesh so the scenes differ in copies, materials and sample count
+struct SceneBenchmark {
+	const char* name;
+	u32 modelCount;
+	bool instancing;
+	bool mixedMaterials;
+	vk::SampleCountFlagBits msaaSamples;
+};
+
+const SceneBenchmark sceneBenchmarks[] = {
+	{ "instanced_1k_msaa1", 1000, true, false, vk::SampleCountFlagBits::e1 },
+	{ "instanced_1k_msaa4", 1000, true, false, vk::SampleCountFlagBits::e4 },
+	{ "instanced_1k_msaa8", 1000, true, false, vk::SampleCountFlagBits::e8 },
+	{ "instanced_1k_mixed_msaa4", 1000, true, true, vk::SampleCountFlagBits::e4 },
+	{ "per_draw_1k_msaa4", 1000, false, false, vk::SampleCountFlagBits::e4 },
+	{ "instanced_10k_msaa4", 10000, true, false, vk::SampleCountFlagBits::e4 },
+	{ "per_draw_10k_msaa4", 10000, false, false, vk::SampleCountFlagBits::e4 },
+};
+
+struct BenchmarkStatistics {
+	double mean;
+	double p50;
+	double p95;
+	double p99;
+};
+
+BenchmarkStatistics getBenchmarkStatistics(std::vector<double> samples) {
+	if (samples.empty()) {
+		return {};
+	}
+
+	std::sort(samples.begin(), samples.end());
+	auto percentile = [&](u32 percent) { return samples[std::min(samples.size() - 1, samples.size() * percent / 100)]; };
+
+	BenchmarkStatistics statistics {};
+	statistics.mean = std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+	statistics.p50 = percentile(50);
+	statistics.p95 = percentile(95);
+	statistics.p99 = percentile(99);
+	return statistics;
+}
+
+// Only what the compare tool's parser understands, quotes and backslashes are escaped and control characters dropped
+std::string escapeJson(const std::string& text) {
+	std::string escaped;
+	for (char c : text) {
+		if (c == '"' || c == '\\') {
+			escaped.push_back('\\');
+		}
+		if (static_cast<unsigned char>(c) >= 0x20) {
+			escaped.push_back(c);
+		}
+	}
+	return escaped;
+}
+
+std::string formatBenchmarkStatistics(const char* name, const BenchmarkStatistics& statistics) {
+	return std::format("\"{}\": {{ \"mean\": {:.4f}, \"p50\": {:.4f}, \"p95\": {:.4f}, \"p99\": {:.4f} }}", name, statistics.mean, statistics.p50, statistics.p95, statistics.p99);
+}
+
+// Flies along the grid and turns back and forth, only the frame number drives it
+void setBenchmarkCamera(u32 frame) {
+	float t = static_cast<float>(frame) / 120.0f;
+	camera.position = glm::vec3(45.0f + 40.0f * std::sin(t), 10.0f + 5.0f * std::sin(t * 0.5f), -20.0f);
+	camera.yaw = 15.0f * std::sin(t * 0.7f);
+	camera.pitch = -10.0f;
+}
+
+// Every scene renders warmupFrames unmeasured frames, then the measured ones. Run it headless so the frames aren't bound by
+// presentation. The JSON results can be checked against a baseline with VulkanLearningBench --compare
+void benchmarkScenes(SDL_Window* window, u32 warmupFrames, u32 frames, const std::string& outputFilename) {
+	std::ofstream file(outputFilename);
+	if (!file.is_open()) {
+		LOG_ERROR("Failed to open benchmark output " + outputFilename);
+		return;
+	}
+
+	u32 previousModelCount = modelCount;
+	bool previousInstancing = useInstancing;
+	bool previousMixedMaterials = useMixedMaterials;
+	vk::SampleCountFlagBits previousSamples = msaaSamples;
+	Camera previousCamera = camera;
+
+	LOG_INFO("Scene benchmark: " + std::to_string(warmupFrames) + " warm up and " + std::to_string(frames) + " measured frames per scene");
+
+	file << "{\n";
+	file << "  \"device\": \"" << escapeJson(context->physicalDeviceProperties.deviceName.data()) << "\",\n";
+	file << "  \"headless\": " << (headless ? "true" : "false") << ",\n";
+	file << "  \"presentMode\": \"" << vk::to_string(swapchain.presentMode) << "\",\n";
+	file << "  \"width\": " << swapchain.width << ",\n";
+	file << "  \"height\": " << swapchain.height << ",\n";
+	file << "  \"warmupFrames\": " << warmupFrames << ",\n";
+	file << "  \"frames\": " << frames << ",\n";
+	file << "  \"scenes\": [\n";
+
+	for (u32 sceneIndex = 0; sceneIndex < ARRAY_COUNT(sceneBenchmarks); ++sceneIndex) {
+		const SceneBenchmark& benchmark = sceneBenchmarks[sceneIndex];
+
+		switchMsaaSamples(benchmark.msaaSamples);
+		modelCount = benchmark.modelCount;
+		useInstancing = benchmark.instancing;
+		if (useMixedMaterials != benchmark.mixedMaterials) {
+			useMixedMaterials = benchmark.mixedMaterials;
+			updateModelMaterials();
+			modelObjectCount = 0;
+		}
+		animationTime = 0.0f;
+
+		std::vector<double> cpuFrameTimes;
+		std::vector<double> gpuFrameTimes;
+		std::vector<double> drawCalls;
+		std::vector<double> visibleCopies;
+		// The GPU times of a frame are read back framesInFlight frames later, the extra frames at the end collect the last ones
+		u32 firstFrame = warmupFrames;
+		u32 endFrame = warmupFrames + frames;
+		for (u32 frame = 0; frame < endFrame + framesInFlight; ++frame) {
+			setBenchmarkCamera(frame);
+
+			auto start = std::chrono::steady_clock::now();
+			if (window) {
+				handleMessage(window);
+			}
+			updateApplication(window, 1.0f / 60.0f);
+			renderApplication();
+			double cpuFrameTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+			// Frames before the scene switch are still in flight at its start, only frames of this scene count
+			if (frame >= firstFrame + framesInFlight) {
+				for (const VulkanGpuTiming& timing : gpuProfiler.timings) {
+					if (timing.path == "Frame") {
+						gpuFrameTimes.push_back(timing.last);
+					}
+				}
+			}
+
+			if (frame < firstFrame || frame >= endFrame) {
+				continue;
+			}
+
+			cpuFrameTimes.push_back(cpuFrameTime);
+			visibleCopies.push_back(useGpuCulling ? visibleModelCount : static_cast<u32>(visibleModels.size()));
+			drawCalls.push_back(modelDrawCalls.load(std::memory_order_relaxed));
+		}
+		waitTimeline(context, context->timeline.submittedValue);
+
+		BenchmarkStatistics cpuStatistics = getBenchmarkStatistics(cpuFrameTimes);
+		BenchmarkStatistics gpuStatistics = getBenchmarkStatistics(gpuFrameTimes);
+		double memory = (frameGraph.allocatedMemorySize + static_cast<double>(modelInstanceCapacity) * sizeof(ModelInstance) * MAX_FRAMES_IN_FLIGHT) / (1024.0 * 1024.0);
+
+		LOG_INFO(std::format("{}: CPU {:.3f} ms p50 {:.3f} ms p99, GPU {:.3f} ms p50 {:.3f} ms p99, {:.1f} MB", benchmark.name, cpuStatistics.p50, cpuStatistics.p99,
+							 gpuStatistics.p50, gpuStatistics.p99, memory));
+
+		file << "    {\n";
+		file << "      \"name\": \"" << benchmark.name << "\",\n";
+		file << "      \"models\": " << benchmark.modelCount << ",\n";
+		file << "      \"instancing\": " << (benchmark.instancing ? "true" : "false") << ",\n";
+		file << "      \"mixedMaterials\": " << (benchmark.mixedMaterials ? "true" : "false") << ",\n";
+		file << "      \"msaa\": " << static_cast<u32>(msaaSamples) << ",\n";
+		file << "      \"memoryMB\": " << std::format("{:.3f}", memory) << ",\n";
+		file << "      " << formatBenchmarkStatistics("cpuFrameTime", cpuStatistics) << ",\n";
+		file << "      " << formatBenchmarkStatistics("gpuFrameTime", gpuStatistics) << ",\n";
+		file << "      " << formatBenchmarkStatistics("drawCalls", getBenchmarkStatistics(drawCalls)) << ",\n";
+		file << "      " << formatBenchmarkStatistics("visibleModels", getBenchmarkStatistics(visibleCopies)) << "\n";
+		file << "    }" << (sceneIndex + 1 < ARRAY_COUNT(sceneBenchmarks) ? "," : "") << "\n";
+	}
+
+	file << "  ]\n}\n";
+	LOG_INFO("Scene benchmark results written to " + outputFilename);
+
+	switchMsaaSamples(previousSamples);
+	modelCount = previousModelCount;
+	useInstancing = previousInstancing;
+	if (useMixedMaterials != previousMixedMaterials) {
+		useMixedMaterials = previousMixedMaterials;
+		updateModelMaterials();
+		modelObjectCount = 0;
+	}
+	camera = previousCamera;
+}
+
+int main(int argc, char** argv) {
+	PROFILE_THREAD("Main");
+
+	bool runPipelineBenchmark = false;
+	bool runRecordingBenchmark = false;
+	bool runInstancingBenchmark = false;
+	bool runDrawDataBenchmark = false;
+	bool runSceneBenchmark = false;
+	u32 benchmarkWarmupFrames = 60;
+	u32 benchmarkFrames = 300;
+	std::string benchmarkOutput = "bench_results.json";
+	bool loadShadersFromDisk = false;
+	u32 headlessFrames = 1000;
+	for (int i = 1; i < argc; ++i) {
+		if (std::string_view(argv[i]) == "--bench-pipelines") {
+			runPipelineBenchmark = true;
+		}
+		else if (std::string_view(argv[i]) == "--bench-recording") {
+			runRecordingBenchmark = true;
+		}
+		else if (std::string_view(argv[i]) == "--bench-instancing") {
+			runInstancingBenchmark = true;
+		}
+		else if (std::string_view(argv[i]) == "--bench-draw-data") {
+			runDrawDataBenchmark = true;
+		}
+		else if (std::string_view(argv[i]) == "--bench-scenes") {
+			runSceneBenchmark = true;
+		}
+		else if (std::string_view(argv[i]) == "--bench-warmup" && i + 1 < argc) {
+			benchmarkWarmupFrames = static_cast<u32>(std::stoul(argv[++i]));
+		}
+		else if (std::string_view(argv[i]) == "--bench-frames" && i + 1 < argc) {
+			benchmarkFrames = static_cast<u32>(std::stoul(argv[++i]));
+		}
+		else if (std::string_view(argv[i]) == "--bench-output" && i + 1 < argc) {
+			benchmarkOutput = argv[++i];
+		}
+		else if (std::string_view(argv[i]) == "--shaders-from-disk") {
+			loadShadersFromDisk = true;
+		}
+		else if (std::string_view(argv[i]) == "--headless") {
+			headless = true;
+		}
+		else if (std::string_view(argv[i]) == "--frames" && i + 1 < argc) {
+			headlessFrames = static_cast<u32>(std::stoul(argv[++i]));
+		}
+		else if (std::string_view(argv[i]) == "--log-level" && i + 1 < argc) {
+			std::string_view level = argv[++i];
+			globalLogger.setLevel(level == "error" ? LogLevel::Error : level == "warning" ? LogLevel::Warning : level == "info" ? LogLevel::Info : LogLevel::Debug);
+		}
+	}
 
-int main() {
 	LOG_INFO("--- Program started ---");
 	LOG_INFO("Start time: " + utils::getCurrentTimeFormatted());
 
-	if (!SDL_Init(SDL_INIT_VIDEO)) { // SDL returns true on success
+	// Headless only uses SDL's timers, it has to run without a display
+	if (!SDL_Init(headless ? 0 : SDL_INIT_VIDEO)) { // SDL returns true on success
 		LOG_ERROR("Error initializing SDL: " + std::string(SDL_GetError()));
 		return 1;
 	}
 
-	SDL_Window* window = SDL_CreateWindow("VulkanLearning", 1240, 720, SDL_WINDOW_VULKAN | SDL_WINDOW_RESIZABLE);
-	if (!window) {
-		LOG_ERROR("Error creating window: " + std::string(SDL_GetError()));
-		return 1;
-	}
+	SDL_Window* window = nullptr;
+	if (!headless) {
+		window = SDL_CreateWindow("VulkanLearning", 1240, 720, SDL_WINDOW_VULKAN | SDL_WINDOW_RESIZABLE);
+		if (!window) {
+			LOG_ERROR("Error creating window: " + std::string(SDL_GetError()));
+			return 1;
+		}
 
-	SDL_SetWindowsMessageHook(winMessageHook, window);
+#ifdef _WIN32
+		SDL_SetWindowsMessageHook(winMessageHook, window);
+#endif
+	}
 
 	VulkanContext ctx;
 	context = &ctx;
+	context->loadShadersFromDisk = loadShadersFromDisk;
 
-	initApplication(window);
+	if (!initApplication(window)) {
+		LOG_ERROR("Error initializing Vulkan");
+		return 1;
+	}
+
+	if (runPipelineBenchmark) {
+		benchmarkPipelineCreation();
+	}
+	if (runRecordingBenchmark) {
+		benchmarkCommandRecording(10000, 50);
+	}
+	if (runInstancingBenchmark) {
+		benchmarkInstancing(window);
+	}
+	if (runDrawDataBenchmark) {
+		benchmarkDrawData(10000, 50);
+	}
+	if (runSceneBenchmark) {
+		benchmarkScenes(window, benchmarkWarmupFrames, benchmarkFrames, benchmarkOutput);
+	}
 
 	float delta = 0.0f;
 	u64 perfCounterFrequency = SDL_GetPerformanceFrequency();
 	u64 lastCounter = SDL_GetPerformanceCounter();
 
-	while (handleMessage(window)) {
+	bool benchmarkOnly = runPipelineBenchmark || runRecordingBenchmark || runInstancingBenchmark || runDrawDataBenchmark || runSceneBenchmark;
+
+	// A fixed number of frames as fast as the device renders them, the average includes waiting for the last one
+	if (headless && !benchmarkOnly) {
+		LOG_INFO("Headless: rendering " + std::to_string(headlessFrames) + " frames at " + std::to_string(swapchain.width) + "x" + std::to_string(swapchain.height));
+
+		auto start = std::chrono::steady_clock::now();
+		for (u32 i = 0; i < headlessFrames; ++i) {
+			PROFILE_FRAME();
+			updateApplication(window, 1.0f / 60.0f);
+			renderApplication();
+		}
+		waitTimeline(context, context->timeline.submittedValue);
+		double frameTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / std::max(headlessFrames, 1u);
+
+		LOG_INFO("Headless: " + std::to_string(frameTime) + " ms per frame");
+		benchmarkOnly = true;
+	}
+
+	while (!benchmarkOnly) {
+		PROFILE_FRAME();
+		paceFrame();
+		if (!handleMessage(window)) {
+			break;
+		}
 		updateApplication(window, delta);
 		renderApplication();
 
@@ -869,7 +2376,9 @@ int main() {
 
 	cleanupApplication();
 
-	SDL_DestroyWindow(window);
+	if (window) {
+		SDL_DestroyWindow(window);
+	}
 	SDL_Quit();
 
 	return 0;
@@ -1,10 +1,18 @@
+#pragma once
+
+#include <cgltf.h>
+#include <glm/vec4.hpp>
+
 #include "vulkan_base/vulkan_base.h"
+#include "bvh.h"
 
 struct Model {
     VulkanBuffer vertexBuffer;
     VulkanBuffer indexBuffer;
     u64 numIndices;
     VulkanImage albedoTexture;
+    glm::vec4 boundingSphere; // Object space center and radius
+    Aabb bounds; // Object space
 };
 
 Model createModel(VulkanContext* context, const char* filename, const char* modelDir, cgltf_component_type componentType);
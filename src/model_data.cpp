@@ -0,0 +1,151 @@
+#define CGLTF_IMPLEMENTATION
+#define STB_IMAGE_IMPLEMENTATION
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <cgltf.h>
+#include <stb_image.h>
+
+#include "model_data.h"
+
+#include <cassert>
+#include <string>
+
+#include <glm/geometric.hpp>
+
+#include "logger.h"
+
+void fillBuffer(u32 inputStride, void* inputData, u32 outputStride, void* outputData, u32 numElements, u32 elementSize) {
+    u8* output = static_cast<u8*>(outputData);
+    u8* input = static_cast<u8*>(inputData);
+
+    for (u32 i = 0; i < numElements; ++i) {
+        for (u32 j = 0; j < elementSize; ++j) {
+            output[j] = input[j];
+        }
+        output += outputStride;
+        input += inputStride;
+    }
+}
+
+bool loadModelData(const char* filename, const char* modelDir, cgltf_component_type componentType, ModelData* modelData) {
+    cgltf_options options = {};
+    cgltf_data* data = 0;
+    cgltf_result result = cgltf_parse_file(&options, filename, &data);
+    if (result != cgltf_result_success) {
+        std::string additionalInfo;
+        if (result == cgltf_result_file_not_found) {
+            additionalInfo = " (File not found)";
+        }
+        LOG_ERROR("Could not load model from file" + additionalInfo);
+        return false;
+    }
+
+    result = cgltf_load_buffers(&options, data, modelDir);
+    if (result != cgltf_result_success) {
+        LOG_ERROR("Could not load additional model buffers");
+        cgltf_free(data);
+        return false;
+    }
+
+    modelData->gltf = data;
+
+    assert(data->meshes_count == 1);
+    assert(data->meshes[0].primitives_count == 1);
+    assert(data->meshes[0].primitives[0].attributes_count > 0);
+
+    // Indices
+    size_t indexStride = 0;
+    switch (componentType) {
+        case cgltf_component_type_r_16u:
+            indexStride = sizeof(u16);
+            break;
+
+        case cgltf_component_type_r_32u:
+            indexStride = sizeof(u32);
+            break;
+
+        default:
+            assert(false && "unrecognized component type");
+    }
+
+    cgltf_accessor* indices = data->meshes[0].primitives[0].indices;
+    modelData->numIndices = indices->count;
+    modelData->indexDataSize = indices->count * indexStride;
+    modelData->indexData = static_cast<uint8_t*>(indices->buffer_view->buffer->data) + indices->buffer_view->offset + indices->offset;
+
+    // Vertices
+    u64 outputStride = sizeof(float) * 8;
+    u64 numVertices = data->meshes[0].primitives[0].attributes->data->count;
+    modelData->vertexStride = outputStride;
+    modelData->numVertices = numVertices;
+    modelData->vertexData.resize(outputStride * numVertices);
+
+    for (u64 i = 0; i < data->meshes[0].primitives[0].attributes_count; ++i) {
+        cgltf_attribute* attribute = data->meshes[0].primitives[0].attributes + i;
+        u8* bufferBase = static_cast<uint8_t*>(attribute->data->buffer_view->buffer->data) + attribute->data->buffer_view->offset + attribute->data->offset;
+        u64 inputStride = attribute->data->stride;
+
+        if (attribute->type == cgltf_attribute_type_position) {
+            void* positionData = bufferBase;
+
+            fillBuffer(inputStride, positionData, outputStride, modelData->vertexData.data(), numVertices, sizeof(float) * 3);
+
+            // glTF requires min and max on position accessors
+            if (attribute->data->has_min && attribute->data->has_max) {
+                glm::vec3 min(attribute->data->min[0], attribute->data->min[1], attribute->data->min[2]);
+                glm::vec3 max(attribute->data->max[0], attribute->data->max[1], attribute->data->max[2]);
+                modelData->boundingSphere = glm::vec4((min + max) * 0.5f, glm::length(max - min) * 0.5f);
+                modelData->bounds = { min, max };
+            }
+        }
+        else if (attribute->type == cgltf_attribute_type_normal) {
+            void* normalData = bufferBase;
+
+            fillBuffer(inputStride, normalData, outputStride, modelData->vertexData.data() + sizeof(float) * 3, numVertices, sizeof(float) * 3);
+        }
+        else if (attribute->type == cgltf_attribute_type_texcoord) {
+            void* texcoordData = bufferBase;
+
+            fillBuffer(inputStride, texcoordData, outputStride, modelData->vertexData.data() + (sizeof(float) * 6), numVertices, sizeof(float) * 2);
+        }
+    }
+
+    // Albedo texture
+    cgltf_material* material = &data->materials[0];
+    assert(material->has_pbr_metallic_roughness);
+    cgltf_texture_view albedoTextureView = material->pbr_metallic_roughness.base_color_texture;
+    assert(!albedoTextureView.has_transform);
+    assert(albedoTextureView.texcoord == 0);
+    assert(albedoTextureView.texture);
+
+    cgltf_buffer_view* bufferView = albedoTextureView.texture->image->buffer_view;
+    assert(bufferView->size < INT32_MAX);
+
+    modelData->encodedTexture = static_cast<const u8*>(bufferView->buffer->data) + bufferView->offset;
+    modelData->encodedTextureSize = static_cast<u32>(bufferView->size);
+
+    return true;
+}
+
+bool decodeModelTexture(ModelData* modelData) {
+    int bpp, width, height;
+    modelData->textureData = stbi_load_from_memory(modelData->encodedTexture, static_cast<int>(modelData->encodedTextureSize), &width, &height, &bpp, 4);
+    if (!modelData->textureData) {
+        LOG_ERROR("Could not decode model texture: " + std::string(stbi_failure_reason()));
+        return false;
+    }
+
+    modelData->textureWidth = static_cast<u32>(width);
+    modelData->textureHeight = static_cast<u32>(height);
+    return true;
+}
+
+void freeModelData(ModelData* modelData) {
+    if (modelData->textureData) {
+        stbi_image_free(modelData->textureData);
+    }
+    if (modelData->gltf) {
+        cgltf_free(modelData->gltf);
+    }
+    *modelData = ModelData {};
+}
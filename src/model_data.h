@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vector>
+
+#include <cgltf.h>
+#include <glm/vec4.hpp>
+
+#include "types.h"
+#include "bvh.h"
+
+// CPU side of a model, everything createModel needs before the upload. Doesn't depend on Vulkan so the benchmarks can load models too
+struct ModelData {
+    cgltf_data* gltf = nullptr;
+
+    // Points into the glTF buffers
+    void* indexData = nullptr;
+    u64 indexDataSize = 0;
+    u64 numIndices = 0;
+
+    // Interleaved position, normal and texture coordinate
+    std::vector<u8> vertexData;
+    u64 vertexStride = 0;
+    u64 numVertices = 0;
+
+    glm::vec4 boundingSphere {}; // Object space center and radius
+    Aabb bounds {}; // Object space
+
+    // Encoded albedo image in the glTF buffers, RGBA8 once decoded
+    const u8* encodedTexture = nullptr;
+    u32 encodedTextureSize = 0;
+    u8* textureData = nullptr;
+    u32 textureWidth = 0;
+    u32 textureHeight = 0;
+};
+
+void fillBuffer(u32 inputStride, void* inputData, u32 outputStride, void* outputData, u32 numElements, u32 elementSize);
+
+// Parses the glTF file, loads its buffers and interleaves the vertices. The texture is only located, decodeModelTexture decodes it
+bool loadModelData(const char* filename, const char* modelDir, cgltf_component_type componentType, ModelData* modelData);
+bool decodeModelTexture(ModelData* modelData);
+void freeModelData(ModelData* modelData);
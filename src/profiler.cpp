@@ -0,0 +1,141 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "logger.h"
+
+namespace profiler {
+    struct Zone {
+        const char* name;
+        u64 begin;
+        u64 end;
+    };
+
+    // Only the owning thread writes, captures copy the zones below the write index
+    struct ThreadBuffer {
+        std::string name;
+        u32 threadId;
+        std::unique_ptr<Zone[]> zones;
+        std::atomic<u64> writeIndex { 0 };
+    };
+
+    static const auto startTime = std::chrono::steady_clock::now();
+
+    // Buffers are kept after their thread exits, its zones stay in the captures
+    static std::mutex buffersMutex;
+    static std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    static thread_local ThreadBuffer* threadBuffer = nullptr;
+
+    // Written by the thread that marks the frames
+    static u64 frameStarts[MAX_FRAMES];
+    static u64 frameCount = 0;
+    static u64 startupEnd = 0;
+
+    static ThreadBuffer* getThreadBuffer() {
+        if (!threadBuffer) {
+            auto buffer = std::make_unique<ThreadBuffer>();
+            buffer->zones = std::make_unique<Zone[]>(ZONES_PER_THREAD);
+
+            std::lock_guard lock(buffersMutex);
+            buffer->threadId = static_cast<u32>(buffers.size());
+            buffer->name = "Thread " + std::to_string(buffer->threadId);
+            threadBuffer = buffer.get();
+            buffers.push_back(std::move(buffer));
+        }
+        return threadBuffer;
+    }
+
+    u64 now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+    }
+
+    void recordZone(const char* name, u64 begin, u64 end) {
+        ThreadBuffer* buffer = getThreadBuffer();
+        u64 index = buffer->writeIndex.load(std::memory_order_relaxed);
+        buffer->zones[index % ZONES_PER_THREAD] = { name, begin, end };
+        buffer->writeIndex.store(index + 1, std::memory_order_release);
+    }
+
+    void setThreadName(const char* name) {
+        ThreadBuffer* buffer = getThreadBuffer();
+        std::lock_guard lock(buffersMutex);
+        buffer->name = name;
+    }
+
+    void markFrame() {
+        u64 time = now();
+        if (frameCount == 0) {
+            startupEnd = time;
+        }
+        frameStarts[frameCount % MAX_FRAMES] = time;
+        frameCount++;
+    }
+
+    static void writeEscaped(std::ofstream& file, const std::string& text) {
+        for (char c : text) {
+            if (c == '"' || c == '\\') {
+                file << '\\';
+            }
+            file << c;
+        }
+    }
+
+    static u32 writeTrace(const std::string& filename, u64 begin, u64 end) {
+        std::ofstream file(filename);
+        if (!file.is_open()) {
+            LOG_ERROR("Failed to open trace file " + filename);
+            return 0;
+        }
+
+        // Microseconds with fractions, chrome://tracing keeps them
+        auto microseconds = [](u64 nanoseconds) { return static_cast<double>(nanoseconds) / 1000.0; };
+
+        std::lock_guard lock(buffersMutex);
+        u32 zoneCount = 0;
+        bool first = true;
+        file << "{\"traceEvents\":[\n";
+        for (auto& buffer : buffers) {
+            file << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->threadId << ",\"args\":{\"name\":\"";
+            writeEscaped(file, buffer->name);
+            file << "\"}}";
+            first = false;
+
+            // The oldest zones might be overwritten while copying, a quarter of the ring is left out as margin
+            u64 writeIndex = buffer->writeIndex.load(std::memory_order_acquire);
+            u64 readIndex = writeIndex > ZONES_PER_THREAD * 3 / 4 ? writeIndex - ZONES_PER_THREAD * 3 / 4 : 0;
+            for (; readIndex < writeIndex; ++readIndex) {
+                Zone zone = buffer->zones[readIndex % ZONES_PER_THREAD];
+                if (zone.begin < begin || zone.end > end) {
+                    continue;
+                }
+
+                file << ",\n{\"name\":\"";
+                writeEscaped(file, zone.name);
+                file << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->threadId << ",\"ts\":" << microseconds(zone.begin)
+                     << ",\"dur\":" << microseconds(zone.end - zone.begin) << "}";
+                zoneCount++;
+            }
+        }
+        file << "\n]}\n";
+
+        return zoneCount;
+    }
+
+    u32 writeFrameTrace(const std::string& filename, u32 count) {
+        if (frameCount == 0) {
+            return 0;
+        }
+        count = static_cast<u32>(std::min<u64>({ count, frameCount, MAX_FRAMES }));
+        return writeTrace(filename, frameStarts[(frameCount - count) % MAX_FRAMES], now());
+    }
+
+    u32 writeStartupTrace(const std::string& filename) {
+        return writeTrace(filename, 0, frameCount > 0 ? startupEnd : now());
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "types.h"
+
+// CPU zones recorded into a ring buffer per thread, a capture writes them as Chrome trace JSON (chrome://tracing, Perfetto).
+// Without PROFILER_ENABLED the macros compile to nothing.
+namespace profiler {
+    constexpr u32 ZONES_PER_THREAD = 1 << 16;
+    constexpr u32 MAX_FRAMES = 1024;
+
+    // Nanoseconds on the steady clock since the profiler started
+    u64 now();
+
+    void recordZone(const char* name, u64 begin, u64 end);
+    void setThreadName(const char* name);
+    // Ends the startup capture on the first call
+    void markFrame();
+
+    // Zones of the last frameCount frames, or everything recorded before the first frame. Returns the number of zones written
+    u32 writeFrameTrace(const std::string& filename, u32 frameCount);
+    u32 writeStartupTrace(const std::string& filename);
+
+    struct ZoneScope {
+        const char* name;
+        u64 begin;
+
+        ZoneScope(const char* name) : name(name), begin(now()) {}
+        ~ZoneScope() { recordZone(name, begin, now()); }
+    };
+}
+
+#ifdef PROFILER_ENABLED
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_ZONE(name) profiler::ZoneScope PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_ZONE(__func__)
+#define PROFILE_FRAME() profiler::markFrame()
+#define PROFILE_THREAD(name) profiler::setThreadName(name)
+#else
+#define PROFILE_ZONE(name)
+#define PROFILE_FUNCTION()
+#define PROFILE_FRAME()
+#define PROFILE_THREAD(name)
+#endif
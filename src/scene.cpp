@@ -0,0 +1,182 @@
+#include "scene.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "job_system.h"
+#include "transforms.h"
+
+void Scene::clear() {
+    positionX.clear();
+    positionY.clear();
+    positionZ.clear();
+    rotationX.clear();
+    rotationY.clear();
+    rotationZ.clear();
+    rotationW.clear();
+    scaleX.clear();
+    scaleY.clear();
+    scaleZ.clear();
+    parents.clear();
+    worldMatrices.clear();
+    localDirty.clear();
+    worldVersions.clear();
+    levelOffsets.assign(1, 0);
+    firstDirtyLevel = UINT32_MAX;
+    updatedNodeCount = 0;
+}
+
+void Scene::reserve(u32 nodeCount) {
+    positionX.reserve(nodeCount);
+    positionY.reserve(nodeCount);
+    positionZ.reserve(nodeCount);
+    rotationX.reserve(nodeCount);
+    rotationY.reserve(nodeCount);
+    rotationZ.reserve(nodeCount);
+    rotationW.reserve(nodeCount);
+    scaleX.reserve(nodeCount);
+    scaleY.reserve(nodeCount);
+    scaleZ.reserve(nodeCount);
+    parents.reserve(nodeCount);
+    worldMatrices.reserve(nodeCount);
+    localDirty.reserve(nodeCount);
+    worldVersions.reserve(nodeCount);
+}
+
+u32 Scene::addNode(u32 parent, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale) {
+    u32 node = getNodeCount();
+    u32 level = parent == NO_PARENT ? 0 : getNodeLevel(parent) + 1;
+    assert(parent == NO_PARENT || parent < node);
+    assert(level + 1 >= getLevelCount() && level <= getLevelCount());
+
+    if (level == getLevelCount()) {
+        levelOffsets.push_back(levelOffsets.back());
+    }
+    levelOffsets.back()++;
+
+    positionX.push_back(position.x);
+    positionY.push_back(position.y);
+    positionZ.push_back(position.z);
+    rotationX.push_back(rotation.x);
+    rotationY.push_back(rotation.y);
+    rotationZ.push_back(rotation.z);
+    rotationW.push_back(rotation.w);
+    scaleX.push_back(scale.x);
+    scaleY.push_back(scale.y);
+    scaleZ.push_back(scale.z);
+    parents.push_back(parent);
+    worldMatrices.emplace_back(1.0f);
+    localDirty.push_back(1);
+    worldVersions.push_back(0);
+
+    firstDirtyLevel = std::min(firstDirtyLevel, level);
+
+    return node;
+}
+
+void Scene::setPosition(u32 node, const glm::vec3& position) {
+    positionX[node] = position.x;
+    positionY[node] = position.y;
+    positionZ[node] = position.z;
+    markDirty(node);
+}
+
+void Scene::setRotation(u32 node, const glm::quat& rotation) {
+    rotationX[node] = rotation.x;
+    rotationY[node] = rotation.y;
+    rotationZ[node] = rotation.z;
+    rotationW[node] = rotation.w;
+    markDirty(node);
+}
+
+void Scene::setScale(u32 node, const glm::vec3& scale) {
+    scaleX[node] = scale.x;
+    scaleY[node] = scale.y;
+    scaleZ[node] = scale.z;
+    markDirty(node);
+}
+
+u32 Scene::getNodeLevel(u32 node) const {
+    return static_cast<u32>(std::upper_bound(levelOffsets.begin() + 1, levelOffsets.end(), node) - (levelOffsets.begin() + 1));
+}
+
+void Scene::markDirty(u32 node) {
+    if (!localDirty[node]) {
+        localDirty[node] = 1;
+        firstDirtyLevel = std::min(firstDirtyLevel, getNodeLevel(node));
+    }
+}
+
+void Scene::updateTransforms(JobSystem* jobSystem) {
+    updatedNodeCount = 0;
+    if (firstDirtyLevel == UINT32_MAX) {
+        return;
+    }
+
+    updateVersion++;
+
+    // Levels above the first change keep their matrices, a level only depends on the one before it
+    for (u32 level = firstDirtyLevel; level < getLevelCount(); ++level) {
+        u32 begin = levelOffsets[level];
+        u32 count = levelOffsets[level + 1] - begin;
+
+        if (jobSystem && count >= PARALLEL_THRESHOLD) {
+            u32 chunkSize = std::max(count / (jobSystem->getNumThreads() * 4), PARALLEL_THRESHOLD / 4);
+            jobSystem->parallelFor(count, chunkSize, [&](u32 chunkBegin, u32 chunkEnd) {
+                updateRange(begin + chunkBegin, begin + chunkEnd);
+            });
+        }
+        else {
+            updateRange(begin, begin + count);
+        }
+    }
+
+    firstDirtyLevel = UINT32_MAX;
+}
+
+void Scene::updateRange(u32 begin, u32 end) {
+    u32 updated = 0;
+
+    for (u32 i = begin; i < end; ++i) {
+        u32 parent = parents[i];
+        bool parentChanged = parent != NO_PARENT && worldVersions[parent] == updateVersion;
+        if (!localDirty[i] && !parentChanged) {
+            continue;
+        }
+
+        // Translation * rotation * scale, the rotation has to be normalized
+        float x = rotationX[i], y = rotationY[i], z = rotationZ[i], w = rotationW[i];
+        float sx = scaleX[i], sy = scaleY[i], sz = scaleZ[i];
+
+        glm::mat4 local;
+        local[0][0] = (1.0f - 2.0f * (y * y + z * z)) * sx;
+        local[0][1] = 2.0f * (x * y + w * z) * sx;
+        local[0][2] = 2.0f * (x * z - w * y) * sx;
+        local[0][3] = 0.0f;
+        local[1][0] = 2.0f * (x * y - w * z) * sy;
+        local[1][1] = (1.0f - 2.0f * (x * x + z * z)) * sy;
+        local[1][2] = 2.0f * (y * z + w * x) * sy;
+        local[1][3] = 0.0f;
+        local[2][0] = 2.0f * (x * z + w * y) * sz;
+        local[2][1] = 2.0f * (y * z - w * x) * sz;
+        local[2][2] = (1.0f - 2.0f * (x * x + y * y)) * sz;
+        local[2][3] = 0.0f;
+        local[3][0] = positionX[i];
+        local[3][1] = positionY[i];
+        local[3][2] = positionZ[i];
+        local[3][3] = 1.0f;
+
+        if (parent == NO_PARENT) {
+            worldMatrices[i] = local;
+        }
+        else {
+            multiplyMatrix(worldMatrices[parent], local, worldMatrices[i]);
+        }
+
+        localDirty[i] = 0;
+        worldVersions[i] = updateVersion;
+        updated++;
+    }
+
+    updatedNodeCount.fetch_add(updated, std::memory_order_relaxed);
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "types.h"
+
+class JobSystem;
+
+// Transform hierarchy stored as structure of arrays. Nodes are added level by level, a parent always lives
+// in an earlier level, so every level is a contiguous range whose nodes can be updated in parallel
+class Scene {
+public:
+    static constexpr u32 NO_PARENT = 0xFFFFFFFF;
+
+    void clear();
+    void reserve(u32 nodeCount);
+
+    // The parent has to be in the last level or the one before it
+    u32 addNode(u32 parent, const glm::vec3& position, const glm::quat& rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f), const glm::vec3& scale = glm::vec3(1.0f));
+
+    // Not thread safe, the changes are applied by the next updateTransforms()
+    void setPosition(u32 node, const glm::vec3& position);
+    void setRotation(u32 node, const glm::quat& rotation);
+    void setScale(u32 node, const glm::vec3& scale);
+
+    // Recomputes the world matrices of changed nodes and everything below them, unchanged subtrees are skipped
+    void updateTransforms(JobSystem* jobSystem);
+
+    const glm::mat4* getWorldMatrices() const { return worldMatrices.data(); }
+    u32 getNodeCount() const { return static_cast<u32>(parents.size()); }
+    u32 getLevelCount() const { return static_cast<u32>(levelOffsets.size()) - 1; }
+    // World matrices recomputed by the last update
+    u32 getUpdatedNodeCount() const { return updatedNodeCount.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr u32 PARALLEL_THRESHOLD = 4096;
+
+    u32 getNodeLevel(u32 node) const;
+    void markDirty(u32 node);
+    void updateRange(u32 begin, u32 end);
+
+    std::vector<float> positionX;
+    std::vector<float> positionY;
+    std::vector<float> positionZ;
+    std::vector<float> rotationX;
+    std::vector<float> rotationY;
+    std::vector<float> rotationZ;
+    std::vector<float> rotationW;
+    std::vector<float> scaleX;
+    std::vector<float> scaleY;
+    std::vector<float> scaleZ;
+    std::vector<u32> parents;
+    std::vector<glm::mat4> worldMatrices;
+
+    // Set by the setters, a node is recomputed if it or its parent changed
+    std::vector<u8> localDirty;
+    // Update in which the world matrix last changed, saves clearing a flag per node every update
+    std::vector<u32> worldVersions;
+    u32 updateVersion = 0;
+
+    // Level i covers the nodes [levelOffsets[i], levelOffsets[i + 1])
+    std::vector<u32> levelOffsets { 0 };
+    u32 firstDirtyLevel = UINT32_MAX;
+    std::atomic<u32> updatedNodeCount { 0 };
+};
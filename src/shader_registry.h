@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+#include "types.h"
+
+// SPIR-V compiled into the binary at build time, see CMake/EmbedShaders.cmake
+struct EmbeddedShader {
+    std::string_view name;
+    const u32* code;
+    size_t size;
+};
+
+// Shaders are looked up by their path relative to the build directory, e.g. "shaders/model.vert.spv"
+const EmbeddedShader* findEmbeddedShader(std::string_view name);
@@ -1,16 +1,30 @@
 #version 450 core
+#extension GL_EXT_nonuniform_qualifier : require
 
 layout(location = 0) in vec3 in_normal;
 layout(location = 1) in vec2 in_texcoord;
 layout(location = 2) in vec3 in_position;
+layout(location = 3) flat in uint in_materialIndex;
 
-layout(set = 0, binding = 1) uniform sampler2D in_albedoSampledTexture;
+struct Material {
+    uint albedoTexture;
+    uint sampler;
+};
+
+layout(set = 0, binding = 1) readonly buffer materials {
+    Material materials[];
+} u_materials;
+
+// Bindless table, one instanced draw can mix materials so the index is not uniform
+layout(set = 1, binding = 0) uniform texture2D u_textures[];
+layout(set = 1, binding = 1) uniform sampler u_samplers[];
 
 layout(location = 0) out vec4 out_color;
 
 void main() {
     vec3 view = normalize(-in_position);
-    vec4 texSample = texture(in_albedoSampledTexture, in_texcoord);
+    Material material = u_materials.materials[in_materialIndex];
+    vec4 texSample = texture(sampler2D(u_textures[nonuniformEXT(material.albedoTexture)], u_samplers[nonuniformEXT(material.sampler)]), in_texcoord);
     vec3 normal = normalize(in_normal);
 
     vec3 light = normalize(vec3(1, 1, -1));
@@ -4,19 +4,30 @@ layout(location = 0) in vec3 in_position;
 layout(location = 1) in vec3 in_normal;
 layout(location = 2) in vec2 in_texcoord;
 
-layout(set = 0, binding = 0) uniform transforms {
+// The normal matrix columns are padded to 16 bytes, the padding of the first one holds the material index
+struct Instance {
     mat4 modelViewProjection;
     mat4 modelView;
-} u_transforms;
+    vec3 normalMatrix0;
+    uint materialIndex;
+    vec3 normalMatrix1;
+    vec3 normalMatrix2;
+};
+
+layout(set = 0, binding = 0) readonly buffer instances {
+    Instance transforms[];
+} u_instances;
 
 layout(location = 0) out vec3 out_normal;
 layout(location = 1) out vec2 out_texcoord;
 layout(location = 2) out vec3 out_position;
+layout(location = 3) flat out uint out_materialIndex;
 
 void main() {
-    mat4 modelViewProjection = u_transforms.modelViewProjection;
-    gl_Position = modelViewProjection * vec4(in_position.x, in_position.y, in_position.z, 1.0);
+    Instance instance = u_instances.transforms[gl_InstanceIndex];
+    gl_Position = instance.modelViewProjection * vec4(in_position.x, in_position.y, in_position.z, 1.0);
     out_texcoord = in_texcoord;
-    out_normal = mat3(transpose(inverse(u_transforms.modelView))) * in_normal;
-    out_position = (u_transforms.modelView * vec4(in_position, 1.0)).xyz;
+    out_normal = mat3(instance.normalMatrix0, instance.normalMatrix1, instance.normalMatrix2) * in_normal;
+    out_position = (instance.modelView * vec4(in_position, 1.0)).xyz;
+    out_materialIndex = instance.materialIndex;
 }
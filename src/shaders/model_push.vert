@@ -0,0 +1,28 @@
+#version 450 core
+
+layout(location = 0) in vec3 in_position;
+layout(location = 1) in vec3 in_normal;
+layout(location = 2) in vec2 in_texcoord;
+
+// Everything a draw needs comes with the draw, matches ModelDrawConstants
+layout(push_constant) uniform constants {
+    mat4 modelViewProjection;
+    vec4 modelViewRows[3];
+    uint objectIndex;
+    uint materialIndex;
+} u_draw;
+
+layout(location = 0) out vec3 out_normal;
+layout(location = 1) out vec2 out_texcoord;
+layout(location = 2) out vec3 out_position;
+layout(location = 3) flat out uint out_materialIndex;
+
+void main() {
+    vec4 position = vec4(in_position, 1.0);
+    gl_Position = u_draw.modelViewProjection * position;
+    out_texcoord = in_texcoord;
+    // Uniform scale only, the fragment shader normalizes the result
+    out_normal = vec3(dot(u_draw.modelViewRows[0].xyz, in_normal), dot(u_draw.modelViewRows[1].xyz, in_normal), dot(u_draw.modelViewRows[2].xyz, in_normal));
+    out_position = vec3(dot(u_draw.modelViewRows[0], position), dot(u_draw.modelViewRows[1], position), dot(u_draw.modelViewRows[2], position));
+    out_materialIndex = u_draw.materialIndex;
+}
@@ -0,0 +1,10 @@
+#version 450 core
+
+layout(set = 0, binding = 0) uniform sampler2D in_color;
+
+layout(location = 0) out vec4 out_color;
+
+void main() {
+    vec4 color = texelFetch(in_color, ivec2(gl_FragCoord.xy), 0);
+    out_color = vec4(vec3(length(color.rgb)/sqrt(3.0)), color.a);
+}
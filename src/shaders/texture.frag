@@ -1,14 +1,21 @@
 #version 450 core
+#extension GL_EXT_nonuniform_qualifier : require
 
 layout(location = 0) in vec3 in_color;
 layout(location = 1) in vec2 in_uv;
 
 layout(location = 0) out vec4 out_color;
 
-layout(set = 0, binding = 0) uniform sampler2D in_sampled_texture;
+layout(set = 0, binding = 0) uniform texture2D u_textures[];
+layout(set = 0, binding = 1) uniform sampler u_samplers[];
+
+layout(push_constant) uniform pushConstants {
+    uint textureIndex;
+    uint samplerIndex;
+} u_pushConstants;
 
 void main() {
-    vec4 textureSample = texture(in_sampled_texture, in_uv);
+    vec4 textureSample = texture(sampler2D(u_textures[u_pushConstants.textureIndex], u_samplers[u_pushConstants.samplerIndex]), in_uv);
     // out_color = vec4(in_color, 1.0);
     out_color = textureSample;
 }
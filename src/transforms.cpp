@@ -0,0 +1,126 @@
+#include "transforms.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <immintrin.h>
+#define TRANSFORMS_SSE 1
+#endif
+
+#include <cstring>
+
+#include <glm/geometric.hpp>
+
+#ifdef TRANSFORMS_SSE
+// Columns of a * b, a is already loaded
+static inline void multiplyColumns(const __m128 a[4], const float* b, float* result) {
+    for (int column = 0; column < 4; ++column) {
+        const float* bColumn = b + column * 4;
+        __m128 value = _mm_mul_ps(a[0], _mm_set1_ps(bColumn[0]));
+        value = _mm_add_ps(value, _mm_mul_ps(a[1], _mm_set1_ps(bColumn[1])));
+        value = _mm_add_ps(value, _mm_mul_ps(a[2], _mm_set1_ps(bColumn[2])));
+        value = _mm_add_ps(value, _mm_mul_ps(a[3], _mm_set1_ps(bColumn[3])));
+        _mm_storeu_ps(result + column * 4, value);
+    }
+}
+
+static inline __m128 cross(__m128 a, __m128 b) {
+    __m128 aYZX = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+    __m128 bYZX = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+    __m128 c = _mm_sub_ps(_mm_mul_ps(a, bYZX), _mm_mul_ps(aYZX, b));
+    return _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1));
+}
+#endif
+
+void multiplyMatrix(const glm::mat4& a, const glm::mat4& b, glm::mat4& result) {
+#ifdef TRANSFORMS_SSE
+    const float* aData = &a[0][0];
+    __m128 aColumns[4] = { _mm_loadu_ps(aData), _mm_loadu_ps(aData + 4), _mm_loadu_ps(aData + 8), _mm_loadu_ps(aData + 12) };
+    multiplyColumns(aColumns, &b[0][0], &result[0][0]);
+#else
+    result = a * b;
+#endif
+}
+
+void computeModelInstances(const glm::mat4& viewProjection, const glm::mat4& view, const glm::mat4* modelMatrices, const u32* modelMaterials, const u32* modelIndices,
+                           u32 count, ModelInstance* instances) {
+#ifdef TRANSFORMS_SSE
+    // The camera matrices stay in registers for the whole batch
+    const float* viewProjectionData = &viewProjection[0][0];
+    const float* viewData = &view[0][0];
+    __m128 viewProjectionColumns[4] = { _mm_loadu_ps(viewProjectionData), _mm_loadu_ps(viewProjectionData + 4), _mm_loadu_ps(viewProjectionData + 8), _mm_loadu_ps(viewProjectionData + 12) };
+    __m128 viewColumns[4] = { _mm_loadu_ps(viewData), _mm_loadu_ps(viewData + 4), _mm_loadu_ps(viewData + 8), _mm_loadu_ps(viewData + 12) };
+
+    for (u32 i = 0; i < count; ++i) {
+        const float* model = &modelMatrices[modelIndices[i]][0][0];
+        ModelInstance& instance = instances[i];
+
+        alignas(16) float modelView[16];
+        multiplyColumns(viewColumns, model, modelView);
+        multiplyColumns(viewProjectionColumns, model, &instance.modelViewProjection[0][0]);
+
+        __m128 column0 = _mm_load_ps(modelView);
+        __m128 column1 = _mm_load_ps(modelView + 4);
+        __m128 column2 = _mm_load_ps(modelView + 8);
+        _mm_storeu_ps(&instance.modelView[0][0], column0);
+        _mm_storeu_ps(&instance.modelView[1][0], column1);
+        _mm_storeu_ps(&instance.modelView[2][0], column2);
+        _mm_storeu_ps(&instance.modelView[3][0], _mm_load_ps(modelView + 12));
+
+        // inverse(M)^T = cofactor(M) / det(M), the cofactor columns are cross products of the other two columns
+        __m128 cofactor0 = cross(column1, column2);
+        __m128 cofactor1 = cross(column2, column0);
+        __m128 cofactor2 = cross(column0, column1);
+
+        __m128 product = _mm_mul_ps(column0, cofactor0);
+        float determinant = _mm_cvtss_f32(product)
+            + _mm_cvtss_f32(_mm_shuffle_ps(product, product, _MM_SHUFFLE(1, 1, 1, 1)))
+            + _mm_cvtss_f32(_mm_shuffle_ps(product, product, _MM_SHUFFLE(2, 2, 2, 2)));
+        __m128 inverseDeterminant = _mm_set1_ps(1.0f / determinant);
+
+        _mm_storeu_ps(&instance.normalMatrix[0][0], _mm_mul_ps(cofactor0, inverseDeterminant));
+        _mm_storeu_ps(&instance.normalMatrix[1][0], _mm_mul_ps(cofactor1, inverseDeterminant));
+        _mm_storeu_ps(&instance.normalMatrix[2][0], _mm_mul_ps(cofactor2, inverseDeterminant));
+        memcpy(&instance.normalMatrix[0].w, &modelMaterials[modelIndices[i]], sizeof(u32));
+    }
+#else
+    for (u32 i = 0; i < count; ++i) {
+        const glm::mat4& model = modelMatrices[modelIndices[i]];
+        ModelInstance& instance = instances[i];
+
+        instance.modelViewProjection = viewProjection * model;
+        instance.modelView = view * model;
+
+        glm::vec3 column0(instance.modelView[0]);
+        glm::vec3 column1(instance.modelView[1]);
+        glm::vec3 column2(instance.modelView[2]);
+        glm::vec3 cofactor0 = glm::cross(column1, column2);
+        float inverseDeterminant = 1.0f / glm::dot(column0, cofactor0);
+
+        instance.normalMatrix[0] = glm::vec4(cofactor0 * inverseDeterminant, 0.0f);
+        instance.normalMatrix[1] = glm::vec4(glm::cross(column2, column0) * inverseDeterminant, 0.0f);
+        instance.normalMatrix[2] = glm::vec4(glm::cross(column0, column1) * inverseDeterminant, 0.0f);
+        memcpy(&instance.normalMatrix[0].w, &modelMaterials[modelIndices[i]], sizeof(u32));
+    }
+#endif
+}
+
+void computeModelDrawConstants(const glm::mat4& viewProjection, const glm::mat4& view, const glm::mat4* modelMatrices, const u32* modelMaterials, const u32* modelIndices,
+                               u32 count, ModelDrawConstants* constants) {
+    for (u32 i = 0; i < count; ++i) {
+        u32 index = modelIndices[i];
+        ModelDrawConstants& drawConstants = constants[i];
+
+        glm::mat4 modelView;
+        multiplyMatrix(view, modelMatrices[index], modelView);
+        multiplyMatrix(viewProjection, modelMatrices[index], drawConstants.modelViewProjection);
+
+        // The last row of a model view matrix is always (0, 0, 0, 1)
+        for (u32 row = 0; row < 3; ++row) {
+            drawConstants.modelViewRows[row] = glm::vec4(modelView[0][row], modelView[1][row], modelView[2][row], modelView[3][row]);
+        }
+
+        drawConstants.objectIndex = index;
+        drawConstants.materialIndex = modelMaterials[index];
+        drawConstants.padding[0] = 0;
+        drawConstants.padding[1] = 0;
+    }
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+
+#include "types.h"
+
+// Matches the instance struct in model.vert and model_cull.comp, indexed by gl_InstanceIndex.
+// The normal matrix columns are padded to vec4, the padding of the first one holds the material index as u32
+struct ModelInstance {
+    glm::mat4 modelViewProjection;
+    glm::mat4 modelView;
+    glm::vec4 normalMatrix[3];
+};
+
+// Matches the push constant block in model_push.vert, 128 bytes is the smallest push constant limit a device may have.
+// Only the affine rows of the model view matrix are stored, the model is scaled uniformly so they also transform the normals
+struct ModelDrawConstants {
+    glm::mat4 modelViewProjection;
+    glm::vec4 modelViewRows[3];
+    u32 objectIndex;
+    u32 materialIndex;
+    u32 padding[2];
+};
+
+static_assert(sizeof(ModelDrawConstants) == 128);
+
+// result = a * b
+void multiplyMatrix(const glm::mat4& a, const glm::mat4& b, glm::mat4& result);
+
+// Writes count instances, instance i uses modelMatrices[modelIndices[i]] and modelMaterials[modelIndices[i]]. The normal matrix
+// is the inverse transpose of the upper 3x3 of the model view matrix, computed once per instance instead of per vertex
+void computeModelInstances(const glm::mat4& viewProjection, const glm::mat4& view, const glm::mat4* modelMatrices, const u32* modelMaterials, const u32* modelIndices,
+                           u32 count, ModelInstance* instances);
+
+// Same inputs as computeModelInstances, for draws that push their data instead of reading an instance
+void computeModelDrawConstants(const glm::mat4& viewProjection, const glm::mat4& view, const glm::mat4* modelMatrices, const u32* modelMaterials, const u32* modelIndices,
+                               u32 count, ModelDrawConstants* constants);
@@ -49,9 +49,11 @@ namespace utils {
     inline std::string getCurrentTimeFormatted() {
         std::time_t now = std::time(nullptr);
 
-#ifdef WIN32
         std::tm localTime{};
+#ifdef _WIN32
         localtime_s(&localTime, &now);
+#else
+        localtime_r(&now, &localTime);
 #endif
 
         std::ostringstream oss;
@@ -85,6 +87,24 @@ namespace utils {
         return numStr;
     }
 
+    inline u64 hashCombine(u64 seed, u64 value) {
+        return seed ^ (value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2));
+    }
+
+    inline u64 hashBytes(u64 seed, const void* data, size_t size) {
+        return hashCombine(seed, std::hash<std::string_view>{}(std::string_view(static_cast<const char*>(data), size)));
+    }
+
+    // Raw bytes of a cache key, the whole key is compared on a hit so a hash collision can't return the wrong entry
+    inline void appendKey(std::string* key, const void* data, size_t size) {
+        key->append(static_cast<const char*>(data), size);
+    }
+
+    template<class T>
+    inline void appendKey(std::string* key, const T& value) {
+        appendKey(key, &value, sizeof(T));
+    }
+
     #define ARRAY_COUNT(array) (sizeof(array) / sizeof(array[0]))
     #define ALIGN_UP_POW2(x, p) (((x) + (p) - 1) &~ ((p) - 1))
 
@@ -99,4 +119,25 @@ namespace utils {
             );
     }
 
+    // World space planes facing inwards, from the clip space bounds -w <= x, y <= w and 0 <= z <= w.
+    // The far plane of an infinite projection has no normal and is left as a plane that never culls
+    inline void getFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6]) {
+        glm::vec4 rows[4];
+        for (int i = 0; i < 4; ++i) {
+            rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+        }
+
+        planes[0] = rows[3] + rows[0];
+        planes[1] = rows[3] - rows[0];
+        planes[2] = rows[3] + rows[1];
+        planes[3] = rows[3] - rows[1];
+        planes[4] = rows[2];
+        planes[5] = rows[3] - rows[2];
+
+        for (int i = 0; i < 6; ++i) {
+            float length = glm::length(glm::vec3(planes[i]));
+            planes[i] = length > 0.0f ? planes[i] / length : glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        }
+    }
+
 } // namespace utils
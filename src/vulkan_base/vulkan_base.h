@@ -1,12 +1,20 @@
 #pragma once
 
 #include <cassert>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
 
 #include <vulkan/vulkan.hpp>
 
 #include "logger.h"
+#include "profiler.h"
 #include "types.h"
 
+class JobSystem;
+
 #define VKA(expr)													\
 	([&]() -> decltype(auto) {										\
 		try {														\
@@ -25,18 +33,105 @@ struct VulkanQueue {
 	u32 familyIndex = 0;
 };
 
+struct VulkanImage {
+	vk::Image image {};
+	vk::ImageView imageView {};
+	vk::DeviceMemory memory {};
+};
+
 struct VulkanSwapchain {
 	vk::SwapchainKHR swapchain {};
 	u32 width;
 	u32 height;
 	vk::Format format;
+	vk::PresentModeKHR presentMode;
 	std::vector<vk::Image> images {};
 	std::vector<vk::ImageView> imageViews {};
+	// Headless rendering has no swapchain handle, the images are owned here instead
+	std::vector<VulkanImage> offscreenImages {};
+};
+
+// Fixed function state that is either baked into a pipeline or set while recording with extended dynamic state
+struct VulkanPipelineState {
+	vk::CullModeFlags cullMode = vk::CullModeFlagBits::eNone;
+	vk::FrontFace frontFace = vk::FrontFace::eCounterClockwise;
+	bool depthTestEnable = true;
+	bool depthWriteEnable = true;
+	vk::CompareOp depthCompareOp = vk::CompareOp::eGreaterOrEqual;
+	bool depthBiasEnable = false;
+	bool blendEnable = true;
+	vk::SampleCountFlagBits sampleCount = vk::SampleCountFlagBits::e1;
 };
 
 struct VulkanPipeline {
 	vk::Pipeline pipeline {};
 	vk::PipelineLayout pipelineLayout {};
+
+	// Which parts of VulkanPipelineState have to be set with setPipelineState before drawing
+	bool dynamicDepthCull = false;
+	bool dynamicDepthBias = false;
+	bool dynamicBlendEnable = false;
+	bool dynamicSampleCount = false;
+
+	// Set when the pipeline was fast-linked from graphics pipeline libraries without link time optimization
+	bool fastLinked = false;
+	vk::Pipeline libraries[4] {};
+};
+
+// Graphics pipeline library parts (vertex input, pre-rasterization, fragment shader, fragment output) shared between pipelines.
+// Keyed by the raw bytes of the state each part depends on, the libraries are created with layouts owned by the cache
+struct VulkanPipelineLibraryCache {
+	std::unordered_map<std::string, vk::Pipeline> libraries {};
+	std::unordered_map<std::string, vk::PipelineLayout> layouts {};
+};
+
+// All pipelines of one shader and vertex format combination, keyed by the state they were baked with.
+// With extended dynamic state a single pipeline covers every state that can be set while recording.
+struct VulkanPipelineVariants {
+	std::function<VulkanPipeline(const VulkanPipelineState* state, bool dynamicState)> create;
+	bool dynamicState = true;
+	std::unordered_map<u64, VulkanPipeline> pipelines {};
+	std::unordered_set<u64> requestedStates {};
+	u32 permutationsAvoided = 0;
+
+	// Fast-linked pipelines get an optimized link on these jobs, the result replaces them on the next getPipelineVariant
+	JobSystem* backgroundJobs = nullptr;
+	std::mutex mutex {};
+	std::condition_variable linksFinished {};
+	u32 pendingLinks = 0;
+	std::vector<std::pair<u64, vk::Pipeline>> optimizedPipelines {};
+};
+
+// Optional device features, filled in by createLogicalDevice depending on what the GPU supports
+struct VulkanFeatures {
+	bool synchronization2 = false;
+	bool dynamicRendering = false;
+	bool dynamicRenderingLocalRead = false;
+	bool extendedDynamicState = false;
+	bool extendedDynamicState2 = false;
+	bool extendedDynamicState3BlendEnable = false;
+	bool extendedDynamicState3SampleCount = false;
+	bool graphicsPipelineLibrary = false;
+	bool drawIndirectCount = false;
+	bool pushDescriptor = false;
+	bool presentWait = false;
+};
+
+// Runs once the timeline passed the value, the GPU is done with the resources by then
+struct VulkanDeferredDestruction {
+	u64 timelineValue = 0;
+	std::function<void()> destroy {};
+};
+
+// One timeline semaphore for the whole device, every submission signals the next value.
+// Waiting for a value waits for that submission and everything submitted before it
+struct VulkanTimeline {
+	vk::Semaphore semaphore {};
+	u64 submittedValue = 0;
+	u64 completedValue = 0;
+	// Later submissions wait for this value so they see the uploaded data
+	u64 uploadValue = 0;
+	std::vector<VulkanDeferredDestruction> deferredDestructions {};
 };
 
 struct VulkanContext {
@@ -45,7 +140,10 @@ struct VulkanContext {
 	vk::PhysicalDeviceProperties physicalDeviceProperties {};
 	vk::Device device {};
 	VulkanQueue graphicsQueue {};
+	VulkanFeatures features {};
+	VulkanTimeline timeline {};
 	vk::DebugUtilsMessengerEXT debugCallback {};
+	bool loadShadersFromDisk = false;
 };
 
 struct VulkanBuffer {
@@ -54,33 +152,260 @@ struct VulkanBuffer {
 	bool resizeableBar = false;
 };
 
-struct VulkanImage {
-	vk::Image image {};
-	vk::ImageView imageView {};
-	vk::DeviceMemory memory {};
+// Hands out descriptor sets from a chain of pools, a new pool is added whenever the current one runs out.
+// Pool sizes are given per set and scaled by the number of sets per pool
+struct VulkanDescriptorAllocator {
+	std::vector<vk::DescriptorPoolSize> sizesPerSet {};
+	u32 setsPerPool = 0;
+	vk::DescriptorPool currentPool {};
+	std::vector<vk::DescriptorPool> usedPools {};
+	std::vector<vk::DescriptorPool> freePools {};
+};
+
+struct VulkanDescriptorWrite {
+	u32 binding = 0;
+	vk::DescriptorType type = vk::DescriptorType::eSampler;
+	vk::DescriptorImageInfo image {};
+	vk::DescriptorBufferInfo buffer {};
+};
+
+// Descriptor sets keyed by the exact bytes of layout and bound resources, an unchanged set is looked up instead of written again
+struct VulkanDescriptorCache {
+	VulkanDescriptorAllocator allocator {};
+	std::unordered_map<std::string, vk::DescriptorSet> sets {};
+	u32 writeCount = 0;
+};
+
+constexpr u32 BINDLESS_TEXTURE_BINDING = 0;
+constexpr u32 BINDLESS_SAMPLER_BINDING = 1;
+
+// One global descriptor set with partially bound arrays of sampled images and samplers. Textures and samplers are
+// registered into slots once and shaders index the arrays, so switching textures doesn't need another descriptor set
+struct VulkanBindlessTable {
+	vk::DescriptorSetLayout descriptorSetLayout {};
+	vk::DescriptorPool descriptorPool {};
+	vk::DescriptorSet descriptorSet {};
+	u32 maxTextures = 0;
+	u32 maxSamplers = 0;
+	u32 textureCount = 0;
+	u32 samplerCount = 0;
+	std::vector<u32> freeTextureSlots {};
+};
+
+constexpr u32 GPU_PROFILER_MAX_SCOPES = 64;
+constexpr u32 GPU_PROFILER_HISTORY = 128;
+
+// Copies the name, render graph group names don't outlive a graph rebuild
+struct VulkanGpuScope {
+	std::string name {};
+	u32 depth = 0;
+};
+
+// Scope i of a frame writes queries 2 * i and 2 * i + 1
+struct VulkanGpuProfilerFrame {
+	vk::QueryPool queryPool {};
+	std::vector<VulkanGpuScope> scopes {};
+	bool recorded = false;
+};
+
+// Rolling statistics of one scope, identified by the names of all scopes it is nested in
+struct VulkanGpuTiming {
+	std::string path {};
+	std::string name {};
+	u32 depth = 0;
+	std::vector<float> history {};
+	u32 historyCount = 0;
+	float last = 0.0f;
+	float average = 0.0f;
+	float median = 0.0f;
+	float percentile95 = 0.0f;
+};
+
+// Every SCOPE_LABEL on the frame's primary command buffer also writes timestamps. Each frame in flight has its own
+// query pool that is read back when the frame slot comes around again, its timeline value has completed by then
+struct VulkanGpuProfiler {
+	bool supported = false;
+	double timestampPeriod = 0.0;
+	u64 timestampMask = 0;
+	std::vector<VulkanGpuProfilerFrame> frames {};
+	VulkanGpuProfilerFrame* recordingFrame = nullptr;
+	vk::CommandBuffer commandBuffer {};
+	u32 depth = 0;
+	std::vector<VulkanGpuTiming> timings {};
+	// Indices into timings in the order of the last frame that was read back
+	std::vector<u32> frameTimings {};
+};
+
+constexpr u32 RENDER_GRAPH_NONE = UINT32_MAX;
+// Transient images are allocated in multiples of this, so resizing within a bucket keeps them
+constexpr u32 RENDER_GRAPH_EXTENT_BUCKET = 256;
+
+struct VulkanRenderGraphAttachment {
+	u32 image = RENDER_GRAPH_NONE;
+	u32 resolveImage = RENDER_GRAPH_NONE;
+	vk::AttachmentLoadOp loadOp = vk::AttachmentLoadOp::eDontCare;
+	vk::ClearValue clearValue {};
+};
+
+// How a pass uses one image, derived from its declaration by compileRenderGraph
+struct VulkanRenderGraphUse {
+	u32 image = RENDER_GRAPH_NONE;
+	vk::ImageLayout layout = vk::ImageLayout::eUndefined;
+	vk::PipelineStageFlags2 stages {};
+	vk::AccessFlags2 access {};
+	bool write = false;
+	bool attachment = false;
+	vk::AttachmentStoreOp storeOp = vk::AttachmentStoreOp::eDontCare;
+};
+
+struct VulkanRenderGraphBarrier {
+	u32 image = RENDER_GRAPH_NONE;
+	vk::ImageMemoryBarrier2 barrier {};
+};
+
+// A pass only declares what it reads and writes, layouts, barriers and store ops are derived from that
+struct VulkanRenderGraphPass {
+	const char* name = "";
+	std::vector<VulkanRenderGraphAttachment> colorAttachments {};
+	VulkanRenderGraphAttachment depthAttachment {};
+	std::vector<u32> inputAttachments {};
+	std::vector<u32> sampledImages {};
+	bool secondaryCommandBuffers = false;
+	// Called once rendering or the subpass has begun
+	std::function<void(vk::CommandBuffer commandBuffer)> record {};
+
+	// Filled in by compileRenderGraph
+	std::vector<VulkanRenderGraphUse> uses {};
+	std::vector<VulkanRenderGraphBarrier> barriers {};
+	u32 group = 0;
+	u32 subpass = 0;
+};
+
+// Consecutive passes that become the subpasses of one render pass, or a single pass with dynamic rendering
+struct VulkanRenderGraphGroup {
+	std::string name {};
+	u32 firstPass = 0;
+	u32 passCount = 0;
+	std::vector<VulkanRenderGraphBarrier> barriers {};
+	vk::RenderPass renderPass {};
+	std::vector<u32> attachmentImages {};
+	std::vector<vk::ClearValue> clearValues {};
+	std::vector<vk::Framebuffer> framebuffers {};
+};
+
+struct VulkanRenderGraphImage {
+	const char* name = "";
+	vk::Format format = vk::Format::eUndefined;
+	vk::SampleCountFlagBits sampleCount = vk::SampleCountFlagBits::e1;
+	// Imported images have one image per swapchain image, transient images a single one owned by the graph
+	bool imported = false;
+	vk::ImageLayout finalLayout = vk::ImageLayout::eUndefined;
+	std::vector<vk::Image> images {};
+	std::vector<vk::ImageView> views {};
+
+	// Filled in by compileRenderGraph
+	u32 firstPass = RENDER_GRAPH_NONE;
+	u32 lastPass = 0;
+	vk::DeviceSize size = 0;
+	// Previous image in the same memory, its last use has to finish before this one starts
+	u32 aliasedImage = RENDER_GRAPH_NONE;
+};
+
+// Frame graph that is declared and compiled once per swapchain or rendering path change, then executed every frame
+struct VulkanRenderGraph {
+	// The render area, the transient images can be bigger
+	u32 width = 0;
+	u32 height = 0;
+	// Merges passes into subpasses of render passes, otherwise every pass uses dynamic rendering
+	bool useRenderPass = false;
+	std::vector<VulkanRenderGraphImage> images {};
+	std::vector<VulkanRenderGraphPass> passes {};
+
+	// Filled in by compileRenderGraph
+	std::vector<VulkanRenderGraphGroup> groups {};
+	std::vector<VulkanRenderGraphBarrier> finalBarriers {};
+	std::vector<vk::DeviceMemory> memoryBlocks {};
+	u32 allocatedWidth = 0;
+	u32 allocatedHeight = 0;
+	vk::DeviceSize transientMemorySize = 0;
+	vk::DeviceSize allocatedMemorySize = 0;
 };
 
 // vulkan_device.cpp
 bool initVulkan(VulkanContext* context, u32 instanceExtensionsCount, const char* const* instanceExtensions, u32 deviceExtensionsCount, const char* const* deviceExtensions);
 void exitVulkan(VulkanContext* context);
 
+// vulkan_timeline.cpp
+void createTimeline(VulkanContext* context);
+u64 submitTimeline(VulkanContext* context, VulkanQueue* queue, u32 commandBufferCount, const vk::CommandBuffer* commandBuffers,
+					u32 waitSemaphoreCount = 0, const vk::Semaphore* waitSemaphores = nullptr, const vk::PipelineStageFlags* waitStages = nullptr,
+					u32 signalSemaphoreCount = 0, const vk::Semaphore* signalSemaphores = nullptr);
+u64 updateTimeline(VulkanContext* context);
+void waitTimeline(VulkanContext* context, u64 value);
+void deferDestruction(VulkanContext* context, std::function<void()> destroy);
+void deferDestructionUntil(VulkanContext* context, u64 timelineValue, std::function<void()> destroy);
+void flushDeferredDestructions(VulkanContext* context);
+void destroyTimeline(VulkanContext* context);
+
 // vulkan_swapchain.cpp
-VulkanSwapchain createSwapchain(VulkanContext* context, vk::SurfaceKHR surface, vk::ImageUsageFlags imageUsage, VulkanSwapchain* oldSwapchain=nullptr);
-void destroySwapchain(VulkanContext* context, VulkanSwapchain* swapchain);
+VulkanSwapchain createSwapchain(VulkanContext* context, vk::SurfaceKHR surface, vk::ImageUsageFlags imageUsage, VulkanSwapchain* oldSwapchain=nullptr,
+								vk::PresentModeKHR presentMode = vk::PresentModeKHR::eFifo);
+VulkanSwapchain createOffscreenSwapchain(VulkanContext* context, u32 width, u32 height, vk::Format format, vk::ImageUsageFlags imageUsage, u32 imageCount);
+void destroySwapchain(VulkanContext* context, VulkanSwapchain* swapchain, u64 retireValue);
+
+// vulkan_render_graph.cpp
+u32 addRenderGraphImage(VulkanRenderGraph* graph, const char* name, vk::Format format, vk::SampleCountFlagBits sampleCount = vk::SampleCountFlagBits::e1);
+u32 importRenderGraphImage(VulkanRenderGraph* graph, const char* name, vk::Format format, const std::vector<vk::Image>& images, const std::vector<vk::ImageView>& views, vk::ImageLayout finalLayout);
+void setRenderGraphImportedImages(VulkanRenderGraph* graph, u32 image, const std::vector<vk::Image>& images, const std::vector<vk::ImageView>& views);
+u32 addRenderGraphPass(VulkanRenderGraph* graph, const VulkanRenderGraphPass& pass);
+void compileRenderGraph(VulkanContext* context, VulkanRenderGraph* graph);
+bool resizeRenderGraph(VulkanContext* context, VulkanRenderGraph* graph, u32 width, u32 height);
+void executeRenderGraph(VulkanRenderGraph* graph, vk::CommandBuffer commandBuffer, u32 imageIndex);
+void destroyRenderGraph(VulkanContext* context, VulkanRenderGraph* graph);
+vk::ImageView getRenderGraphImageView(const VulkanRenderGraph* graph, u32 image, u32 imageIndex);
+vk::RenderPass getRenderGraphRenderPass(const VulkanRenderGraph* graph, u32 pass);
+vk::Framebuffer getRenderGraphFramebuffer(const VulkanRenderGraph* graph, u32 pass, u32 imageIndex);
+
+// vulkan_descriptors.cpp
+void initDescriptorAllocator(VulkanDescriptorAllocator* allocator, u32 setsPerPool, const vk::DescriptorPoolSize* sizesPerSet, u32 sizeCount);
+vk::DescriptorSet allocateDescriptorSet(VulkanContext* context, VulkanDescriptorAllocator* allocator, vk::DescriptorSetLayout layout);
+void resetDescriptorAllocator(VulkanContext* context, VulkanDescriptorAllocator* allocator);
+void destroyDescriptorAllocator(VulkanContext* context, VulkanDescriptorAllocator* allocator);
+vk::DescriptorSet getCachedDescriptorSet(VulkanContext* context, VulkanDescriptorCache* cache, vk::DescriptorSetLayout layout, const VulkanDescriptorWrite* writes, u32 writeCount);
+void resetDescriptorCache(VulkanContext* context, VulkanDescriptorCache* cache);
+
+// vulkan_bindless.cpp
+void createBindlessTable(VulkanContext* context, VulkanBindlessTable* table, u32 maxTextures, u32 maxSamplers);
+u32 registerBindlessTexture(VulkanContext* context, VulkanBindlessTable* table, vk::ImageView imageView, vk::ImageLayout layout = vk::ImageLayout::eShaderReadOnlyOptimal);
+void releaseBindlessTexture(VulkanBindlessTable* table, u32 slot);
+u32 registerBindlessSampler(VulkanContext* context, VulkanBindlessTable* table, vk::Sampler sampler);
+void destroyBindlessTable(VulkanContext* context, VulkanBindlessTable* table);
 
-// vulkan_renderpass.cpp
-vk::RenderPass createRenderPass(VulkanContext* context, vk::Format format, vk::SampleCountFlagBits sampleCount);
-void destroyRenderPass(VulkanContext* context, vk::RenderPass renderPass);
+// vulkan_profiler.cpp
+void createGpuProfiler(VulkanContext* context, VulkanGpuProfiler* profiler, u32 frameCount);
+void beginGpuProfilerFrame(VulkanContext* context, VulkanGpuProfiler* profiler, vk::CommandBuffer commandBuffer, u32 frameIndex);
+void endGpuProfilerFrame(VulkanGpuProfiler* profiler);
+void destroyGpuProfiler(VulkanContext* context, VulkanGpuProfiler* profiler);
 
 // vulkan_pipeline.cpp
 VulkanPipeline createPipeline(VulkanContext* context, const char* vertexShaderFilename, const char* fragmentShaderFilename,
 								VkRenderPass renderPass, u32 width, u32 height, vk::VertexInputAttributeDescription* attributes,
 								u32 numAttributes, vk::VertexInputBindingDescription* binding, u32 numSetLayout, vk::DescriptorSetLayout* setLayouts,
-								vk::PushConstantRange* pushConstant, u32 subpassIndex = 0, vk::SampleCountFlagBits sampleCount = vk::SampleCountFlagBits::e1);
+								vk::PushConstantRange* pushConstant, u32 subpassIndex = 0, vk::SampleCountFlagBits sampleCount = vk::SampleCountFlagBits::e1,
+								const vk::PipelineRenderingCreateInfo* renderingInfo = nullptr, const VulkanPipelineState* state = nullptr, bool dynamicState = false,
+								VulkanPipelineLibraryCache* libraryCache = nullptr);
+VulkanPipeline createComputePipeline(VulkanContext* context, const char* shaderFilename, u32 numSetLayout, vk::DescriptorSetLayout* setLayouts,
+									vk::PushConstantRange* pushConstant = nullptr);
+vk::Pipeline linkPipelineLibraries(VulkanContext* context, const VulkanPipeline* pipeline, bool optimize);
+void destroyPipelineLibraryCache(VulkanContext* context, VulkanPipelineLibraryCache* cache);
 
 void destroyPipeline(VulkanContext* context, VulkanPipeline* pipeline);
+void setPipelineState(vk::CommandBuffer commandBuffer, const VulkanPipeline* pipeline, const VulkanPipelineState& state);
+VulkanPipeline* getPipelineVariant(VulkanContext* context, VulkanPipelineVariants* variants, const VulkanPipelineState& state);
+void destroyPipelineVariants(VulkanContext* context, VulkanPipelineVariants* variants);
 
 // vulkan_utils.cpp
+u32 findMemoryType(VulkanContext* context, u32 typeFilter, vk::MemoryPropertyFlags memoryProperties);
 bool detectResizeableBar(VulkanContext* context);
 void createBuffer(VulkanContext* context, VulkanBuffer* buffer, u64 size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags memoryProperties);
 void uploadDataToBuffer(VulkanContext* context, VulkanBuffer* buffer, void* data, size_t size);
@@ -88,6 +413,8 @@ void destroyBuffer(VulkanContext* context, VulkanBuffer* buffer);
 void createImage(VulkanContext* context, VulkanImage* image, u32 width, u32 height, vk::Format format, vk::ImageUsageFlags usage, vk::SampleCountFlagBits sampleCount = vk::SampleCountFlagBits::e1);
 void uploadDataToImage(VulkanContext* context, VulkanImage* image, void* data, size_t size, u32 width, u32 height, vk::ImageLayout finalLayout, vk::AccessFlags dstAccessMask);
 void destroyImage(VulkanContext* context, VulkanImage* image);
+void transitionImageLayout(vk::CommandBuffer commandBuffer, vk::Image image, vk::ImageAspectFlags aspect, vk::ImageLayout oldLayout, vk::ImageLayout newLayout,
+							vk::PipelineStageFlags2 srcStage, vk::AccessFlags2 srcAccess, vk::PipelineStageFlags2 dstStage, vk::AccessFlags2 dstAccess);
 
 // make this easy accessable
 #include "vulkan_debug_labels.h"
\ No newline at end of file
@@ -0,0 +1,113 @@
+#include <algorithm>
+
+#include "utils.h"
+#include "vulkan_base.h"
+
+void createBindlessTable(VulkanContext* context, VulkanBindlessTable* table, u32 maxTextures, u32 maxSamplers) {
+    // Update after bind descriptors have their own limits, usually far above the regular ones
+    auto properties = VK(context->physicalDevice.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceVulkan12Properties>());
+    const auto& limits = properties.get<vk::PhysicalDeviceVulkan12Properties>();
+    table->maxTextures = std::min(maxTextures, limits.maxPerStageDescriptorUpdateAfterBindSampledImages);
+    table->maxSamplers = std::min(maxSamplers, limits.maxPerStageDescriptorUpdateAfterBindSamplers);
+
+    vk::DescriptorSetLayoutBinding bindings[] = {
+        { BINDLESS_TEXTURE_BINDING, vk::DescriptorType::eSampledImage, table->maxTextures, vk::ShaderStageFlagBits::eFragment, nullptr },
+        { BINDLESS_SAMPLER_BINDING, vk::DescriptorType::eSampler, table->maxSamplers, vk::ShaderStageFlagBits::eFragment, nullptr },
+    };
+
+    // Slots that were never written are fine as long as no shader reads them, and registering a texture
+    // doesn't disturb command buffers that are recorded or in flight with the set bound
+    vk::DescriptorBindingFlags flags = vk::DescriptorBindingFlagBits::ePartiallyBound | vk::DescriptorBindingFlagBits::eUpdateAfterBind | vk::DescriptorBindingFlagBits::eUpdateUnusedWhilePending;
+    vk::DescriptorBindingFlags bindingFlags[] = { flags, flags };
+
+    vk::DescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsCreateInfo {};
+    bindingFlagsCreateInfo.bindingCount = ARRAY_COUNT(bindingFlags);
+    bindingFlagsCreateInfo.pBindingFlags = bindingFlags;
+
+    vk::DescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo {};
+    descriptorSetLayoutCreateInfo.pNext = &bindingFlagsCreateInfo;
+    descriptorSetLayoutCreateInfo.flags = vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool;
+    descriptorSetLayoutCreateInfo.bindingCount = ARRAY_COUNT(bindings);
+    descriptorSetLayoutCreateInfo.pBindings = bindings;
+
+    table->descriptorSetLayout = VKA(context->device.createDescriptorSetLayout(descriptorSetLayoutCreateInfo));
+
+    vk::DescriptorPoolSize poolSizes[] = {
+        { vk::DescriptorType::eSampledImage, table->maxTextures },
+        { vk::DescriptorType::eSampler, table->maxSamplers },
+    };
+
+    vk::DescriptorPoolCreateInfo descriptorPoolCreateInfo {};
+    descriptorPoolCreateInfo.flags = vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind;
+    descriptorPoolCreateInfo.maxSets = 1;
+    descriptorPoolCreateInfo.poolSizeCount = ARRAY_COUNT(poolSizes);
+    descriptorPoolCreateInfo.pPoolSizes = poolSizes;
+
+    table->descriptorPool = VKA(context->device.createDescriptorPool(descriptorPoolCreateInfo));
+
+    vk::DescriptorSetAllocateInfo descriptorSetAllocateInfo {};
+    descriptorSetAllocateInfo.descriptorPool = table->descriptorPool;
+    descriptorSetAllocateInfo.descriptorSetCount = 1;
+    descriptorSetAllocateInfo.pSetLayouts = &table->descriptorSetLayout;
+
+    table->descriptorSet = VKA(context->device.allocateDescriptorSets(descriptorSetAllocateInfo)).front();
+
+    LOG_INFO("Bindless table: " + std::to_string(table->maxTextures) + " textures, " + std::to_string(table->maxSamplers) + " samplers");
+}
+
+u32 registerBindlessTexture(VulkanContext* context, VulkanBindlessTable* table, vk::ImageView imageView, vk::ImageLayout layout) {
+    u32 slot;
+    if (!table->freeTextureSlots.empty()) {
+        slot = table->freeTextureSlots.back();
+        table->freeTextureSlots.pop_back();
+    }
+    else {
+        assert(table->textureCount < table->maxTextures);
+        slot = table->textureCount++;
+    }
+
+    vk::DescriptorImageInfo descriptorImageInfo = { nullptr, imageView, layout };
+
+    vk::WriteDescriptorSet descriptorWrite;
+    descriptorWrite.dstSet = table->descriptorSet;
+    descriptorWrite.dstBinding = BINDLESS_TEXTURE_BINDING;
+    descriptorWrite.dstArrayElement = slot;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.descriptorType = vk::DescriptorType::eSampledImage;
+    descriptorWrite.pImageInfo = &descriptorImageInfo;
+
+    VK(context->device.updateDescriptorSets(1, &descriptorWrite, 0, nullptr));
+
+    return slot;
+}
+
+// The slot gets handed out again by the next registration, no frame in flight may still read it
+void releaseBindlessTexture(VulkanBindlessTable* table, u32 slot) {
+    assert(slot < table->textureCount);
+    table->freeTextureSlots.push_back(slot);
+}
+
+u32 registerBindlessSampler(VulkanContext* context, VulkanBindlessTable* table, vk::Sampler sampler) {
+    assert(table->samplerCount < table->maxSamplers);
+    u32 slot = table->samplerCount++;
+
+    vk::DescriptorImageInfo descriptorImageInfo = { sampler, nullptr, vk::ImageLayout::eUndefined };
+
+    vk::WriteDescriptorSet descriptorWrite;
+    descriptorWrite.dstSet = table->descriptorSet;
+    descriptorWrite.dstBinding = BINDLESS_SAMPLER_BINDING;
+    descriptorWrite.dstArrayElement = slot;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.descriptorType = vk::DescriptorType::eSampler;
+    descriptorWrite.pImageInfo = &descriptorImageInfo;
+
+    VK(context->device.updateDescriptorSets(1, &descriptorWrite, 0, nullptr));
+
+    return slot;
+}
+
+void destroyBindlessTable(VulkanContext* context, VulkanBindlessTable* table) {
+    VK(context->device.destroyDescriptorPool(table->descriptorPool));
+    VK(context->device.destroyDescriptorSetLayout(table->descriptorSetLayout));
+    *table = VulkanBindlessTable {};
+}
@@ -2,13 +2,24 @@
 
 #include <vulkan/vulkan.hpp>
 
+#include "types.h"
+
+// vulkan_profiler.cpp, only scopes on the command buffer of the frame that is profiled get timestamps
+u32 beginTimestampScope(vk::CommandBuffer commandBuffer, const char* name);
+void endTimestampScope(vk::CommandBuffer commandBuffer, u32 scope);
+
 struct commandLabelScope {
     vk::CommandBuffer commandBuffer;
-    commandLabelScope(vk::CommandBuffer c, const char* name) : commandBuffer(c) {
+    u32 timestampScope;
+    commandLabelScope(vk::CommandBuffer c, const char* name, bool timestamps = true) : commandBuffer(c) {
         vk::DebugUtilsLabelEXT label; label.pLabelName = name;
         commandBuffer.beginDebugUtilsLabelEXT(label);
+        timestampScope = timestamps ? beginTimestampScope(commandBuffer, name) : UINT32_MAX;
+    }
+    ~commandLabelScope(){
+        endTimestampScope(commandBuffer, timestampScope);
+        commandBuffer.endDebugUtilsLabelEXT();
     }
-    ~commandLabelScope(){ commandBuffer.endDebugUtilsLabelEXT(); }
 };
 
-#define SCOPE_LABEL(name) commandLabelScope scope(commandBuffer, name);
\ No newline at end of file
+#define SCOPE_LABEL(name) commandLabelScope scope(commandBuffer, name);
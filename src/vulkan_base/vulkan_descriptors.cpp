@@ -0,0 +1,131 @@
+#include "utils.h"
+#include "vulkan_base.h"
+
+void initDescriptorAllocator(VulkanDescriptorAllocator* allocator, u32 setsPerPool, const vk::DescriptorPoolSize* sizesPerSet, u32 sizeCount) {
+    allocator->setsPerPool = setsPerPool;
+    allocator->sizesPerSet.assign(sizesPerSet, sizesPerSet + sizeCount);
+}
+
+static vk::DescriptorPool getPool(VulkanContext* context, VulkanDescriptorAllocator* allocator) {
+    if (!allocator->freePools.empty()) {
+        vk::DescriptorPool pool = allocator->freePools.back();
+        allocator->freePools.pop_back();
+        return pool;
+    }
+
+    std::vector<vk::DescriptorPoolSize> poolSizes = allocator->sizesPerSet;
+    for (auto& poolSize : poolSizes) {
+        poolSize.descriptorCount *= allocator->setsPerPool;
+    }
+
+    vk::DescriptorPoolCreateInfo descriptorPoolCreateInfo {};
+    descriptorPoolCreateInfo.maxSets = allocator->setsPerPool;
+    descriptorPoolCreateInfo.poolSizeCount = static_cast<u32>(poolSizes.size());
+    descriptorPoolCreateInfo.pPoolSizes = poolSizes.data();
+
+    return VKA(context->device.createDescriptorPool(descriptorPoolCreateInfo));
+}
+
+vk::DescriptorSet allocateDescriptorSet(VulkanContext* context, VulkanDescriptorAllocator* allocator, vk::DescriptorSetLayout layout) {
+    if (!allocator->currentPool) {
+        allocator->currentPool = getPool(context, allocator);
+        allocator->usedPools.push_back(allocator->currentPool);
+    }
+
+    vk::DescriptorSetAllocateInfo descriptorSetAllocateInfo {};
+    descriptorSetAllocateInfo.descriptorPool = allocator->currentPool;
+    descriptorSetAllocateInfo.descriptorSetCount = 1;
+    descriptorSetAllocateInfo.pSetLayouts = &layout;
+
+    vk::DescriptorSet descriptorSet {};
+    vk::Result result = VK(context->device.allocateDescriptorSets(&descriptorSetAllocateInfo, &descriptorSet));
+    if (result == vk::Result::eErrorOutOfPoolMemory || result == vk::Result::eErrorFragmentedPool) {
+        // The full pool stays in use until the next reset, the set goes into a fresh one
+        allocator->currentPool = getPool(context, allocator);
+        allocator->usedPools.push_back(allocator->currentPool);
+
+        descriptorSetAllocateInfo.descriptorPool = allocator->currentPool;
+        result = VK(context->device.allocateDescriptorSets(&descriptorSetAllocateInfo, &descriptorSet));
+    }
+
+    if (result != vk::Result::eSuccess) {
+        LOG_ERROR("Descriptor set allocation failed: " + vk::to_string(result));
+        assert(false);
+    }
+
+    return descriptorSet;
+}
+
+// Frees every set of the allocator at once, the pools are kept for the next allocations
+void resetDescriptorAllocator(VulkanContext* context, VulkanDescriptorAllocator* allocator) {
+    for (auto& pool : allocator->usedPools) {
+        VK(context->device.resetDescriptorPool(pool));
+        allocator->freePools.push_back(pool);
+    }
+    allocator->usedPools.clear();
+    allocator->currentPool = nullptr;
+}
+
+void destroyDescriptorAllocator(VulkanContext* context, VulkanDescriptorAllocator* allocator) {
+    resetDescriptorAllocator(context, allocator);
+    for (auto& pool : allocator->freePools) {
+        VK(context->device.destroyDescriptorPool(pool));
+    }
+    allocator->freePools.clear();
+}
+
+vk::DescriptorSet getCachedDescriptorSet(VulkanContext* context, VulkanDescriptorCache* cache, vk::DescriptorSetLayout layout, const VulkanDescriptorWrite* writes, u32 writeCount) {
+    // Field by field, so padding between the members never ends up in the key
+    std::string key;
+    utils::appendKey(&key, layout);
+    for (u32 i = 0; i < writeCount; ++i) {
+        utils::appendKey(&key, writes[i].binding);
+        utils::appendKey(&key, writes[i].type);
+        utils::appendKey(&key, writes[i].image.sampler);
+        utils::appendKey(&key, writes[i].image.imageView);
+        utils::appendKey(&key, writes[i].image.imageLayout);
+        utils::appendKey(&key, writes[i].buffer.buffer);
+        utils::appendKey(&key, writes[i].buffer.offset);
+        utils::appendKey(&key, writes[i].buffer.range);
+    }
+
+    auto it = cache->sets.find(key);
+    if (it != cache->sets.end()) {
+        return it->second;
+    }
+
+    vk::DescriptorSet descriptorSet = allocateDescriptorSet(context, &cache->allocator, layout);
+
+    std::vector<vk::WriteDescriptorSet> descriptorWrites(writeCount);
+    for (u32 i = 0; i < writeCount; ++i) {
+        bool isBuffer = writes[i].type == vk::DescriptorType::eUniformBuffer || writes[i].type == vk::DescriptorType::eStorageBuffer
+                     || writes[i].type == vk::DescriptorType::eUniformBufferDynamic || writes[i].type == vk::DescriptorType::eStorageBufferDynamic;
+
+        descriptorWrites[i].dstSet = descriptorSet;
+        descriptorWrites[i].dstBinding = writes[i].binding;
+        descriptorWrites[i].descriptorCount = 1;
+        descriptorWrites[i].descriptorType = writes[i].type;
+        descriptorWrites[i].pImageInfo = isBuffer ? nullptr : &writes[i].image;
+        descriptorWrites[i].pBufferInfo = isBuffer ? &writes[i].buffer : nullptr;
+    }
+
+    VK(context->device.updateDescriptorSets(writeCount, descriptorWrites.data(), 0, nullptr));
+    cache->writeCount += writeCount;
+
+    cache->sets.emplace(std::move(key), descriptorSet);
+    return descriptorSet;
+}
+
+// Forgets every cached set right away, their pools are reset and handed out again once frames in flight are done with them
+void resetDescriptorCache(VulkanContext* context, VulkanDescriptorCache* cache) {
+    VulkanDescriptorAllocator* allocator = &cache->allocator;
+    deferDestruction(context, [context, allocator, pools = allocator->usedPools]() {
+        for (auto& pool : pools) {
+            VK(context->device.resetDescriptorPool(pool));
+            allocator->freePools.push_back(pool);
+        }
+    });
+    allocator->usedPools.clear();
+    allocator->currentPool = nullptr;
+    cache->sets.clear();
+}
@@ -1,6 +1,9 @@
 #define VULKAN_HPP_DISPATCH_LOADER_DYNAMIC 1
 #include <vulkan/vulkan.hpp>
 
+#include <algorithm>
+#include <cstring>
+
 #include "vulkan_base.h"
 
 #include "logger.h"
@@ -159,14 +162,190 @@ bool createLogicalDevice(VulkanContext* context, u32 deviceExtensionsCount, cons
 	queueCreateInfo.queueCount = 1;
 	queueCreateInfo.pQueuePriorities = queuePriorities;
 
-	vk::PhysicalDeviceFeatures enabledFeatures{};
+	const auto availableExtensions = VKA(context->physicalDevice.enumerateDeviceExtensionProperties());
+	auto isExtensionAvailable = [&](const char* extensionName) {
+		for (auto const& extension : availableExtensions) {
+			if (strcmp(extension.extensionName, extensionName) == 0) {
+				return true;
+			}
+		}
+		return false;
+	};
+
+	std::vector<const char*> enabledExtensions(deviceExtensions, deviceExtensions + deviceExtensionsCount);
+
+	// Query optional features
+	const bool isVulkan12 = context->physicalDeviceProperties.apiVersion >= VK_API_VERSION_1_2;
+	const bool isVulkan13 = context->physicalDeviceProperties.apiVersion >= VK_API_VERSION_1_3;
+	const bool hasLocalReadExtension = isExtensionAvailable(VK_KHR_DYNAMIC_RENDERING_LOCAL_READ_EXTENSION_NAME);
+	const bool hasExtendedDynamicState3Extension = isExtensionAvailable(VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME);
+	const bool hasPipelineLibraryExtension = isExtensionAvailable(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME) && isExtensionAvailable(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME);
+	const bool hasPushDescriptorExtension = isExtensionAvailable(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME);
+	// Headless devices are created without the swapchain extension, present wait depends on it
+	const bool hasSwapchainExtension = std::any_of(deviceExtensions, deviceExtensions + deviceExtensionsCount, [](const char* extensionName) {
+		return strcmp(extensionName, VK_KHR_SWAPCHAIN_EXTENSION_NAME) == 0;
+	});
+	const bool hasPresentWaitExtension = hasSwapchainExtension && isExtensionAvailable(VK_KHR_PRESENT_ID_EXTENSION_NAME) && isExtensionAvailable(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+
+	vk::PhysicalDeviceVulkan12Features supportedVulkan12Features{};
+	vk::PhysicalDeviceVulkan13Features supportedVulkan13Features{};
+	vk::PhysicalDeviceDynamicRenderingLocalReadFeaturesKHR supportedLocalReadFeatures{};
+	vk::PhysicalDeviceExtendedDynamicState3FeaturesEXT supportedExtendedDynamicState3Features{};
+	vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT supportedPipelineLibraryFeatures{};
+	vk::PhysicalDevicePresentIdFeaturesKHR supportedPresentIdFeatures{};
+	vk::PhysicalDevicePresentWaitFeaturesKHR supportedPresentWaitFeatures{};
+	vk::PhysicalDeviceFeatures2 supportedFeatures{};
+
+	auto chainSupportedFeatures = [&](auto& features) {
+		features.pNext = supportedFeatures.pNext;
+		supportedFeatures.pNext = &features;
+	};
+
+	if (isVulkan12) {
+		chainSupportedFeatures(supportedVulkan12Features);
+	}
+	if (isVulkan13) {
+		chainSupportedFeatures(supportedVulkan13Features);
+	}
+	if (hasLocalReadExtension) {
+		chainSupportedFeatures(supportedLocalReadFeatures);
+	}
+	if (hasExtendedDynamicState3Extension) {
+		chainSupportedFeatures(supportedExtendedDynamicState3Features);
+	}
+	if (hasPipelineLibraryExtension) {
+		chainSupportedFeatures(supportedPipelineLibraryFeatures);
+	}
+	if (hasPresentWaitExtension) {
+		chainSupportedFeatures(supportedPresentIdFeatures);
+		chainSupportedFeatures(supportedPresentWaitFeatures);
+	}
+	VK(context->physicalDevice.getFeatures2(&supportedFeatures));
+
+	// Enable optional features, every struct gets prepended to the pNext chain of enabledFeatures
+	vk::PhysicalDeviceVulkan12Features enabledVulkan12Features{};
+	vk::PhysicalDeviceVulkan13Features enabledVulkan13Features{};
+	vk::PhysicalDeviceDynamicRenderingLocalReadFeaturesKHR enabledLocalReadFeatures{};
+	vk::PhysicalDeviceExtendedDynamicState3FeaturesEXT enabledExtendedDynamicState3Features{};
+	vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT enabledPipelineLibraryFeatures{};
+	vk::PhysicalDevicePresentIdFeaturesKHR enabledPresentIdFeatures{};
+	vk::PhysicalDevicePresentWaitFeaturesKHR enabledPresentWaitFeatures{};
+	vk::PhysicalDeviceFeatures2 enabledFeatures{};
+
+	auto chainFeatures = [&](auto& features) {
+		features.pNext = enabledFeatures.pNext;
+		enabledFeatures.pNext = &features;
+	};
+
+	// Every submission signals the device timeline, there is no fallback to fences
+	if (!isVulkan12 || !supportedVulkan12Features.timelineSemaphore) {
+		LOG_ERROR("Timeline semaphores are not supported");
+		return false;
+	}
+	enabledVulkan12Features.timelineSemaphore = true;
+
+	// GPU-driven rendering writes its own draw commands and count, firstInstance of each command selects the instance
+	if (isVulkan12 && supportedVulkan12Features.drawIndirectCount && supportedFeatures.features.multiDrawIndirect
+		&& supportedFeatures.features.drawIndirectFirstInstance) {
+		enabledVulkan12Features.drawIndirectCount = true;
+		enabledFeatures.features.multiDrawIndirect = true;
+		enabledFeatures.features.drawIndirectFirstInstance = true;
+
+		context->features.drawIndirectCount = true;
+	}
+	// Bindless textures, partially bound arrays in one global set that is updated after binding. There is no non-bindless path
+	if (!isVulkan12 || !supportedVulkan12Features.descriptorIndexing || !supportedVulkan12Features.runtimeDescriptorArray
+		|| !supportedVulkan12Features.shaderSampledImageArrayNonUniformIndexing || !supportedVulkan12Features.descriptorBindingPartiallyBound
+		|| !supportedVulkan12Features.descriptorBindingSampledImageUpdateAfterBind || !supportedVulkan12Features.descriptorBindingUpdateUnusedWhilePending) {
+		LOG_ERROR("Descriptor indexing is not supported");
+		return false;
+	}
+	enabledVulkan12Features.descriptorIndexing = true;
+	enabledVulkan12Features.runtimeDescriptorArray = true;
+	enabledVulkan12Features.shaderSampledImageArrayNonUniformIndexing = true;
+	enabledVulkan12Features.descriptorBindingPartiallyBound = true;
+	enabledVulkan12Features.descriptorBindingSampledImageUpdateAfterBind = true;
+	enabledVulkan12Features.descriptorBindingUpdateUnusedWhilePending = true;
+	if (isVulkan12) {
+		chainFeatures(enabledVulkan12Features);
+	}
+
+	if (isVulkan13) {
+		enabledVulkan13Features.synchronization2 = supportedVulkan13Features.synchronization2;
+		enabledVulkan13Features.dynamicRendering = supportedVulkan13Features.dynamicRendering;
+		chainFeatures(enabledVulkan13Features);
+
+		context->features.synchronization2 = supportedVulkan13Features.synchronization2;
+		context->features.dynamicRendering = supportedVulkan13Features.dynamicRendering && supportedVulkan13Features.synchronization2;
+
+		// Extended dynamic state 1 and 2 are core in Vulkan 1.3 and don't need a feature bit
+		context->features.extendedDynamicState = true;
+		context->features.extendedDynamicState2 = true;
+	}
+
+	if (hasExtendedDynamicState3Extension && (supportedExtendedDynamicState3Features.extendedDynamicState3ColorBlendEnable || supportedExtendedDynamicState3Features.extendedDynamicState3RasterizationSamples)) {
+		enabledExtendedDynamicState3Features.extendedDynamicState3ColorBlendEnable = supportedExtendedDynamicState3Features.extendedDynamicState3ColorBlendEnable;
+		enabledExtendedDynamicState3Features.extendedDynamicState3RasterizationSamples = supportedExtendedDynamicState3Features.extendedDynamicState3RasterizationSamples;
+		chainFeatures(enabledExtendedDynamicState3Features);
+		enabledExtensions.push_back(VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME);
+
+		context->features.extendedDynamicState3BlendEnable = supportedExtendedDynamicState3Features.extendedDynamicState3ColorBlendEnable;
+		context->features.extendedDynamicState3SampleCount = supportedExtendedDynamicState3Features.extendedDynamicState3RasterizationSamples;
+	}
+
+	if (context->features.dynamicRendering && hasLocalReadExtension && supportedLocalReadFeatures.dynamicRenderingLocalRead) {
+		enabledLocalReadFeatures.dynamicRenderingLocalRead = true;
+		chainFeatures(enabledLocalReadFeatures);
+		enabledExtensions.push_back(VK_KHR_DYNAMIC_RENDERING_LOCAL_READ_EXTENSION_NAME);
+
+		context->features.dynamicRenderingLocalRead = true;
+	}
+
+	if (hasPipelineLibraryExtension && supportedPipelineLibraryFeatures.graphicsPipelineLibrary) {
+		enabledPipelineLibraryFeatures.graphicsPipelineLibrary = true;
+		chainFeatures(enabledPipelineLibraryFeatures);
+		enabledExtensions.push_back(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME);
+		enabledExtensions.push_back(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME);
+
+		context->features.graphicsPipelineLibrary = true;
+
+		auto properties = VK(context->physicalDevice.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceGraphicsPipelineLibraryPropertiesEXT>());
+		auto pipelineLibraryProperties = properties.get<vk::PhysicalDeviceGraphicsPipelineLibraryPropertiesEXT>();
+		LOG_INFO("Graphics pipeline library fast linking: " + std::string{ pipelineLibraryProperties.graphicsPipelineLibraryFastLinking ? "true" : "false" });
+	}
+
+	// The extension has no feature bit, being available is enough
+	if (hasPushDescriptorExtension) {
+		enabledExtensions.push_back(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME);
+
+		context->features.pushDescriptor = true;
+	}
+
+	// Present ids tag every present, present wait then blocks until a tagged frame is on screen
+	if (hasPresentWaitExtension && supportedPresentIdFeatures.presentId && supportedPresentWaitFeatures.presentWait) {
+		enabledPresentIdFeatures.presentId = true;
+		enabledPresentWaitFeatures.presentWait = true;
+		chainFeatures(enabledPresentIdFeatures);
+		chainFeatures(enabledPresentWaitFeatures);
+		enabledExtensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+		enabledExtensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+
+		context->features.presentWait = true;
+	}
+
+	LOG_INFO("Dynamic rendering: " + std::string{ context->features.dynamicRendering ? "true" : "false" } + " | local read: " + std::string{ context->features.dynamicRenderingLocalRead ? "true" : "false" });
+	LOG_INFO("Draw indirect count: " + std::string{ context->features.drawIndirectCount ? "true" : "false" });
+	LOG_INFO("Push descriptors: " + std::string{ context->features.pushDescriptor ? "true" : "false" });
+	LOG_INFO("Present wait: " + std::string{ context->features.presentWait ? "true" : "false" });
+	LOG_INFO("Extended dynamic state: " + std::string{ context->features.extendedDynamicState ? "1 " : "" } + std::string{ context->features.extendedDynamicState2 ? "2 " : "" }
+		+ std::string{ context->features.extendedDynamicState3BlendEnable || context->features.extendedDynamicState3SampleCount ? "3" : "" });
 
 	vk::DeviceCreateInfo createInfo{};
+	createInfo.pNext = &enabledFeatures;
 	createInfo.queueCreateInfoCount = 1;
 	createInfo.pQueueCreateInfos = &queueCreateInfo;
-	createInfo.enabledExtensionCount = deviceExtensionsCount;
-	createInfo.ppEnabledExtensionNames = deviceExtensions;
-	createInfo.pEnabledFeatures = &enabledFeatures;
+	createInfo.enabledExtensionCount = static_cast<u32>(enabledExtensions.size());
+	createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
 	try {
 		context->device = context->physicalDevice.createDevice(createInfo);
@@ -181,6 +360,8 @@ bool createLogicalDevice(VulkanContext* context, u32 deviceExtensionsCount, cons
 	context->graphicsQueue.familyIndex = graphicsQueueIndex;
 	context->graphicsQueue.queue = context->device.getQueue(graphicsQueueIndex, 0);
 
+	createTimeline(context);
+
 	vk::PhysicalDeviceMemoryProperties deviceMemoryProperties = VK(context->physicalDevice.getMemoryProperties());
 	LOG_INFO("Num device memory heaps: " + std::to_string(deviceMemoryProperties.memoryHeapCount));
 	for (u32 i = 0; i < deviceMemoryProperties.memoryHeapCount; ++i) {
@@ -220,6 +401,7 @@ bool initVulkan(VulkanContext* context, u32 instanceExtensionsCount, const char*
 
 void exitVulkan(VulkanContext* context) {
 	VKA(context->device.waitIdle());
+	destroyTimeline(context);
 	VKA(context->device.destroy());
 
 #ifdef DEBUG_BUILD
@@ -1,9 +1,13 @@
+#include <cstring>
 #include <filesystem>
 
 #include "utils.h"
+#include "job_system.h"
+#include "shader_registry.h"
 #include "vulkan_base.h"
 
-vk::ShaderModule createShaderModule(VulkanContext* context, const std::string shaderFilename) {
+// Loads the shader from disk instead of the embedded registry, only used during development
+static vk::ShaderModule loadShaderModule(VulkanContext* context, const std::string shaderFilename) {
     vk::ShaderModule resultShaderModule {};
 
     if (!std::filesystem::exists(shaderFilename)) {
@@ -31,20 +35,205 @@ vk::ShaderModule createShaderModule(VulkanContext* context, const std::string sh
     return resultShaderModule;
 }
 
+vk::ShaderModule createShaderModule(VulkanContext* context, const char* shaderFilename) {
+    const EmbeddedShader* shader = context->loadShadersFromDisk ? nullptr : findEmbeddedShader(shaderFilename);
+    if (!shader) {
+        return loadShaderModule(context, shaderFilename);
+    }
+
+    vk::ShaderModuleCreateInfo shaderCreateInfo {};
+    shaderCreateInfo.codeSize = shader->size;
+    shaderCreateInfo.pCode = shader->code;
+
+    return VKA(context->device.createShaderModule(shaderCreateInfo));
+}
+
+static vk::Pipeline getPipelineLibrary(VulkanContext* context, VulkanPipelineLibraryCache* cache, const std::string& key, vk::GraphicsPipelineLibraryFlagsEXT libraryFlags,
+                                        vk::GraphicsPipelineCreateInfo pipelineCreateInfo, const vk::PipelineRenderingCreateInfo* renderingInfo) {
+    auto it = cache->libraries.find(key);
+    if (it != cache->libraries.end()) {
+        return it->second;
+    }
+
+    vk::GraphicsPipelineLibraryCreateInfoEXT libraryCreateInfo {};
+    libraryCreateInfo.flags = libraryFlags;
+
+    vk::PipelineRenderingCreateInfo rendering {};
+    if (renderingInfo) {
+        rendering = *renderingInfo;
+        rendering.pNext = nullptr;
+        libraryCreateInfo.pNext = &rendering;
+    }
+
+    pipelineCreateInfo.pNext = &libraryCreateInfo;
+    pipelineCreateInfo.flags |= vk::PipelineCreateFlagBits::eLibraryKHR | vk::PipelineCreateFlagBits::eRetainLinkTimeOptimizationInfoEXT;
+
+    vk::Pipeline library = VKA(context->device.createGraphicsPipeline(nullptr, pipelineCreateInfo)).value;
+    cache->libraries.emplace(key, library);
+
+    return library;
+}
+
+// Libraries outlive the pipelines they were first created for, so they use a layout owned by the cache. It is identical to the pipeline's own layout
+static vk::PipelineLayout getLibraryPipelineLayout(VulkanContext* context, VulkanPipelineLibraryCache* cache, const std::string& key,
+                                                    const vk::PipelineLayoutCreateInfo* layoutCreateInfo) {
+    auto it = cache->layouts.find(key);
+    if (it != cache->layouts.end()) {
+        return it->second;
+    }
+
+    vk::PipelineLayout layout = VKA(context->device.createPipelineLayout(*layoutCreateInfo));
+    cache->layouts.emplace(key, layout);
+
+    return layout;
+}
+
+// Builds the four library parts of a pipeline, each part is only compiled once and reused by every pipeline with the same inputs
+static void createPipelineLibraries(VulkanContext* context, VulkanPipelineLibraryCache* cache, VulkanPipeline* pipeline, const char* vertexShaderFilename,
+                                    const char* fragmentShaderFilename, vk::PipelineShaderStageCreateInfo* shaderStages,
+                                    const vk::PipelineVertexInputStateCreateInfo* vertexInputState, const vk::PipelineInputAssemblyStateCreateInfo* inputAssemblyState,
+                                    const vk::PipelineViewportStateCreateInfo* viewportState, const vk::PipelineRasterizationStateCreateInfo* rasterizationState,
+                                    const vk::PipelineMultisampleStateCreateInfo* multisampleState, const vk::PipelineDepthStencilStateCreateInfo* depthStencilState,
+                                    const vk::PipelineColorBlendStateCreateInfo* colorBlendState, const vk::PipelineDynamicStateCreateInfo* dynamicState,
+                                    const vk::PipelineLayoutCreateInfo* layoutCreateInfo, VkRenderPass renderPass, u32 subpassIndex,
+                                    const vk::PipelineRenderingCreateInfo* renderingInfo) {
+    std::string dynamicKey;
+    utils::appendKey(&dynamicKey, dynamicState->dynamicStateCount);
+    utils::appendKey(&dynamicKey, dynamicState->pDynamicStates, dynamicState->dynamicStateCount * sizeof(vk::DynamicState));
+
+    std::string layoutKey;
+    utils::appendKey(&layoutKey, layoutCreateInfo->setLayoutCount);
+    utils::appendKey(&layoutKey, layoutCreateInfo->pSetLayouts, layoutCreateInfo->setLayoutCount * sizeof(vk::DescriptorSetLayout));
+    utils::appendKey(&layoutKey, layoutCreateInfo->pushConstantRangeCount);
+    utils::appendKey(&layoutKey, layoutCreateInfo->pPushConstantRanges, layoutCreateInfo->pushConstantRangeCount * sizeof(vk::PushConstantRange));
+
+    std::string renderKey;
+    if (renderingInfo) {
+        utils::appendKey(&renderKey, renderingInfo->colorAttachmentCount);
+        utils::appendKey(&renderKey, renderingInfo->pColorAttachmentFormats, renderingInfo->colorAttachmentCount * sizeof(vk::Format));
+        utils::appendKey(&renderKey, renderingInfo->depthAttachmentFormat);
+        utils::appendKey(&renderKey, renderingInfo->viewMask);
+    }
+    else {
+        utils::appendKey(&renderKey, renderPass);
+        utils::appendKey(&renderKey, subpassIndex);
+    }
+
+    vk::GraphicsPipelineCreateInfo baseCreateInfo {};
+    baseCreateInfo.pDynamicState = dynamicState;
+    baseCreateInfo.layout = getLibraryPipelineLayout(context, cache, layoutKey, layoutCreateInfo);
+    if (!renderingInfo) {
+        baseCreateInfo.renderPass = renderPass;
+        baseCreateInfo.subpass = subpassIndex;
+    }
+
+    // Vertex input interface
+    {
+        std::string key = dynamicKey;
+        utils::appendKey(&key, u8(0));
+        utils::appendKey(&key, vertexInputState->vertexBindingDescriptionCount);
+        utils::appendKey(&key, vertexInputState->pVertexBindingDescriptions, vertexInputState->vertexBindingDescriptionCount * sizeof(vk::VertexInputBindingDescription));
+        utils::appendKey(&key, vertexInputState->vertexAttributeDescriptionCount);
+        utils::appendKey(&key, vertexInputState->pVertexAttributeDescriptions, vertexInputState->vertexAttributeDescriptionCount * sizeof(vk::VertexInputAttributeDescription));
+        utils::appendKey(&key, inputAssemblyState->topology);
+
+        vk::GraphicsPipelineCreateInfo pipelineCreateInfo {};
+        pipelineCreateInfo.pVertexInputState = vertexInputState;
+        pipelineCreateInfo.pInputAssemblyState = inputAssemblyState;
+        pipelineCreateInfo.pDynamicState = dynamicState;
+
+        pipeline->libraries[0] = getPipelineLibrary(context, cache, key, vk::GraphicsPipelineLibraryFlagBitsEXT::eVertexInputInterface, pipelineCreateInfo, nullptr);
+    }
+
+    // Pre-rasterization shaders
+    {
+        std::string key = dynamicKey + layoutKey + renderKey;
+        utils::appendKey(&key, u8(1));
+        utils::appendKey(&key, vertexShaderFilename, strlen(vertexShaderFilename) + 1);
+        utils::appendKey(&key, rasterizationState->cullMode);
+        utils::appendKey(&key, rasterizationState->frontFace);
+        utils::appendKey(&key, rasterizationState->depthBiasEnable);
+
+        if (!cache->libraries.contains(key)) {
+            shaderStages[0].module = createShaderModule(context, vertexShaderFilename);
+        }
+
+        vk::GraphicsPipelineCreateInfo pipelineCreateInfo = baseCreateInfo;
+        pipelineCreateInfo.stageCount = 1;
+        pipelineCreateInfo.pStages = &shaderStages[0];
+        pipelineCreateInfo.pViewportState = viewportState;
+        pipelineCreateInfo.pRasterizationState = rasterizationState;
+
+        pipeline->libraries[1] = getPipelineLibrary(context, cache, key, vk::GraphicsPipelineLibraryFlagBitsEXT::ePreRasterizationShaders, pipelineCreateInfo, renderingInfo);
+
+        if (shaderStages[0].module) {
+            VK(context->device.destroyShaderModule(shaderStages[0].module));
+            shaderStages[0].module = nullptr;
+        }
+    }
+
+    // Fragment shader
+    {
+        std::string key = dynamicKey + layoutKey + renderKey;
+        utils::appendKey(&key, u8(2));
+        utils::appendKey(&key, fragmentShaderFilename, strlen(fragmentShaderFilename) + 1);
+        utils::appendKey(&key, depthStencilState->depthTestEnable);
+        utils::appendKey(&key, depthStencilState->depthWriteEnable);
+        utils::appendKey(&key, depthStencilState->depthCompareOp);
+        utils::appendKey(&key, multisampleState->rasterizationSamples);
+
+        if (!cache->libraries.contains(key)) {
+            shaderStages[1].module = createShaderModule(context, fragmentShaderFilename);
+        }
+
+        vk::GraphicsPipelineCreateInfo pipelineCreateInfo = baseCreateInfo;
+        pipelineCreateInfo.stageCount = 1;
+        pipelineCreateInfo.pStages = &shaderStages[1];
+        pipelineCreateInfo.pDepthStencilState = depthStencilState;
+        pipelineCreateInfo.pMultisampleState = multisampleState;
+
+        pipeline->libraries[2] = getPipelineLibrary(context, cache, key, vk::GraphicsPipelineLibraryFlagBitsEXT::eFragmentShader, pipelineCreateInfo, renderingInfo);
+
+        if (shaderStages[1].module) {
+            VK(context->device.destroyShaderModule(shaderStages[1].module));
+            shaderStages[1].module = nullptr;
+        }
+    }
+
+    // Fragment output interface
+    {
+        std::string key = dynamicKey + renderKey;
+        utils::appendKey(&key, u8(3));
+        utils::appendKey(&key, colorBlendState->attachmentCount);
+        utils::appendKey(&key, colorBlendState->pAttachments, colorBlendState->attachmentCount * sizeof(vk::PipelineColorBlendAttachmentState));
+        utils::appendKey(&key, multisampleState->rasterizationSamples);
+
+        vk::GraphicsPipelineCreateInfo pipelineCreateInfo = baseCreateInfo;
+        pipelineCreateInfo.layout = nullptr;
+        pipelineCreateInfo.pColorBlendState = colorBlendState;
+        pipelineCreateInfo.pMultisampleState = multisampleState;
+
+        pipeline->libraries[3] = getPipelineLibrary(context, cache, key, vk::GraphicsPipelineLibraryFlagBitsEXT::eFragmentOutputInterface, pipelineCreateInfo, renderingInfo);
+    }
+}
+
 VulkanPipeline createPipeline(VulkanContext* context, const char* vertexShaderFilename, const char* fragmentShaderFilename,
                                 VkRenderPass renderPass, u32 width, u32 height, vk::VertexInputAttributeDescription* attributes,
                                 u32 numAttributes, vk::VertexInputBindingDescription* binding, u32 numSetLayout, vk::DescriptorSetLayout* setLayouts,
-                                vk::PushConstantRange* pushConstant, u32 subpassIndex, vk::SampleCountFlagBits sampleCount) {
-
-    vk::ShaderModule vertexShaderModule { createShaderModule(context, vertexShaderFilename )};
-    vk::ShaderModule fragmentShaderModule { createShaderModule(context, fragmentShaderFilename )};
+                                vk::PushConstantRange* pushConstant, u32 subpassIndex, vk::SampleCountFlagBits sampleCount,
+                                const vk::PipelineRenderingCreateInfo* renderingInfo, const VulkanPipelineState* state, bool dynamicState,
+                                VulkanPipelineLibraryCache* libraryCache) {
+    PROFILE_FUNCTION();
+    VulkanPipelineState bakedState {};
+    bakedState.sampleCount = sampleCount;
+    if (state) {
+        bakedState = *state;
+    }
 
     vk::PipelineShaderStageCreateInfo shaderStages[2];
-    shaderStages[0].module = vertexShaderModule;
     shaderStages[0].stage = vk::ShaderStageFlagBits::eVertex;
     shaderStages[0].pName = "main";
 
-    shaderStages[1].module = fragmentShaderModule;
     shaderStages[1].stage = vk::ShaderStageFlagBits::eFragment;
     shaderStages[1].pName = "main";
 
@@ -63,13 +252,16 @@ VulkanPipeline createPipeline(VulkanContext* context, const char* vertexShaderFi
 
     vk::PipelineRasterizationStateCreateInfo rasterizationStateCreateInfo {};
     rasterizationStateCreateInfo.lineWidth = 1.0f;
+    rasterizationStateCreateInfo.cullMode = bakedState.cullMode;
+    rasterizationStateCreateInfo.frontFace = bakedState.frontFace;
+    rasterizationStateCreateInfo.depthBiasEnable = bakedState.depthBiasEnable;
 
     vk::PipelineMultisampleStateCreateInfo multisampleStateCreateInfo {};
-    multisampleStateCreateInfo.rasterizationSamples = sampleCount;
+    multisampleStateCreateInfo.rasterizationSamples = bakedState.sampleCount;
 
     vk::PipelineColorBlendAttachmentState colorBlendAttachmentState {};
     colorBlendAttachmentState.colorWriteMask = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA;
-    colorBlendAttachmentState.blendEnable = true;
+    colorBlendAttachmentState.blendEnable = bakedState.blendEnable;
     colorBlendAttachmentState.srcColorBlendFactor = vk::BlendFactor::eSrcAlpha;
     colorBlendAttachmentState.dstColorBlendFactor = vk::BlendFactor::eOneMinusSrcAlpha;
     colorBlendAttachmentState.colorBlendOp = vk::BlendOp::eAdd;
@@ -78,9 +270,9 @@ VulkanPipeline createPipeline(VulkanContext* context, const char* vertexShaderFi
     colorBlendAttachmentState.alphaBlendOp = vk::BlendOp::eAdd;
 
     vk::PipelineDepthStencilStateCreateInfo depthStencilStateCreateInfo {};
-    depthStencilStateCreateInfo.depthTestEnable = true;
-    depthStencilStateCreateInfo.depthWriteEnable = true;
-    depthStencilStateCreateInfo.depthCompareOp = vk::CompareOp::eGreaterOrEqual;
+    depthStencilStateCreateInfo.depthTestEnable = bakedState.depthTestEnable;
+    depthStencilStateCreateInfo.depthWriteEnable = bakedState.depthWriteEnable;
+    depthStencilStateCreateInfo.depthCompareOp = bakedState.depthCompareOp;
     depthStencilStateCreateInfo.minDepthBounds = 0.0f;
     depthStencilStateCreateInfo.maxDepthBounds = 1.0f;
 
@@ -96,11 +288,49 @@ VulkanPipeline createPipeline(VulkanContext* context, const char* vertexShaderFi
 
     vk::PipelineLayout pipelineLayout = VKA(context->device.createPipelineLayout(layoutCreateInfo));
 
-    vk::DynamicState dynamicStates[] = {vk::DynamicState::eViewport, vk::DynamicState::eScissor};
+    VulkanPipeline pipeline {};
+
+    std::vector<vk::DynamicState> dynamicStates = {vk::DynamicState::eViewport, vk::DynamicState::eScissor};
+    if (dynamicState) {
+        if (context->features.extendedDynamicState) {
+            dynamicStates.insert(dynamicStates.end(), { vk::DynamicState::eCullMode, vk::DynamicState::eFrontFace, vk::DynamicState::eDepthTestEnable,
+                                                        vk::DynamicState::eDepthWriteEnable, vk::DynamicState::eDepthCompareOp });
+            pipeline.dynamicDepthCull = true;
+        }
+        if (context->features.extendedDynamicState2) {
+            dynamicStates.push_back(vk::DynamicState::eDepthBiasEnable);
+            pipeline.dynamicDepthBias = true;
+        }
+        if (context->features.extendedDynamicState3BlendEnable) {
+            dynamicStates.push_back(vk::DynamicState::eColorBlendEnableEXT);
+            pipeline.dynamicBlendEnable = true;
+        }
+        if (context->features.extendedDynamicState3SampleCount) {
+            dynamicStates.push_back(vk::DynamicState::eRasterizationSamplesEXT);
+            pipeline.dynamicSampleCount = true;
+        }
+    }
 
     vk::PipelineDynamicStateCreateInfo dynamicStateCreateInfo {};
-    dynamicStateCreateInfo.dynamicStateCount = ARRAY_COUNT(dynamicStates);
-    dynamicStateCreateInfo.pDynamicStates = dynamicStates;
+    dynamicStateCreateInfo.dynamicStateCount = static_cast<u32>(dynamicStates.size());
+    dynamicStateCreateInfo.pDynamicStates = dynamicStates.data();
+
+    pipeline.pipelineLayout = pipelineLayout;
+
+    if (libraryCache && context->features.graphicsPipelineLibrary) {
+        createPipelineLibraries(context, libraryCache, &pipeline, vertexShaderFilename, fragmentShaderFilename, shaderStages, &vertexInputStateCreateInfo,
+                                &inputAssemblyStateCreateInfo, &viewportStateCreateInfo, &rasterizationStateCreateInfo, &multisampleStateCreateInfo,
+                                &depthStencilStateCreateInfo, &colorBlendStateCreateInfo, &dynamicStateCreateInfo, &layoutCreateInfo,
+                                renderPass, subpassIndex, renderingInfo);
+
+        pipeline.pipeline = linkPipelineLibraries(context, &pipeline, false);
+        pipeline.fastLinked = true;
+
+        return pipeline;
+    }
+
+    shaderStages[0].module = createShaderModule(context, vertexShaderFilename);
+    shaderStages[1].module = createShaderModule(context, fragmentShaderFilename);
 
     vk::GraphicsPipelineCreateInfo pipelineCreateInfo {};
     pipelineCreateInfo.stageCount = ARRAY_COUNT(shaderStages);
@@ -114,23 +344,218 @@ VulkanPipeline createPipeline(VulkanContext* context, const char* vertexShaderFi
     pipelineCreateInfo.pColorBlendState = &colorBlendStateCreateInfo;
     pipelineCreateInfo.pDynamicState = &dynamicStateCreateInfo;
     pipelineCreateInfo.layout = pipelineLayout;
-    pipelineCreateInfo.renderPass = renderPass;
-    pipelineCreateInfo.subpass = subpassIndex;
+    if (renderingInfo) {
+        // Dynamic rendering: the pipeline only depends on the attachment formats
+        pipelineCreateInfo.pNext = renderingInfo;
+        pipelineCreateInfo.renderPass = nullptr;
+        pipelineCreateInfo.subpass = 0;
+    }
+    else {
+        pipelineCreateInfo.renderPass = renderPass;
+        pipelineCreateInfo.subpass = subpassIndex;
+    }
 
     auto result = VKA(context->device.createGraphicsPipelines(nullptr, pipelineCreateInfo));
     std::vector<vk::Pipeline> pipelines = std::move(result.value);
 
-    VK(context->device.destroyShaderModule(fragmentShaderModule));
-    VK(context->device.destroyShaderModule(vertexShaderModule));
+    VK(context->device.destroyShaderModule(shaderStages[1].module));
+    VK(context->device.destroyShaderModule(shaderStages[0].module));
 
-    VulkanPipeline pipeline {};
     pipeline.pipeline = pipelines.front();
-    pipeline.pipelineLayout = pipelineLayout;
 
     return pipeline;
 }
 
+VulkanPipeline createComputePipeline(VulkanContext* context, const char* shaderFilename, u32 numSetLayout, vk::DescriptorSetLayout* setLayouts,
+                                     vk::PushConstantRange* pushConstant) {
+    PROFILE_FUNCTION();
+    vk::PipelineLayoutCreateInfo layoutCreateInfo {};
+    layoutCreateInfo.setLayoutCount = numSetLayout;
+    layoutCreateInfo.pSetLayouts = setLayouts;
+    layoutCreateInfo.pushConstantRangeCount = pushConstant ? 1 : 0;
+    layoutCreateInfo.pPushConstantRanges = pushConstant;
+
+    VulkanPipeline pipeline {};
+    pipeline.pipelineLayout = VKA(context->device.createPipelineLayout(layoutCreateInfo));
+
+    vk::ComputePipelineCreateInfo pipelineCreateInfo {};
+    pipelineCreateInfo.stage.stage = vk::ShaderStageFlagBits::eCompute;
+    pipelineCreateInfo.stage.module = createShaderModule(context, shaderFilename);
+    pipelineCreateInfo.stage.pName = "main";
+    pipelineCreateInfo.layout = pipeline.pipelineLayout;
+
+    pipeline.pipeline = VKA(context->device.createComputePipeline(nullptr, pipelineCreateInfo)).value;
+
+    VK(context->device.destroyShaderModule(pipelineCreateInfo.stage.module));
+
+    return pipeline;
+}
+
+vk::Pipeline linkPipelineLibraries(VulkanContext* context, const VulkanPipeline* pipeline, bool optimize) {
+    vk::PipelineLibraryCreateInfoKHR libraryCreateInfo {};
+    libraryCreateInfo.libraryCount = ARRAY_COUNT(pipeline->libraries);
+    libraryCreateInfo.pLibraries = pipeline->libraries;
+
+    vk::GraphicsPipelineCreateInfo pipelineCreateInfo {};
+    pipelineCreateInfo.pNext = &libraryCreateInfo;
+    pipelineCreateInfo.layout = pipeline->pipelineLayout;
+    if (optimize) {
+        pipelineCreateInfo.flags = vk::PipelineCreateFlagBits::eLinkTimeOptimizationEXT;
+    }
+
+    return VKA(context->device.createGraphicsPipeline(nullptr, pipelineCreateInfo)).value;
+}
+
+void destroyPipelineLibraryCache(VulkanContext* context, VulkanPipelineLibraryCache* cache) {
+    std::vector<vk::Pipeline> libraries;
+    for (auto& [key, library] : cache->libraries) {
+        libraries.push_back(library);
+    }
+    cache->libraries.clear();
+
+    std::vector<vk::PipelineLayout> layouts;
+    for (auto& [key, layout] : cache->layouts) {
+        layouts.push_back(layout);
+    }
+    cache->layouts.clear();
+
+    deferDestruction(context, [context, libraries, layouts]() {
+        for (auto& library : libraries) {
+            VK(context->device.destroyPipeline(library));
+        }
+        for (auto& layout : layouts) {
+            VK(context->device.destroyPipelineLayout(layout));
+        }
+    });
+}
+
+// Command buffers in flight may still bind the pipeline, it is destroyed once the timeline passed them
 void destroyPipeline(VulkanContext* context, VulkanPipeline* pipeline) {
-    VK(context->device.destroyPipeline(pipeline->pipeline));
-    VK(context->device.destroyPipelineLayout(pipeline->pipelineLayout));
+    deferDestruction(context, [context, handle = pipeline->pipeline, layout = pipeline->pipelineLayout]() {
+        VK(context->device.destroyPipeline(handle));
+        VK(context->device.destroyPipelineLayout(layout));
+    });
+    pipeline->pipeline = nullptr;
+    pipeline->pipelineLayout = nullptr;
+}
+
+void setPipelineState(vk::CommandBuffer commandBuffer, const VulkanPipeline* pipeline, const VulkanPipelineState& state) {
+    if (pipeline->dynamicDepthCull) {
+        VK(commandBuffer.setCullMode(state.cullMode));
+        VK(commandBuffer.setFrontFace(state.frontFace));
+        VK(commandBuffer.setDepthTestEnable(state.depthTestEnable));
+        VK(commandBuffer.setDepthWriteEnable(state.depthWriteEnable));
+        VK(commandBuffer.setDepthCompareOp(state.depthCompareOp));
+    }
+    if (pipeline->dynamicDepthBias) {
+        VK(commandBuffer.setDepthBiasEnable(state.depthBiasEnable));
+    }
+    if (pipeline->dynamicBlendEnable) {
+        vk::Bool32 blendEnable = state.blendEnable;
+        VK(commandBuffer.setColorBlendEnableEXT(0, 1, &blendEnable));
+    }
+    if (pipeline->dynamicSampleCount) {
+        VK(commandBuffer.setRasterizationSamplesEXT(state.sampleCount));
+    }
+}
+
+static u64 getPipelineStateKey(const VulkanPipelineState& state) {
+    u64 key = static_cast<u64>(static_cast<u32>(state.cullMode));
+    key |= static_cast<u64>(state.frontFace) << 2;
+    key |= static_cast<u64>(state.depthTestEnable) << 3;
+    key |= static_cast<u64>(state.depthWriteEnable) << 4;
+    key |= static_cast<u64>(state.depthCompareOp) << 5;
+    key |= static_cast<u64>(state.depthBiasEnable) << 8;
+    key |= static_cast<u64>(state.blendEnable) << 9;
+    key |= static_cast<u64>(state.sampleCount) << 10;
+    return key;
+}
+
+// Resets everything the device can set dynamically, so states that only differ there share a pipeline
+static VulkanPipelineState getBakedPipelineState(VulkanContext* context, VulkanPipelineState state) {
+    const VulkanPipelineState defaults {};
+    if (context->features.extendedDynamicState) {
+        state.cullMode = defaults.cullMode;
+        state.frontFace = defaults.frontFace;
+        state.depthTestEnable = defaults.depthTestEnable;
+        state.depthWriteEnable = defaults.depthWriteEnable;
+        state.depthCompareOp = defaults.depthCompareOp;
+    }
+    if (context->features.extendedDynamicState2) {
+        state.depthBiasEnable = defaults.depthBiasEnable;
+    }
+    if (context->features.extendedDynamicState3BlendEnable) {
+        state.blendEnable = defaults.blendEnable;
+    }
+    if (context->features.extendedDynamicState3SampleCount) {
+        state.sampleCount = defaults.sampleCount;
+    }
+    return state;
+}
+
+VulkanPipeline* getPipelineVariant(VulkanContext* context, VulkanPipelineVariants* variants, const VulkanPipelineState& state) {
+    {
+        // The fast-linked pipeline might still be used by frames in flight, it is destroyed once they are done
+        std::lock_guard lock(variants->mutex);
+        for (auto& [key, optimizedPipeline] : variants->optimizedPipelines) {
+            VulkanPipeline& pipeline = variants->pipelines[key];
+            deferDestruction(context, [context, retiredPipeline = pipeline.pipeline]() {
+                VK(context->device.destroyPipeline(retiredPipeline));
+            });
+            pipeline.pipeline = optimizedPipeline;
+            pipeline.fastLinked = false;
+        }
+        variants->optimizedPipelines.clear();
+    }
+
+    u64 pipelineKey = getPipelineStateKey(variants->dynamicState ? getBakedPipelineState(context, state) : state);
+
+    auto it = variants->pipelines.find(pipelineKey);
+    if (it == variants->pipelines.end()) {
+        VulkanPipeline pipeline = variants->create(&state, variants->dynamicState);
+        it = variants->pipelines.emplace(pipelineKey, pipeline).first;
+
+        if (pipeline.fastLinked && variants->backgroundJobs) {
+            {
+                std::lock_guard lock(variants->mutex);
+                variants->pendingLinks++;
+            }
+            variants->backgroundJobs->submit([context, variants, pipelineKey, pipeline]() {
+                vk::Pipeline optimizedPipeline = linkPipelineLibraries(context, &pipeline, true);
+
+                std::lock_guard lock(variants->mutex);
+                variants->optimizedPipelines.emplace_back(pipelineKey, optimizedPipeline);
+                variants->pendingLinks--;
+                variants->linksFinished.notify_all();
+            });
+        }
+    }
+
+    if (variants->requestedStates.insert(getPipelineStateKey(state)).second) {
+        variants->permutationsAvoided = static_cast<u32>(variants->requestedStates.size() - variants->pipelines.size());
+        LOG_DEBUG("Pipeline state permutations: " + std::to_string(variants->requestedStates.size()) + " | pipelines: " + std::to_string(variants->pipelines.size())
+                    + " | avoided: " + std::to_string(variants->permutationsAvoided));
+    }
+
+    return &it->second;
+}
+
+void destroyPipelineVariants(VulkanContext* context, VulkanPipelineVariants* variants) {
+    // Only waits for the links of these variants, other jobs on the same pool keep running
+    {
+        std::unique_lock lock(variants->mutex);
+        variants->linksFinished.wait(lock, [variants]() { return variants->pendingLinks == 0; });
+    }
+
+    for (auto& [key, optimizedPipeline] : variants->optimizedPipelines) {
+        VK(context->device.destroyPipeline(optimizedPipeline));
+    }
+    variants->optimizedPipelines.clear();
+
+    for (auto& [key, pipeline] : variants->pipelines) {
+        destroyPipeline(context, &pipeline);
+    }
+    variants->pipelines.clear();
+    variants->requestedStates.clear();
+    variants->permutationsAvoided = 0;
 }
@@ -0,0 +1,156 @@
+#include <algorithm>
+
+#include "vulkan_base.h"
+
+// The profiler of the frame that is being recorded, label scopes don't know about it otherwise
+static VulkanGpuProfiler* recordingProfiler = nullptr;
+
+void createGpuProfiler(VulkanContext* context, VulkanGpuProfiler* profiler, u32 frameCount) {
+    auto queueFamilies = VK(context->physicalDevice.getQueueFamilyProperties());
+    u32 validBits = queueFamilies[context->graphicsQueue.familyIndex].timestampValidBits;
+    profiler->supported = validBits > 0 && context->physicalDeviceProperties.limits.timestampPeriod > 0.0f;
+    if (!profiler->supported) {
+        LOG_WARNING("GPU timestamps not supported on the graphics queue, GPU profiling is disabled");
+        return;
+    }
+
+    profiler->timestampPeriod = context->physicalDeviceProperties.limits.timestampPeriod;
+    profiler->timestampMask = validBits >= 64 ? UINT64_MAX : (1ull << validBits) - 1;
+
+    profiler->frames.resize(frameCount);
+    for (auto& frame : profiler->frames) {
+        vk::QueryPoolCreateInfo queryPoolCreateInfo {};
+        queryPoolCreateInfo.queryType = vk::QueryType::eTimestamp;
+        queryPoolCreateInfo.queryCount = GPU_PROFILER_MAX_SCOPES * 2;
+
+        frame.queryPool = VKA(context->device.createQueryPool(queryPoolCreateInfo));
+        frame.scopes.reserve(GPU_PROFILER_MAX_SCOPES);
+    }
+}
+
+static VulkanGpuTiming* findTiming(VulkanGpuProfiler* profiler, const std::string& path, u32* timingIndex) {
+    for (u32 i = 0; i < profiler->timings.size(); ++i) {
+        if (profiler->timings[i].path == path) {
+            *timingIndex = i;
+            return &profiler->timings[i];
+        }
+    }
+
+    VulkanGpuTiming timing {};
+    timing.path = path;
+    timing.history.resize(GPU_PROFILER_HISTORY);
+    profiler->timings.push_back(timing);
+    *timingIndex = static_cast<u32>(profiler->timings.size()) - 1;
+    return &profiler->timings.back();
+}
+
+static void addSample(VulkanGpuTiming* timing, float milliseconds) {
+    timing->last = milliseconds;
+    timing->history[timing->historyCount % GPU_PROFILER_HISTORY] = milliseconds;
+    timing->historyCount++;
+
+    u32 sampleCount = std::min(timing->historyCount, GPU_PROFILER_HISTORY);
+    std::vector<float> samples(timing->history.begin(), timing->history.begin() + sampleCount);
+
+    float sum = 0.0f;
+    for (float sample : samples) {
+        sum += sample;
+    }
+    timing->average = sum / sampleCount;
+
+    std::sort(samples.begin(), samples.end());
+    timing->median = samples[sampleCount / 2];
+    timing->percentile95 = samples[std::min(sampleCount - 1, sampleCount * 95 / 100)];
+}
+
+// The frame slot's previous submission has completed, its results are there without waiting
+static void readFrameResults(VulkanContext* context, VulkanGpuProfiler* profiler, VulkanGpuProfilerFrame* frame) {
+    u32 queryCount = static_cast<u32>(frame->scopes.size()) * 2;
+    if (!frame->recorded || queryCount == 0) {
+        return;
+    }
+
+    std::vector<u64> timestamps(queryCount);
+    vk::Result result = VK(context->device.getQueryPoolResults(frame->queryPool, 0, queryCount, timestamps.size() * sizeof(u64), timestamps.data(),
+                                                                sizeof(u64), vk::QueryResultFlagBits::e64));
+    if (result != vk::Result::eSuccess) {
+        return;
+    }
+
+    profiler->frameTimings.clear();
+    std::vector<std::string> paths;
+    for (u32 i = 0; i < frame->scopes.size(); ++i) {
+        const VulkanGpuScope& scope = frame->scopes[i];
+        paths.resize(scope.depth);
+        std::string path = (paths.empty() ? std::string() : paths.back() + "/") + scope.name;
+        paths.push_back(path);
+
+        u64 ticks = (timestamps[i * 2 + 1] - timestamps[i * 2]) & profiler->timestampMask;
+        float milliseconds = static_cast<float>(ticks * profiler->timestampPeriod / 1000000.0);
+
+        u32 timingIndex;
+        VulkanGpuTiming* timing = findTiming(profiler, path, &timingIndex);
+        timing->name = scope.name;
+        timing->depth = scope.depth;
+        addSample(timing, milliseconds);
+        profiler->frameTimings.push_back(timingIndex);
+    }
+}
+
+// Call after the frame slot's previous submission has been waited for, the queries are reset on the command buffer
+void beginGpuProfilerFrame(VulkanContext* context, VulkanGpuProfiler* profiler, vk::CommandBuffer commandBuffer, u32 frameIndex) {
+    if (!profiler->supported) {
+        return;
+    }
+
+    VulkanGpuProfilerFrame* frame = &profiler->frames[frameIndex];
+    readFrameResults(context, profiler, frame);
+
+    VK(commandBuffer.resetQueryPool(frame->queryPool, 0, GPU_PROFILER_MAX_SCOPES * 2));
+    frame->scopes.clear();
+    frame->recorded = true;
+
+    profiler->recordingFrame = frame;
+    profiler->commandBuffer = commandBuffer;
+    profiler->depth = 0;
+    recordingProfiler = profiler;
+}
+
+void endGpuProfilerFrame(VulkanGpuProfiler* profiler) {
+    assert(profiler->depth == 0);
+    profiler->recordingFrame = nullptr;
+    profiler->commandBuffer = nullptr;
+    recordingProfiler = nullptr;
+}
+
+// Secondary command buffers are recorded on other threads and only get the debug label
+u32 beginTimestampScope(vk::CommandBuffer commandBuffer, const char* name) {
+    VulkanGpuProfiler* profiler = recordingProfiler;
+    if (!profiler || commandBuffer != profiler->commandBuffer || profiler->recordingFrame->scopes.size() >= GPU_PROFILER_MAX_SCOPES) {
+        return UINT32_MAX;
+    }
+
+    u32 scope = static_cast<u32>(profiler->recordingFrame->scopes.size());
+    profiler->recordingFrame->scopes.push_back({ name, profiler->depth });
+    profiler->depth++;
+
+    VK(commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, profiler->recordingFrame->queryPool, scope * 2));
+    return scope;
+}
+
+void endTimestampScope(vk::CommandBuffer commandBuffer, u32 scope) {
+    VulkanGpuProfiler* profiler = recordingProfiler;
+    if (scope == UINT32_MAX || !profiler) {
+        return;
+    }
+
+    profiler->depth--;
+    VK(commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, profiler->recordingFrame->queryPool, scope * 2 + 1));
+}
+
+void destroyGpuProfiler(VulkanContext* context, VulkanGpuProfiler* profiler) {
+    for (auto& frame : profiler->frames) {
+        VK(context->device.destroyQueryPool(frame.queryPool));
+    }
+    *profiler = VulkanGpuProfiler {};
+}
@@ -0,0 +1,851 @@
+#include <algorithm>
+
+#include "vulkan_base.h"
+
+static const vk::AccessFlags2 WRITE_ACCESS = vk::AccessFlagBits2::eColorAttachmentWrite | vk::AccessFlagBits2::eDepthStencilAttachmentWrite
+                                            | vk::AccessFlagBits2::eShaderStorageWrite | vk::AccessFlagBits2::eTransferWrite;
+
+static vk::ImageAspectFlags getImageAspect(vk::Format format) {
+    switch (format) {
+        case vk::Format::eD16Unorm:
+        case vk::Format::eD32Sfloat:
+            return vk::ImageAspectFlagBits::eDepth;
+        case vk::Format::eD24UnormS8Uint:
+        case vk::Format::eD32SfloatS8Uint:
+            return vk::ImageAspectFlagBits::eDepth | vk::ImageAspectFlagBits::eStencil;
+        default:
+            return vk::ImageAspectFlagBits::eColor;
+    }
+}
+
+// The stages and accesses used by the graph have the same bits in the legacy flags, except for the split shader reads and writes
+static vk::PipelineStageFlags toStageFlags(vk::PipelineStageFlags2 stages) {
+    return vk::PipelineStageFlags(static_cast<VkPipelineStageFlags>(static_cast<VkPipelineStageFlags2>(stages)));
+}
+
+static vk::AccessFlags toAccessFlags(vk::AccessFlags2 access) {
+    vk::AccessFlags result(static_cast<VkAccessFlags>(static_cast<VkAccessFlags2>(access) & 0xFFFFFFFF));
+    if (access & (vk::AccessFlagBits2::eShaderSampledRead | vk::AccessFlagBits2::eShaderStorageRead)) {
+        result |= vk::AccessFlagBits::eShaderRead;
+    }
+    if (access & vk::AccessFlagBits2::eShaderStorageWrite) {
+        result |= vk::AccessFlagBits::eShaderWrite;
+    }
+    return result;
+}
+
+static void addUse(VulkanRenderGraphPass* pass, u32 image, vk::PipelineStageFlags2 stages, vk::AccessFlags2 access, bool write, bool attachment) {
+    for (auto& use : pass->uses) {
+        if (use.image == image) {
+            use.stages |= stages;
+            use.access |= access;
+            use.write |= write;
+            use.attachment |= attachment;
+            return;
+        }
+    }
+
+    VulkanRenderGraphUse use {};
+    use.image = image;
+    use.stages = stages;
+    use.access = access;
+    use.write = write;
+    use.attachment = attachment;
+    pass->uses.push_back(use);
+}
+
+// Reading an image as input attachment while writing it as color attachment is a feedback loop, it needs the general or local read layout
+static vk::ImageLayout getUseLayout(const VulkanRenderGraph* graph, const VulkanRenderGraphUse& use) {
+    if (use.access & vk::AccessFlagBits2::eInputAttachmentRead) {
+        if (use.access & vk::AccessFlagBits2::eColorAttachmentWrite) {
+            return graph->useRenderPass ? vk::ImageLayout::eGeneral : vk::ImageLayout::eRenderingLocalReadKHR;
+        }
+        return graph->useRenderPass ? vk::ImageLayout::eShaderReadOnlyOptimal : vk::ImageLayout::eRenderingLocalReadKHR;
+    }
+    if (use.access & vk::AccessFlagBits2::eColorAttachmentWrite) {
+        return vk::ImageLayout::eColorAttachmentOptimal;
+    }
+    if (use.access & (vk::AccessFlagBits2::eDepthStencilAttachmentRead | vk::AccessFlagBits2::eDepthStencilAttachmentWrite)) {
+        return vk::ImageLayout::eDepthStencilAttachmentOptimal;
+    }
+    return vk::ImageLayout::eShaderReadOnlyOptimal;
+}
+
+static const VulkanRenderGraphUse* findUse(const VulkanRenderGraphPass* pass, u32 image) {
+    for (auto& use : pass->uses) {
+        if (use.image == image) {
+            return &use;
+        }
+    }
+    return nullptr;
+}
+
+static bool writesImage(const VulkanRenderGraphPass* pass, u32 image) {
+    const VulkanRenderGraphUse* use = findUse(pass, image);
+    return use && use->write;
+}
+
+static bool hasAttachments(const VulkanRenderGraphPass* pass) {
+    return !pass->colorAttachments.empty() || pass->depthAttachment.image != RENDER_GRAPH_NONE;
+}
+
+// Load op of the declaration that uses the image as attachment, resolve targets and input attachments only have a fixed one
+static vk::AttachmentLoadOp getLoadOp(const VulkanRenderGraphPass* pass, u32 image, vk::ClearValue* clearValue) {
+    for (auto& attachment : pass->colorAttachments) {
+        if (attachment.image == image) {
+            *clearValue = attachment.clearValue;
+            return attachment.loadOp;
+        }
+    }
+    if (pass->depthAttachment.image == image) {
+        *clearValue = pass->depthAttachment.clearValue;
+        return pass->depthAttachment.loadOp;
+    }
+    if (std::find(pass->inputAttachments.begin(), pass->inputAttachments.end(), image) != pass->inputAttachments.end()) {
+        return vk::AttachmentLoadOp::eLoad;
+    }
+    return vk::AttachmentLoadOp::eDontCare;
+}
+
+u32 addRenderGraphImage(VulkanRenderGraph* graph, const char* name, vk::Format format, vk::SampleCountFlagBits sampleCount) {
+    VulkanRenderGraphImage image {};
+    image.name = name;
+    image.format = format;
+    image.sampleCount = sampleCount;
+    graph->images.push_back(image);
+    return static_cast<u32>(graph->images.size()) - 1;
+}
+
+u32 importRenderGraphImage(VulkanRenderGraph* graph, const char* name, vk::Format format, const std::vector<vk::Image>& images, const std::vector<vk::ImageView>& views, vk::ImageLayout finalLayout) {
+    VulkanRenderGraphImage image {};
+    image.name = name;
+    image.format = format;
+    image.imported = true;
+    image.finalLayout = finalLayout;
+    image.images = images;
+    image.views = views;
+    graph->images.push_back(image);
+    return static_cast<u32>(graph->images.size()) - 1;
+}
+
+// New images for an imported image, the views end up in the framebuffers with the next resizeRenderGraph
+void setRenderGraphImportedImages(VulkanRenderGraph* graph, u32 image, const std::vector<vk::Image>& images, const std::vector<vk::ImageView>& views) {
+    assert(graph->images[image].imported);
+    graph->images[image].images = images;
+    graph->images[image].views = views;
+}
+
+u32 addRenderGraphPass(VulkanRenderGraph* graph, const VulkanRenderGraphPass& pass) {
+    graph->passes.push_back(pass);
+    return static_cast<u32>(graph->passes.size()) - 1;
+}
+
+static void collectUses(VulkanRenderGraph* graph) {
+    for (auto& image : graph->images) {
+        image.firstPass = RENDER_GRAPH_NONE;
+        image.lastPass = 0;
+    }
+
+    for (u32 passIndex = 0; passIndex < graph->passes.size(); ++passIndex) {
+        VulkanRenderGraphPass* pass = &graph->passes[passIndex];
+        pass->uses.clear();
+
+        for (auto& attachment : pass->colorAttachments) {
+            vk::AccessFlags2 access = vk::AccessFlagBits2::eColorAttachmentWrite;
+            if (attachment.loadOp == vk::AttachmentLoadOp::eLoad) {
+                access |= vk::AccessFlagBits2::eColorAttachmentRead;
+            }
+            addUse(pass, attachment.image, vk::PipelineStageFlagBits2::eColorAttachmentOutput, access, true, true);
+            if (attachment.resolveImage != RENDER_GRAPH_NONE) {
+                addUse(pass, attachment.resolveImage, vk::PipelineStageFlagBits2::eColorAttachmentOutput, vk::AccessFlagBits2::eColorAttachmentWrite, true, true);
+            }
+        }
+        if (pass->depthAttachment.image != RENDER_GRAPH_NONE) {
+            addUse(pass, pass->depthAttachment.image, vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eLateFragmentTests,
+                   vk::AccessFlagBits2::eDepthStencilAttachmentRead | vk::AccessFlagBits2::eDepthStencilAttachmentWrite, true, true);
+        }
+        for (u32 image : pass->inputAttachments) {
+            addUse(pass, image, vk::PipelineStageFlagBits2::eFragmentShader, vk::AccessFlagBits2::eInputAttachmentRead, false, true);
+        }
+        for (u32 image : pass->sampledImages) {
+            addUse(pass, image, vk::PipelineStageFlagBits2::eFragmentShader, vk::AccessFlagBits2::eShaderSampledRead, false, false);
+        }
+
+        for (auto& use : pass->uses) {
+            use.layout = getUseLayout(graph, use);
+            VulkanRenderGraphImage& image = graph->images[use.image];
+            image.firstPass = std::min(image.firstPass, passIndex);
+            image.lastPass = std::max(image.lastPass, passIndex);
+        }
+    }
+}
+
+static void createGroups(VulkanRenderGraph* graph) {
+    graph->groups.clear();
+
+    for (u32 passIndex = 0; passIndex < graph->passes.size(); ++passIndex) {
+        VulkanRenderGraphPass* pass = &graph->passes[passIndex];
+
+        // Only framebuffer local reads can stay in the same render pass, sampling a result needs the render pass to end first
+        bool split = graph->groups.empty() || !graph->useRenderPass || !hasAttachments(pass) || !hasAttachments(&graph->passes[passIndex - 1]);
+        if (!split) {
+            const VulkanRenderGraphGroup& group = graph->groups.back();
+            for (u32 image : pass->sampledImages) {
+                for (u32 previous = group.firstPass; previous < passIndex; ++previous) {
+                    split |= writesImage(&graph->passes[previous], image);
+                }
+            }
+        }
+
+        if (split) {
+            VulkanRenderGraphGroup group {};
+            group.firstPass = passIndex;
+            graph->groups.push_back(group);
+        }
+
+        VulkanRenderGraphGroup& group = graph->groups.back();
+        pass->group = static_cast<u32>(graph->groups.size()) - 1;
+        pass->subpass = group.passCount++;
+        group.name += (group.name.empty() ? "" : " + ") + std::string(pass->name);
+    }
+
+    // Results only have to be stored if something after the pass, or the render pass, still reads them
+    for (auto& pass : graph->passes) {
+        const VulkanRenderGraphGroup& group = graph->groups[pass.group];
+        u32 lastPassInScope = graph->useRenderPass ? group.firstPass + group.passCount - 1 : static_cast<u32>(&pass - graph->passes.data());
+        for (auto& use : pass.uses) {
+            const VulkanRenderGraphImage& image = graph->images[use.image];
+            use.storeOp = (image.imported || image.lastPass > lastPassInScope) ? vk::AttachmentStoreOp::eStore : vk::AttachmentStoreOp::eDontCare;
+        }
+    }
+}
+
+// Transient images whose lifetimes don't overlap share the same memory
+static void createTransientImages(VulkanContext* context, VulkanRenderGraph* graph) {
+    struct MemoryBlock {
+        vk::DeviceSize size;
+        u32 memoryTypeBits;
+        std::vector<u32> images;
+    };
+
+    std::vector<u32> transientImages;
+    std::vector<u32> memoryTypeBits(graph->images.size());
+    for (u32 imageIndex = 0; imageIndex < graph->images.size(); ++imageIndex) {
+        VulkanRenderGraphImage& image = graph->images[imageIndex];
+        if (image.imported || image.firstPass == RENDER_GRAPH_NONE) {
+            continue;
+        }
+
+        vk::ImageUsageFlags usage {};
+        for (u32 passIndex = image.firstPass; passIndex <= image.lastPass; ++passIndex) {
+            const VulkanRenderGraphUse* use = findUse(&graph->passes[passIndex], imageIndex);
+            if (!use) {
+                continue;
+            }
+            if (use->access & vk::AccessFlagBits2::eColorAttachmentWrite) {
+                usage |= vk::ImageUsageFlagBits::eColorAttachment;
+            }
+            if (use->access & vk::AccessFlagBits2::eDepthStencilAttachmentWrite) {
+                usage |= vk::ImageUsageFlagBits::eDepthStencilAttachment;
+            }
+            if (use->access & vk::AccessFlagBits2::eInputAttachmentRead) {
+                usage |= vk::ImageUsageFlagBits::eInputAttachment;
+            }
+            if (use->access & vk::AccessFlagBits2::eShaderSampledRead) {
+                usage |= vk::ImageUsageFlagBits::eSampled;
+            }
+        }
+
+        vk::ImageCreateInfo imageCreateInfo {};
+        imageCreateInfo.imageType = vk::ImageType::e2D;
+        imageCreateInfo.extent = vk::Extent3D{ graph->allocatedWidth, graph->allocatedHeight, 1 };
+        imageCreateInfo.mipLevels = 1;
+        imageCreateInfo.arrayLayers = 1;
+        imageCreateInfo.format = image.format;
+        imageCreateInfo.tiling = vk::ImageTiling::eOptimal;
+        imageCreateInfo.initialLayout = vk::ImageLayout::eUndefined;
+        imageCreateInfo.usage = usage;
+        imageCreateInfo.samples = image.sampleCount;
+        imageCreateInfo.sharingMode = vk::SharingMode::eExclusive;
+
+        image.images = { VKA(context->device.createImage(imageCreateInfo)) };
+
+        vk::MemoryRequirements memoryRequirements = VK(context->device.getImageMemoryRequirements(image.images[0]));
+        image.size = memoryRequirements.size;
+        memoryTypeBits[imageIndex] = memoryRequirements.memoryTypeBits;
+        graph->transientMemorySize += memoryRequirements.size;
+
+        transientImages.push_back(imageIndex);
+    }
+
+    // Largest images first, each one goes into the first block that is unused during its lifetime. Lifetimes are compared in groups,
+    // attachments of one render pass would need VK_ATTACHMENT_DESCRIPTION_MAY_ALIAS_BIT and dependencies between their subpasses
+    std::sort(transientImages.begin(), transientImages.end(), [&](u32 a, u32 b) { return graph->images[a].size > graph->images[b].size; });
+
+    auto firstGroup = [&](u32 imageIndex) { return graph->passes[graph->images[imageIndex].firstPass].group; };
+    auto lastGroup = [&](u32 imageIndex) { return graph->passes[graph->images[imageIndex].lastPass].group; };
+
+    std::vector<MemoryBlock> blocks;
+    for (u32 imageIndex : transientImages) {
+        const VulkanRenderGraphImage& image = graph->images[imageIndex];
+
+        MemoryBlock* target = nullptr;
+        for (auto& block : blocks) {
+            if (!(block.memoryTypeBits & memoryTypeBits[imageIndex])) {
+                continue;
+            }
+            bool overlaps = std::any_of(block.images.begin(), block.images.end(), [&](u32 other) {
+                return firstGroup(other) <= lastGroup(imageIndex) && firstGroup(imageIndex) <= lastGroup(other);
+            });
+            if (!overlaps) {
+                target = &block;
+                break;
+            }
+        }
+
+        if (target) {
+            target->size = std::max(target->size, image.size);
+            target->memoryTypeBits &= memoryTypeBits[imageIndex];
+            target->images.push_back(imageIndex);
+        }
+        else {
+            blocks.push_back({ image.size, memoryTypeBits[imageIndex], { imageIndex } });
+        }
+    }
+
+    for (auto& block : blocks) {
+        vk::MemoryAllocateInfo memoryAllocateInfo {};
+        memoryAllocateInfo.allocationSize = block.size;
+        memoryAllocateInfo.memoryTypeIndex = findMemoryType(context, block.memoryTypeBits, vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+        vk::DeviceMemory memory = VKA(context->device.allocateMemory(memoryAllocateInfo));
+        graph->memoryBlocks.push_back(memory);
+        graph->allocatedMemorySize += block.size;
+
+        // In pass order the previous image in the block hands the memory over, the first one gets it back from the last one of the previous frame
+        std::sort(block.images.begin(), block.images.end(), [&](u32 a, u32 b) { return graph->images[a].firstPass < graph->images[b].firstPass; });
+        for (u32 i = 0; i < block.images.size(); ++i) {
+            VulkanRenderGraphImage& image = graph->images[block.images[i]];
+            image.aliasedImage = block.images[i > 0 ? i - 1 : block.images.size() - 1];
+
+            VKA(context->device.bindImageMemory(image.images[0], memory, 0));
+
+            vk::ImageViewCreateInfo imageViewCreateInfo {};
+            imageViewCreateInfo.image = image.images[0];
+            imageViewCreateInfo.viewType = vk::ImageViewType::e2D;
+            imageViewCreateInfo.format = image.format;
+            imageViewCreateInfo.subresourceRange = vk::ImageSubresourceRange{ getImageAspect(image.format), 0, 1, 0, 1 };
+
+            image.views = { VKA(context->device.createImageView(imageViewCreateInfo)) };
+        }
+    }
+}
+
+static void addDependency(std::vector<vk::SubpassDependency>& dependencies, u32 srcSubpass, u32 dstSubpass, const vk::ImageMemoryBarrier2& barrier) {
+    for (auto& dependency : dependencies) {
+        if (dependency.srcSubpass == srcSubpass && dependency.dstSubpass == dstSubpass) {
+            dependency.srcStageMask |= toStageFlags(barrier.srcStageMask);
+            dependency.srcAccessMask |= toAccessFlags(barrier.srcAccessMask);
+            dependency.dstStageMask |= toStageFlags(barrier.dstStageMask);
+            dependency.dstAccessMask |= toAccessFlags(barrier.dstAccessMask);
+            return;
+        }
+    }
+
+    vk::SubpassDependency dependency {};
+    dependency.srcSubpass = srcSubpass;
+    dependency.dstSubpass = dstSubpass;
+    dependency.srcStageMask = toStageFlags(barrier.srcStageMask);
+    dependency.srcAccessMask = toAccessFlags(barrier.srcAccessMask);
+    dependency.dstStageMask = toStageFlags(barrier.dstStageMask);
+    dependency.dstAccessMask = toAccessFlags(barrier.dstAccessMask);
+    if (srcSubpass != VK_SUBPASS_EXTERNAL) {
+        dependency.dependencyFlags = vk::DependencyFlagBits::eByRegion;
+    }
+    dependencies.push_back(dependency);
+}
+
+// Imported images bring one view per swapchain image, transient images are the same in every framebuffer
+static void createFramebuffers(VulkanContext* context, VulkanRenderGraph* graph, VulkanRenderGraphGroup* group) {
+    u32 framebufferCount = 1;
+    for (u32 image : group->attachmentImages) {
+        framebufferCount = std::max(framebufferCount, static_cast<u32>(graph->images[image].views.size()));
+    }
+
+    for (u32 i = 0; i < framebufferCount; ++i) {
+        std::vector<vk::ImageView> views;
+        for (u32 image : group->attachmentImages) {
+            views.push_back(getRenderGraphImageView(graph, image, i));
+        }
+
+        vk::FramebufferCreateInfo framebufferCreateInfo {};
+        framebufferCreateInfo.renderPass = group->renderPass;
+        framebufferCreateInfo.attachmentCount = static_cast<u32>(views.size());
+        framebufferCreateInfo.pAttachments = views.data();
+        framebufferCreateInfo.width = graph->width;
+        framebufferCreateInfo.height = graph->height;
+        framebufferCreateInfo.layers = 1;
+
+        group->framebuffers.push_back(VKA(context->device.createFramebuffer(framebufferCreateInfo)));
+    }
+}
+
+static void createRenderPass(VulkanContext* context, VulkanRenderGraph* graph, VulkanRenderGraphGroup* group, const std::vector<vk::AttachmentDescription>& attachments,
+                             std::vector<vk::SubpassDependency>& dependencies) {
+    std::vector<u32> attachmentIndices(graph->images.size(), VK_ATTACHMENT_UNUSED);
+    for (u32 i = 0; i < group->attachmentImages.size(); ++i) {
+        attachmentIndices[group->attachmentImages[i]] = i;
+    }
+
+    std::vector<std::vector<vk::AttachmentReference>> colorReferences(group->passCount);
+    std::vector<std::vector<vk::AttachmentReference>> resolveReferences(group->passCount);
+    std::vector<std::vector<vk::AttachmentReference>> inputReferences(group->passCount);
+    std::vector<vk::AttachmentReference> depthReferences(group->passCount);
+    std::vector<std::vector<u32>> preserveAttachments(group->passCount);
+    std::vector<vk::SubpassDescription> subpasses(group->passCount);
+
+    for (u32 subpass = 0; subpass < group->passCount; ++subpass) {
+        const VulkanRenderGraphPass* pass = &graph->passes[group->firstPass + subpass];
+        auto reference = [&](u32 image) {
+            return image == RENDER_GRAPH_NONE ? vk::AttachmentReference { VK_ATTACHMENT_UNUSED, vk::ImageLayout::eUndefined }
+                                              : vk::AttachmentReference { attachmentIndices[image], findUse(pass, image)->layout };
+        };
+
+        bool hasResolve = false;
+        for (auto& attachment : pass->colorAttachments) {
+            colorReferences[subpass].push_back(reference(attachment.image));
+            resolveReferences[subpass].push_back(reference(attachment.resolveImage));
+            hasResolve |= attachment.resolveImage != RENDER_GRAPH_NONE;
+        }
+        for (u32 image : pass->inputAttachments) {
+            inputReferences[subpass].push_back(reference(image));
+        }
+        depthReferences[subpass] = reference(pass->depthAttachment.image);
+
+        // Attachments that are used before and after this subpass but not in it have to be preserved
+        for (u32 attachment = 0; attachment < group->attachmentImages.size(); ++attachment) {
+            u32 image = group->attachmentImages[attachment];
+            bool usedBefore = false, usedAfter = false;
+            for (u32 other = 0; other < group->passCount; ++other) {
+                bool used = findUse(&graph->passes[group->firstPass + other], image) != nullptr;
+                usedBefore |= used && other < subpass;
+                usedAfter |= used && other > subpass;
+            }
+            if (usedBefore && usedAfter && !findUse(pass, image)) {
+                preserveAttachments[subpass].push_back(attachment);
+            }
+        }
+
+        vk::SubpassDescription& description = subpasses[subpass];
+        description.pipelineBindPoint = vk::PipelineBindPoint::eGraphics;
+        description.colorAttachmentCount = static_cast<u32>(colorReferences[subpass].size());
+        description.pColorAttachments = colorReferences[subpass].data();
+        description.pResolveAttachments = hasResolve ? resolveReferences[subpass].data() : nullptr;
+        description.inputAttachmentCount = static_cast<u32>(inputReferences[subpass].size());
+        description.pInputAttachments = inputReferences[subpass].data();
+        description.pDepthStencilAttachment = pass->depthAttachment.image != RENDER_GRAPH_NONE ? &depthReferences[subpass] : nullptr;
+        description.preserveAttachmentCount = static_cast<u32>(preserveAttachments[subpass].size());
+        description.pPreserveAttachments = preserveAttachments[subpass].data();
+    }
+
+    vk::RenderPassCreateInfo renderPassCreateInfo {};
+    renderPassCreateInfo.attachmentCount = static_cast<u32>(attachments.size());
+    renderPassCreateInfo.pAttachments = attachments.data();
+    renderPassCreateInfo.subpassCount = static_cast<u32>(subpasses.size());
+    renderPassCreateInfo.pSubpasses = subpasses.data();
+    renderPassCreateInfo.dependencyCount = static_cast<u32>(dependencies.size());
+    renderPassCreateInfo.pDependencies = dependencies.data();
+    group->renderPass = VKA(context->device.createRenderPass(renderPassCreateInfo));
+
+    createFramebuffers(context, graph, group);
+}
+
+// Walks the passes once in order and tracks the layout and last access of every image. Every hazard becomes
+// a barrier in front of the pass, or a subpass dependency when both accesses are attachments of the same render pass
+static void createBarriers(VulkanContext* context, VulkanRenderGraph* graph) {
+    struct ImageState {
+        vk::ImageLayout layout;
+        vk::PipelineStageFlags2 stages;
+        vk::AccessFlags2 access;
+        bool write;
+        u32 pass;
+    };
+
+    std::vector<const VulkanRenderGraphUse*> lastUses(graph->images.size(), nullptr);
+    for (auto& pass : graph->passes) {
+        for (auto& use : pass.uses) {
+            lastUses[use.image] = &use;
+        }
+    }
+
+    // The contents of every image are discarded between frames, only the execution has to wait for the previous frame
+    std::vector<ImageState> states(graph->images.size());
+    for (u32 imageIndex = 0; imageIndex < graph->images.size(); ++imageIndex) {
+        const VulkanRenderGraphImage& image = graph->images[imageIndex];
+        if (image.imported) {
+            // The acquire semaphore is waited on at color attachment output
+            states[imageIndex] = { vk::ImageLayout::eUndefined, vk::PipelineStageFlagBits2::eColorAttachmentOutput, {}, false, RENDER_GRAPH_NONE };
+        }
+        else if (image.aliasedImage != RENDER_GRAPH_NONE) {
+            const VulkanRenderGraphUse* previous = lastUses[image.aliasedImage];
+            states[imageIndex] = { vk::ImageLayout::eUndefined, previous->stages, previous->access, previous->write, RENDER_GRAPH_NONE };
+        }
+    }
+
+    for (u32 groupIndex = 0; groupIndex < graph->groups.size(); ++groupIndex) {
+        VulkanRenderGraphGroup* group = &graph->groups[groupIndex];
+        group->barriers.clear();
+
+        std::vector<vk::AttachmentDescription> attachments;
+        std::vector<vk::SubpassDependency> dependencies;
+        std::vector<u32> attachmentIndices(graph->images.size(), RENDER_GRAPH_NONE);
+
+        for (u32 passIndex = group->firstPass; passIndex < group->firstPass + group->passCount; ++passIndex) {
+            VulkanRenderGraphPass* pass = &graph->passes[passIndex];
+            pass->barriers.clear();
+
+            for (auto& use : pass->uses) {
+                ImageState& state = states[use.image];
+                const VulkanRenderGraphImage& image = graph->images[use.image];
+
+                if (graph->useRenderPass && use.attachment) {
+                    u32& attachmentIndex = attachmentIndices[use.image];
+                    if (attachmentIndex == RENDER_GRAPH_NONE) {
+                        attachmentIndex = static_cast<u32>(attachments.size());
+                        group->attachmentImages.push_back(use.image);
+
+                        vk::ClearValue clearValue {};
+                        vk::AttachmentDescription description {};
+                        description.format = image.format;
+                        description.samples = image.sampleCount;
+                        description.loadOp = getLoadOp(pass, use.image, &clearValue);
+                        description.stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
+                        description.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
+                        description.initialLayout = state.layout;
+                        attachments.push_back(description);
+                        group->clearValues.push_back(clearValue);
+                    }
+                    attachments[attachmentIndex].storeOp = use.storeOp;
+                    attachments[attachmentIndex].finalLayout = use.layout;
+                }
+
+                // Reads of an image in the same layout don't depend on each other
+                bool hazard = state.layout != use.layout || state.write || use.write;
+                if (!hazard) {
+                    state.stages |= use.stages;
+                    state.access |= use.access;
+                    state.pass = passIndex;
+                    continue;
+                }
+
+                VulkanRenderGraphBarrier barrier {};
+                barrier.image = use.image;
+                barrier.barrier.srcStageMask = state.stages;
+                barrier.barrier.srcAccessMask = state.write ? state.access & WRITE_ACCESS : vk::AccessFlags2 {};
+                barrier.barrier.dstStageMask = use.stages;
+                barrier.barrier.dstAccessMask = use.access;
+                barrier.barrier.oldLayout = state.layout;
+                barrier.barrier.newLayout = use.layout;
+                barrier.barrier.srcQueueFamilyIndex = vk::QueueFamilyIgnored;
+                barrier.barrier.dstQueueFamilyIndex = vk::QueueFamilyIgnored;
+                barrier.barrier.subresourceRange = vk::ImageSubresourceRange { getImageAspect(image.format), 0, 1, 0, 1 };
+
+                if (graph->useRenderPass && use.attachment) {
+                    // The render pass does the layout transition, only the dependency is left
+                    bool samePass = state.pass != RENDER_GRAPH_NONE && graph->passes[state.pass].group == groupIndex;
+                    addDependency(dependencies, samePass ? graph->passes[state.pass].subpass : VK_SUBPASS_EXTERNAL, pass->subpass, barrier.barrier);
+                }
+                else if (graph->useRenderPass) {
+                    group->barriers.push_back(barrier);
+                }
+                else {
+                    pass->barriers.push_back(barrier);
+                }
+
+                state = { use.layout, use.stages, use.access, use.write, passIndex };
+            }
+
+            // Reading the color attachment through an input attachment in the same subpass
+            const VulkanRenderGraphUse* feedback = nullptr;
+            for (auto& use : pass->uses) {
+                if ((use.access & vk::AccessFlagBits2::eInputAttachmentRead) && (use.access & vk::AccessFlagBits2::eColorAttachmentWrite)) {
+                    feedback = &use;
+                }
+            }
+            if (graph->useRenderPass && feedback) {
+                vk::ImageMemoryBarrier2 selfBarrier {};
+                selfBarrier.srcStageMask = vk::PipelineStageFlagBits2::eFragmentShader;
+                selfBarrier.srcAccessMask = vk::AccessFlagBits2::eInputAttachmentRead;
+                selfBarrier.dstStageMask = vk::PipelineStageFlagBits2::eColorAttachmentOutput;
+                selfBarrier.dstAccessMask = vk::AccessFlagBits2::eColorAttachmentWrite;
+                addDependency(dependencies, pass->subpass, pass->subpass, selfBarrier);
+            }
+        }
+
+        if (graph->useRenderPass && !attachments.empty()) {
+            // Imported images that aren't used after this render pass go straight to their final layout
+            for (u32 i = 0; i < group->attachmentImages.size(); ++i) {
+                u32 imageIndex = group->attachmentImages[i];
+                const VulkanRenderGraphImage& image = graph->images[imageIndex];
+                if (image.imported && image.lastPass < group->firstPass + group->passCount) {
+                    attachments[i].finalLayout = image.finalLayout;
+                }
+                states[imageIndex].layout = attachments[i].finalLayout;
+            }
+
+            createRenderPass(context, graph, group, attachments, dependencies);
+        }
+    }
+
+    graph->finalBarriers.clear();
+    for (u32 imageIndex = 0; imageIndex < graph->images.size(); ++imageIndex) {
+        const VulkanRenderGraphImage& image = graph->images[imageIndex];
+        const ImageState& state = states[imageIndex];
+        if (!image.imported || image.firstPass == RENDER_GRAPH_NONE || state.layout == image.finalLayout) {
+            continue;
+        }
+
+        VulkanRenderGraphBarrier barrier {};
+        barrier.image = imageIndex;
+        barrier.barrier.srcStageMask = state.stages;
+        barrier.barrier.srcAccessMask = state.write ? state.access & WRITE_ACCESS : vk::AccessFlags2 {};
+        barrier.barrier.dstStageMask = vk::PipelineStageFlagBits2::eBottomOfPipe;
+        barrier.barrier.dstAccessMask = vk::AccessFlagBits2::eNone;
+        barrier.barrier.oldLayout = state.layout;
+        barrier.barrier.newLayout = image.finalLayout;
+        barrier.barrier.srcQueueFamilyIndex = vk::QueueFamilyIgnored;
+        barrier.barrier.dstQueueFamilyIndex = vk::QueueFamilyIgnored;
+        barrier.barrier.subresourceRange = vk::ImageSubresourceRange { getImageAspect(image.format), 0, 1, 0, 1 };
+        graph->finalBarriers.push_back(barrier);
+    }
+}
+
+static u32 getBucketExtent(u32 extent) {
+    return (extent + RENDER_GRAPH_EXTENT_BUCKET - 1) / RENDER_GRAPH_EXTENT_BUCKET * RENDER_GRAPH_EXTENT_BUCKET;
+}
+
+void compileRenderGraph(VulkanContext* context, VulkanRenderGraph* graph) {
+    // Transient images are rounded up, smaller and slightly bigger sizes later only need resizeRenderGraph
+    graph->allocatedWidth = getBucketExtent(graph->width);
+    graph->allocatedHeight = getBucketExtent(graph->height);
+
+    collectUses(graph);
+    createGroups(graph);
+    createTransientImages(context, graph);
+    createBarriers(context, graph);
+
+    u32 transientCount = 0;
+    for (auto& image : graph->images) {
+        transientCount += (!image.imported && image.firstPass != RENDER_GRAPH_NONE) ? 1 : 0;
+    }
+
+    const double megabyte = 1024.0 * 1024.0;
+    LOG_INFO("Render graph: " + std::to_string(graph->passes.size()) + " passes in " + std::to_string(graph->groups.size()) + (graph->useRenderPass ? " render passes, " : " rendering scopes, ")
+             + std::to_string(transientCount) + " transient images, " + std::to_string(graph->transientMemorySize / megabyte) + " MB, "
+             + std::to_string(graph->allocatedMemorySize / megabyte) + " MB allocated after aliasing (" + std::to_string((graph->transientMemorySize - graph->allocatedMemorySize) / megabyte) + " MB saved)");
+}
+
+// Keeps the transient images if the new extent fits into them without wasting more than half of a fresh allocation,
+// then only the framebuffers are recreated and the render area shrinks. Returns false if the graph has to be compiled again
+bool resizeRenderGraph(VulkanContext* context, VulkanRenderGraph* graph, u32 width, u32 height) {
+    if (width > graph->allocatedWidth || height > graph->allocatedHeight) {
+        return false;
+    }
+    if (static_cast<u64>(getBucketExtent(width)) * getBucketExtent(height) * 2 < static_cast<u64>(graph->allocatedWidth) * graph->allocatedHeight) {
+        return false;
+    }
+
+    graph->width = width;
+    graph->height = height;
+
+    for (auto& group : graph->groups) {
+        if (!group.renderPass) {
+            continue;
+        }
+        deferDestruction(context, [context, framebuffers = group.framebuffers]() {
+            for (auto& framebuffer : framebuffers) {
+                VK(context->device.destroyFramebuffer(framebuffer));
+            }
+        });
+        group.framebuffers.clear();
+        createFramebuffers(context, graph, &group);
+    }
+    return true;
+}
+
+static void recordBarriers(const VulkanRenderGraph* graph, vk::CommandBuffer commandBuffer, const std::vector<VulkanRenderGraphBarrier>& barriers, u32 imageIndex) {
+    if (barriers.empty()) {
+        return;
+    }
+
+    std::vector<vk::ImageMemoryBarrier2> imageBarriers;
+    imageBarriers.reserve(barriers.size());
+    for (auto& barrier : barriers) {
+        const VulkanRenderGraphImage& image = graph->images[barrier.image];
+        imageBarriers.push_back(barrier.barrier);
+        imageBarriers.back().image = image.images[image.imported ? imageIndex : 0];
+    }
+
+    vk::DependencyInfo dependencyInfo {};
+    dependencyInfo.imageMemoryBarrierCount = static_cast<u32>(imageBarriers.size());
+    dependencyInfo.pImageMemoryBarriers = imageBarriers.data();
+    VK(commandBuffer.pipelineBarrier2(dependencyInfo));
+}
+
+static void beginPassRendering(const VulkanRenderGraph* graph, vk::CommandBuffer commandBuffer, const VulkanRenderGraphPass* pass, u32 imageIndex) {
+    std::vector<vk::RenderingAttachmentInfo> colorAttachments;
+    for (auto& attachment : pass->colorAttachments) {
+        const VulkanRenderGraphUse* use = findUse(pass, attachment.image);
+
+        vk::RenderingAttachmentInfo colorAttachment {};
+        colorAttachment.imageView = getRenderGraphImageView(graph, attachment.image, imageIndex);
+        colorAttachment.imageLayout = use->layout;
+        colorAttachment.loadOp = attachment.loadOp;
+        colorAttachment.storeOp = use->storeOp;
+        colorAttachment.clearValue = attachment.clearValue;
+        if (attachment.resolveImage != RENDER_GRAPH_NONE) {
+            colorAttachment.resolveMode = vk::ResolveModeFlagBits::eAverage;
+            colorAttachment.resolveImageView = getRenderGraphImageView(graph, attachment.resolveImage, imageIndex);
+            colorAttachment.resolveImageLayout = findUse(pass, attachment.resolveImage)->layout;
+        }
+        colorAttachments.push_back(colorAttachment);
+    }
+
+    vk::RenderingAttachmentInfo depthAttachment {};
+    if (pass->depthAttachment.image != RENDER_GRAPH_NONE) {
+        const VulkanRenderGraphUse* use = findUse(pass, pass->depthAttachment.image);
+        depthAttachment.imageView = getRenderGraphImageView(graph, pass->depthAttachment.image, imageIndex);
+        depthAttachment.imageLayout = use->layout;
+        depthAttachment.loadOp = pass->depthAttachment.loadOp;
+        depthAttachment.storeOp = use->storeOp;
+        depthAttachment.clearValue = pass->depthAttachment.clearValue;
+    }
+
+    vk::RenderingInfo renderingInfo {};
+    if (pass->secondaryCommandBuffers) {
+        renderingInfo.flags = vk::RenderingFlagBits::eContentsSecondaryCommandBuffers;
+    }
+    renderingInfo.renderArea = vk::Rect2D( {0, 0}, {graph->width, graph->height} );
+    renderingInfo.layerCount = 1;
+    renderingInfo.colorAttachmentCount = static_cast<u32>(colorAttachments.size());
+    renderingInfo.pColorAttachments = colorAttachments.data();
+    renderingInfo.pDepthAttachment = pass->depthAttachment.image != RENDER_GRAPH_NONE ? &depthAttachment : nullptr;
+
+    commandBuffer.beginRendering(renderingInfo);
+}
+
+void executeRenderGraph(VulkanRenderGraph* graph, vk::CommandBuffer commandBuffer, u32 imageIndex) {
+    for (auto& group : graph->groups) {
+        recordBarriers(graph, commandBuffer, group.barriers, imageIndex);
+
+        if (group.renderPass) {
+            // Timestamps can't go into subpasses that only execute secondary command buffers, the whole render pass is timed instead
+            SCOPE_LABEL(group.name.c_str());
+
+            vk::RenderPassBeginInfo renderPassBeginInfo {};
+            renderPassBeginInfo.renderPass = group.renderPass;
+            renderPassBeginInfo.framebuffer = group.framebuffers[group.framebuffers.size() > 1 ? imageIndex : 0];
+            renderPassBeginInfo.renderArea = vk::Rect2D( {0, 0}, {graph->width, graph->height} );
+            renderPassBeginInfo.clearValueCount = static_cast<u32>(group.clearValues.size());
+            renderPassBeginInfo.pClearValues = group.clearValues.data();
+
+            for (u32 subpass = 0; subpass < group.passCount; ++subpass) {
+                VulkanRenderGraphPass& pass = graph->passes[group.firstPass + subpass];
+                vk::SubpassContents contents = pass.secondaryCommandBuffers ? vk::SubpassContents::eSecondaryCommandBuffers : vk::SubpassContents::eInline;
+                if (subpass == 0) {
+                    commandBuffer.beginRenderPass(renderPassBeginInfo, contents);
+                }
+                else {
+                    commandBuffer.nextSubpass(contents);
+                }
+
+                if (pass.record) {
+                    commandLabelScope passScope(commandBuffer, pass.name, !pass.secondaryCommandBuffers);
+                    pass.record(commandBuffer);
+                }
+            }
+
+            commandBuffer.endRenderPass();
+            continue;
+        }
+
+        for (u32 passIndex = group.firstPass; passIndex < group.firstPass + group.passCount; ++passIndex) {
+            VulkanRenderGraphPass& pass = graph->passes[passIndex];
+            recordBarriers(graph, commandBuffer, pass.barriers, imageIndex);
+
+            // Outside of the rendering scope, it may only execute secondary command buffers
+            SCOPE_LABEL(pass.name);
+            bool rendering = hasAttachments(&pass);
+            if (rendering) {
+                beginPassRendering(graph, commandBuffer, &pass, imageIndex);
+            }
+            if (pass.record) {
+                pass.record(commandBuffer);
+            }
+            if (rendering) {
+                commandBuffer.endRendering();
+            }
+        }
+    }
+
+    recordBarriers(graph, commandBuffer, graph->finalBarriers, imageIndex);
+}
+
+// Frames in flight may still render with the graph, its objects are destroyed once the timeline passed them
+void destroyRenderGraph(VulkanContext* context, VulkanRenderGraph* graph) {
+    std::vector<vk::Framebuffer> framebuffers;
+    std::vector<vk::RenderPass> renderPasses;
+    for (auto& group : graph->groups) {
+        framebuffers.insert(framebuffers.end(), group.framebuffers.begin(), group.framebuffers.end());
+        if (group.renderPass) {
+            renderPasses.push_back(group.renderPass);
+        }
+    }
+
+    std::vector<vk::ImageView> views;
+    std::vector<vk::Image> images;
+    for (auto& image : graph->images) {
+        if (image.imported) {
+            continue;
+        }
+        views.insert(views.end(), image.views.begin(), image.views.end());
+        images.insert(images.end(), image.images.begin(), image.images.end());
+    }
+
+    deferDestruction(context, [context, framebuffers, renderPasses, views, images, memoryBlocks = graph->memoryBlocks]() {
+        for (auto& framebuffer : framebuffers) {
+            VK(context->device.destroyFramebuffer(framebuffer));
+        }
+        for (auto& renderPass : renderPasses) {
+            VK(context->device.destroyRenderPass(renderPass));
+        }
+        for (auto& view : views) {
+            VK(context->device.destroyImageView(view));
+        }
+        for (auto& handle : images) {
+            VK(context->device.destroyImage(handle));
+        }
+        for (auto& memory : memoryBlocks) {
+            VK(context->device.freeMemory(memory));
+        }
+    });
+
+    *graph = VulkanRenderGraph {};
+}
+
+vk::ImageView getRenderGraphImageView(const VulkanRenderGraph* graph, u32 image, u32 imageIndex) {
+    const VulkanRenderGraphImage& graphImage = graph->images[image];
+    return graphImage.views[graphImage.imported ? imageIndex : 0];
+}
+
+vk::RenderPass getRenderGraphRenderPass(const VulkanRenderGraph* graph, u32 pass) {
+    return graph->groups[graph->passes[pass].group].renderPass;
+}
+
+vk::Framebuffer getRenderGraphFramebuffer(const VulkanRenderGraph* graph, u32 pass, u32 imageIndex) {
+    const VulkanRenderGraphGroup& group = graph->groups[graph->passes[pass].group];
+    if (group.framebuffers.empty()) {
+        return nullptr;
+    }
+    return group.framebuffers[group.framebuffers.size() > 1 ? imageIndex : 0];
+}
@@ -1,6 +1,9 @@
+#include <algorithm>
+
 #include "vulkan_base.h"
 
-VulkanSwapchain createSwapchain(VulkanContext* context, vk::SurfaceKHR surface, vk::ImageUsageFlags imageUsage, VulkanSwapchain* oldSwapchain) {
+VulkanSwapchain createSwapchain(VulkanContext* context, vk::SurfaceKHR surface, vk::ImageUsageFlags imageUsage, VulkanSwapchain* oldSwapchain,
+                                vk::PresentModeKHR presentMode) {
     VulkanSwapchain result_swapchain {};
 
     auto supportsPresent = VKA(context->physicalDevice.getSurfaceSupportKHR(context->graphicsQueue.familyIndex, surface));
@@ -25,7 +28,7 @@ VulkanSwapchain createSwapchain(VulkanContext* context, vk::SurfaceKHR surface,
         surfaceCapabilities.currentExtent.width = surfaceCapabilities.minImageExtent.width;
     }
 
-    if (surfaceCapabilities.currentExtent.height != 0xFFFFFFFF) {
+    if (surfaceCapabilities.currentExtent.height == 0xFFFFFFFF) {
         surfaceCapabilities.currentExtent.height = surfaceCapabilities.minImageExtent.height;
     }
 
@@ -33,9 +36,18 @@ VulkanSwapchain createSwapchain(VulkanContext* context, vk::SurfaceKHR surface,
         surfaceCapabilities.maxImageCount = 8; // Todo: Bigger than minImageCount
     }
 
+    // FIFO is the only mode every surface has to support
+    auto availablePresentModes = VKA(context->physicalDevice.getSurfacePresentModesKHR(surface));
+    if (std::find(availablePresentModes.begin(), availablePresentModes.end(), presentMode) == availablePresentModes.end()) {
+        LOG_WARNING("Present mode " + vk::to_string(presentMode) + " not supported, falling back to FIFO");
+        presentMode = vk::PresentModeKHR::eFifo;
+    }
+
+    LOG_DEBUG("Selected present mode: " + vk::to_string(presentMode));
+
     vk::SwapchainCreateInfoKHR swapchainCreateInfo {};
     swapchainCreateInfo.surface = surface;
-    swapchainCreateInfo.minImageCount = 3;
+    swapchainCreateInfo.minImageCount = std::clamp(3u, surfaceCapabilities.minImageCount, surfaceCapabilities.maxImageCount);
     swapchainCreateInfo.imageFormat = format;
     swapchainCreateInfo.imageColorSpace = colorSpace;
     swapchainCreateInfo.imageExtent = surfaceCapabilities.currentExtent;
@@ -44,11 +56,12 @@ VulkanSwapchain createSwapchain(VulkanContext* context, vk::SurfaceKHR surface,
     swapchainCreateInfo.imageSharingMode = vk::SharingMode::eExclusive;
     swapchainCreateInfo.preTransform = vk::SurfaceTransformFlagBitsKHR::eIdentity;
     swapchainCreateInfo.compositeAlpha = vk::CompositeAlphaFlagBitsKHR::eOpaque;
-    swapchainCreateInfo.presentMode = vk::PresentModeKHR::eFifo;
+    swapchainCreateInfo.presentMode = presentMode;
     swapchainCreateInfo.oldSwapchain = oldSwapchain ? oldSwapchain->swapchain : VK_NULL_HANDLE;
     VKA(context->device.createSwapchainKHR(&swapchainCreateInfo, nullptr, &result_swapchain.swapchain));
 
     result_swapchain.format = format;
+    result_swapchain.presentMode = presentMode;
     result_swapchain.width = surfaceCapabilities.currentExtent.width;
     result_swapchain.height = surfaceCapabilities.currentExtent.height;
 
@@ -72,9 +85,43 @@ VulkanSwapchain createSwapchain(VulkanContext* context, vk::SurfaceKHR surface,
     return result_swapchain;
 }
 
-void destroySwapchain(VulkanContext* context, VulkanSwapchain* swapchain) {
-    for (auto& view : swapchain->imageViews) {
-        context->device.destroyImageView(view);
+// Stands in for a swapchain without a surface, frames pick their image themselves and nothing is presented
+VulkanSwapchain createOffscreenSwapchain(VulkanContext* context, u32 width, u32 height, vk::Format format, vk::ImageUsageFlags imageUsage, u32 imageCount) {
+    VulkanSwapchain result_swapchain {};
+    result_swapchain.format = format;
+    result_swapchain.presentMode = vk::PresentModeKHR::eImmediate;
+    result_swapchain.width = width;
+    result_swapchain.height = height;
+
+    result_swapchain.offscreenImages.resize(imageCount);
+    for (auto& image : result_swapchain.offscreenImages) {
+        createImage(context, &image, width, height, format, imageUsage);
+        result_swapchain.images.push_back(image.image);
+        result_swapchain.imageViews.push_back(image.imageView);
+    }
+
+    LOG_DEBUG("Created " + std::to_string(imageCount) + " offscreen images: " + std::to_string(width) + "x" + std::to_string(height) + " " + vk::to_string(format));
+
+    return result_swapchain;
+}
+
+// The images may still be rendered to or presented, the swapchain is retired once the timeline reaches retireValue
+void destroySwapchain(VulkanContext* context, VulkanSwapchain* swapchain, u64 retireValue) {
+    if (!swapchain->offscreenImages.empty()) {
+        deferDestructionUntil(context, retireValue, [context, images = swapchain->offscreenImages]() mutable {
+            for (auto& image : images) {
+                destroyImage(context, &image);
+            }
+        });
+        *swapchain = VulkanSwapchain {};
+        return;
     }
-    VK(context->device.destroySwapchainKHR(swapchain->swapchain, nullptr));
+
+    deferDestructionUntil(context, retireValue, [context, handle = swapchain->swapchain, views = swapchain->imageViews]() {
+        for (auto& view : views) {
+            context->device.destroyImageView(view);
+        }
+        VK(context->device.destroySwapchainKHR(handle, nullptr));
+    });
+    *swapchain = VulkanSwapchain {};
 }
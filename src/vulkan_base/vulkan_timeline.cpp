@@ -0,0 +1,134 @@
+#include "vulkan_base.h"
+
+void createTimeline(VulkanContext* context) {
+    vk::SemaphoreTypeCreateInfo semaphoreTypeCreateInfo {};
+    semaphoreTypeCreateInfo.semaphoreType = vk::SemaphoreType::eTimeline;
+    semaphoreTypeCreateInfo.initialValue = 0;
+
+    vk::SemaphoreCreateInfo semaphoreCreateInfo {};
+    semaphoreCreateInfo.pNext = &semaphoreTypeCreateInfo;
+
+    context->timeline.semaphore = VKA(context->device.createSemaphore(semaphoreCreateInfo));
+    context->timeline.submittedValue = 0;
+    context->timeline.completedValue = 0;
+    context->timeline.uploadValue = 0;
+}
+
+// Signals the next timeline value next to the given binary semaphores and returns it.
+// Uploads that might not have finished yet are waited for on the GPU, the CPU never blocks here
+u64 submitTimeline(VulkanContext* context, VulkanQueue* queue, u32 commandBufferCount, const vk::CommandBuffer* commandBuffers,
+                    u32 waitSemaphoreCount, const vk::Semaphore* waitSemaphores, const vk::PipelineStageFlags* waitStages,
+                    u32 signalSemaphoreCount, const vk::Semaphore* signalSemaphores) {
+    VulkanTimeline* timeline = &context->timeline;
+
+    // Binary semaphores ignore their value, the arrays only have to line up with the semaphores
+    std::vector<vk::Semaphore> waits(waitSemaphores, waitSemaphores + waitSemaphoreCount);
+    std::vector<vk::PipelineStageFlags> stages(waitStages, waitStages + waitSemaphoreCount);
+    std::vector<u64> waitValues(waitSemaphoreCount, 0);
+    if (timeline->uploadValue > timeline->completedValue) {
+        waits.push_back(timeline->semaphore);
+        stages.push_back(vk::PipelineStageFlagBits::eAllCommands);
+        waitValues.push_back(timeline->uploadValue);
+    }
+
+    std::vector<vk::Semaphore> signals(signalSemaphores, signalSemaphores + signalSemaphoreCount);
+    std::vector<u64> signalValues(signalSemaphoreCount, 0);
+    signals.push_back(timeline->semaphore);
+    signalValues.push_back(timeline->submittedValue + 1);
+
+    vk::TimelineSemaphoreSubmitInfo timelineSubmitInfo {};
+    timelineSubmitInfo.waitSemaphoreValueCount = static_cast<u32>(waitValues.size());
+    timelineSubmitInfo.pWaitSemaphoreValues = waitValues.data();
+    timelineSubmitInfo.signalSemaphoreValueCount = static_cast<u32>(signalValues.size());
+    timelineSubmitInfo.pSignalSemaphoreValues = signalValues.data();
+
+    vk::SubmitInfo submitInfo {};
+    submitInfo.pNext = &timelineSubmitInfo;
+    submitInfo.commandBufferCount = commandBufferCount;
+    submitInfo.pCommandBuffers = commandBuffers;
+    submitInfo.waitSemaphoreCount = static_cast<u32>(waits.size());
+    submitInfo.pWaitSemaphores = waits.data();
+    submitInfo.pWaitDstStageMask = stages.data();
+    submitInfo.signalSemaphoreCount = static_cast<u32>(signals.size());
+    submitInfo.pSignalSemaphores = signals.data();
+
+    VKA(queue->queue.submit(submitInfo));
+
+    return ++timeline->submittedValue;
+}
+
+// Reads how far the GPU got and runs the destructions that became safe, returns the completed value
+u64 updateTimeline(VulkanContext* context) {
+    VulkanTimeline* timeline = &context->timeline;
+    timeline->completedValue = VKA(context->device.getSemaphoreCounterValue(timeline->semaphore));
+
+    // Collected first, a destroy callback may defer further destructions. The order of the rest is kept
+    std::vector<VulkanDeferredDestruction> ready;
+    auto& deferred = timeline->deferredDestructions;
+    u32 keptCount = 0;
+    for (auto& destruction : deferred) {
+        if (destruction.timelineValue <= timeline->completedValue) {
+            ready.push_back(std::move(destruction));
+        }
+        else {
+            deferred[keptCount++] = std::move(destruction);
+        }
+    }
+    deferred.resize(keptCount);
+
+    for (auto& destruction : ready) {
+        destruction.destroy();
+    }
+
+    return timeline->completedValue;
+}
+
+void waitTimeline(VulkanContext* context, u64 value) {
+    if (value <= context->timeline.completedValue) {
+        return;
+    }
+
+    vk::SemaphoreWaitInfo waitInfo {};
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &context->timeline.semaphore;
+    waitInfo.pValues = &value;
+
+    VKA(context->device.waitSemaphores(waitInfo, UINT64_MAX));
+    updateTimeline(context);
+}
+
+// The resources may still be used by everything submitted so far
+void deferDestruction(VulkanContext* context, std::function<void()> destroy) {
+    deferDestructionUntil(context, context->timeline.submittedValue, std::move(destroy));
+}
+
+void deferDestructionUntil(VulkanContext* context, u64 timelineValue, std::function<void()> destroy) {
+    if (timelineValue <= context->timeline.completedValue) {
+        destroy();
+        return;
+    }
+    context->timeline.deferredDestructions.push_back({ timelineValue, std::move(destroy) });
+}
+
+// Runs every deferred destruction no matter its value, only valid once the device is idle
+void flushDeferredDestructions(VulkanContext* context) {
+    VulkanTimeline* timeline = &context->timeline;
+    timeline->completedValue = VKA(context->device.getSemaphoreCounterValue(timeline->semaphore));
+    assert(timeline->completedValue == timeline->submittedValue);
+
+    while (!timeline->deferredDestructions.empty()) {
+        std::vector<VulkanDeferredDestruction> destructions = std::move(timeline->deferredDestructions);
+        timeline->deferredDestructions.clear();
+        for (auto& destruction : destructions) {
+            destruction.destroy();
+        }
+    }
+}
+
+void destroyTimeline(VulkanContext* context) {
+    waitTimeline(context, context->timeline.submittedValue);
+    flushDeferredDestructions(context);
+
+    VK(context->device.destroySemaphore(context->timeline.semaphore));
+    context->timeline.semaphore = nullptr;
+}
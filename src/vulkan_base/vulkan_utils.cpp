@@ -8,7 +8,7 @@ u32 findMemoryType(VulkanContext* context, u32 typeFilter, vk::MemoryPropertyFla
         if (typeFilter & (1 << i)) {
             // check if required properties are satisfied
             if ((deviceMemoryProperties.memoryTypes[i].propertyFlags & memoryProperties) == memoryProperties) {
-                LOG_DEBUG("Using memory type index " + std::to_string(i) + " (heap " + std::to_string(deviceMemoryProperties.memoryTypes[i].heapIndex) + ")");
+                LOG_DEBUG("Using memory type index {} (heap {})", i, deviceMemoryProperties.memoryTypes[i].heapIndex);
                 return i;
             }
         }
@@ -49,6 +49,7 @@ void createBuffer(VulkanContext* context, VulkanBuffer* buffer, u64 size, vk::Bu
 }
 
 void uploadDataToBuffer(VulkanContext* context, VulkanBuffer* buffer, void* data, size_t size) {
+    PROFILE_FUNCTION();
     // if (detectResizeableBar(context)) {
     //     void* mapped;
     //     VKA(context->device.mapMemory(buffer->memory, 0, size, {}, &mapped));
@@ -93,20 +94,21 @@ void uploadDataToBuffer(VulkanContext* context, VulkanBuffer* buffer, void* data
 
     VKA(commandBuffer.end());
 
-    vk::SubmitInfo submitInfo{};
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffer;
-
-    VKA(queue->queue.submit(submitInfo));
-    VKA(queue->queue.waitIdle());
-
-    VK(context->device.destroyCommandPool(commandPool));
+    // Nothing waits on the CPU, the staging memory is destroyed once the timeline passed the upload
+    context->timeline.uploadValue = submitTimeline(context, queue, 1, &commandBuffer);
     destroyBuffer(context, &stagingBuffer);
+    deferDestruction(context, [context, commandPool]() {
+        VK(context->device.destroyCommandPool(commandPool));
+    });
 }
 
+// Frames in flight may still read the buffer, the handles are destroyed once the timeline passed them
 void destroyBuffer(VulkanContext* context, VulkanBuffer* buffer) {
-    VK(context->device.destroyBuffer(buffer->buffer));
-    VK(context->device.freeMemory(buffer->memory));
+    deferDestruction(context, [context, handle = buffer->buffer, memory = buffer->memory]() {
+        VK(context->device.destroyBuffer(handle));
+        VK(context->device.freeMemory(memory));
+    });
+    *buffer = VulkanBuffer {};
 }
 
 void createImage(VulkanContext* context, VulkanImage* image, u32 width, u32 height, vk::Format format, vk::ImageUsageFlags usage, vk::SampleCountFlagBits sampleCount) {
@@ -148,6 +150,7 @@ void createImage(VulkanContext* context, VulkanImage* image, u32 width, u32 heig
 }
 
 void uploadDataToImage(VulkanContext* context, VulkanImage* image, void* data, size_t size, u32 width, u32 height, vk::ImageLayout finalLayout, vk::AccessFlags dstAccessMask) {
+    PROFILE_FUNCTION();
     VulkanQueue* queue = &context->graphicsQueue;
     vk::CommandPool commandPool;
     vk::CommandBuffer commandBuffer;
@@ -211,18 +214,39 @@ void uploadDataToImage(VulkanContext* context, VulkanImage* image, void* data, s
 
     VKA(commandBuffer.end());
 
-    vk::SubmitInfo submitInfo {};
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffer;
-
-    VKA(queue->queue.submit(submitInfo));
-    VKA(queue->queue.waitIdle());
-
-    VK(context->device.destroyCommandPool(commandPool));
+    context->timeline.uploadValue = submitTimeline(context, queue, 1, &commandBuffer);
     destroyBuffer(context, &stagingBuffer);
+    deferDestruction(context, [context, commandPool]() {
+        VK(context->device.destroyCommandPool(commandPool));
+    });
 }
 
 void destroyImage(VulkanContext* context, VulkanImage* image) {
-    VK(context->device.destroyImageView(image->imageView));
-    VK(context->device.destroyImage(image->image));
+    deferDestruction(context, [context, handle = image->image, view = image->imageView, memory = image->memory]() {
+        VK(context->device.destroyImageView(view));
+        VK(context->device.destroyImage(handle));
+        VK(context->device.freeMemory(memory));
+    });
+    *image = VulkanImage {};
+}
+
+void transitionImageLayout(vk::CommandBuffer commandBuffer, vk::Image image, vk::ImageAspectFlags aspect, vk::ImageLayout oldLayout, vk::ImageLayout newLayout,
+                            vk::PipelineStageFlags2 srcStage, vk::AccessFlags2 srcAccess, vk::PipelineStageFlags2 dstStage, vk::AccessFlags2 dstAccess) {
+    vk::ImageMemoryBarrier2 imageMemoryBarrier {};
+    imageMemoryBarrier.srcStageMask = srcStage;
+    imageMemoryBarrier.srcAccessMask = srcAccess;
+    imageMemoryBarrier.dstStageMask = dstStage;
+    imageMemoryBarrier.dstAccessMask = dstAccess;
+    imageMemoryBarrier.oldLayout = oldLayout;
+    imageMemoryBarrier.newLayout = newLayout;
+    imageMemoryBarrier.srcQueueFamilyIndex = vk::QueueFamilyIgnored;
+    imageMemoryBarrier.dstQueueFamilyIndex = vk::QueueFamilyIgnored;
+    imageMemoryBarrier.image = image;
+    imageMemoryBarrier.subresourceRange = vk::ImageSubresourceRange { aspect, 0, 1, 0, 1 };
+
+    vk::DependencyInfo dependencyInfo {};
+    dependencyInfo.imageMemoryBarrierCount = 1;
+    dependencyInfo.pImageMemoryBarriers = &imageMemoryBarrier;
+
+    VK(commandBuffer.pipelineBarrier2(dependencyInfo));
 }